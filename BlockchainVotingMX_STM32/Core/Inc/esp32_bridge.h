@@ -21,6 +21,7 @@ extern "C" {
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 /* Exported types ------------------------------------------------------------*/
 typedef enum {
@@ -39,32 +40,493 @@ typedef enum {
     ESP32_BUFFER_OVERFLOW
 } ESP32_Status;
 
+#define ESP32_ERROR_SIZE      24     /* error reason kept in HTTP_Response */
+
+/**
+ * @brief Where the ESP32 spent the time of one request (ms, all 0 if unknown)
+ * connect includes the TLS handshake on TLS connections and is 0 when the
+ * connection was kept open; request runs from sending the request to the
+ * status line, i.e. mostly backend time. A response answered from the
+ * ESP32's cache has cached set and, unless it was revalidated first, only
+ * body_ms.
+ */
+typedef struct {
+    uint16_t dns_ms;
+    uint16_t connect_ms;
+    uint16_t request_ms;
+    uint16_t body_ms;
+    bool reused;
+    bool tls;
+    bool cached;
+} HTTP_Timing;
+
+/**
+ * @brief HTTP reply, body is a view into the bridge RX buffer (no copy)
+ * body is NUL-terminated and valid only until the bridge next reads the link:
+ * any call that polls it (ESP32_HTTP_Poll, any request or command, a wait
+ * hook, Input_Idle/Prefetch_Tick in main.c) may decode another body frame
+ * into rx_buffer - a link echo, an HTTP_ERROR, a stream chunk, a late reply
+ * to a cancelled request or a background prefetch. Read or copy it out
+ * before anything else talks to the ESP32.
+ * On failure error holds the ESP32's reason (NO_WIFI, CONNECTION, HTTP_404,
+ * TIMEOUT...) and body the server's error body, if there was one.
+ */
 typedef struct {
     uint16_t status_code;
     bool success;
-    char body[4096];
+    const char *body;
     uint16_t body_length;
+    char error[ESP32_ERROR_SIZE];
+    HTTP_Timing timing;
 } HTTP_Response;
 
+/* Exported constants --------------------------------------------------------*/
+#define ESP32_TIMEOUT_SHORT   2000
+#define ESP32_TIMEOUT_MEDIUM  5000
+#define ESP32_TIMEOUT_LONG    30000
+#define ESP32_TIMEOUT_WIFI    16000  /* join on the stored access point, then with a scan */
+#define ESP32_RX_BUFFER_SIZE  4096   /* = STM32_RX_BUFFER on the ESP32, its body caps follow from it */
+#define ESP32_TX_BUFFER_SIZE  1024   /* per TX half, the DMA sends one while the other fills */
+#define ESP32_TX_TIMEOUT      500    /* longest wait for a free TX half */
+#define ESP32_RX_DMA_SIZE     256
+#define ESP32_RX_RING_SIZE    4096   /* must be a power of two, ~20 ms at 2 Mbaud */
+#define ESP32_LINE_HEAD_SIZE  32     /* longest text reply kept (PONG, OK, IP:...) */
+
+#define ESP32_FRAME_SMALL_SIZE 64    /* decode buffer for non-HTTP frames */
+#define ESP32_MAX_REQUESTS    4      /* requests awaiting a reply at once (binary link) */
+#define ESP32_HTTP_CHUNK_SIZE 256    /* streamed body chunk, must fit rx_buffer */
+#define ESP32_HTTP_CREDITS    2      /* chunks in flight, keep x chunk size < ring */
+#define ESP32_LINK_BAUD_DEFAULT 115200 /* boot rate of both sides */
+#define ESP32_LINK_TEST_SIZE  256    /* echo pattern, every byte value once */
+#define ESP32_LINK_TEST_ROUNDS 4
+#define ESP32_LINK_PROBATION_MS 1000 /* ESP32 drops back if nothing valid arrives */
+#define JSON_PROJ_MAX_DEPTH   8      /* deepest path a projection can match */
+#define JSON_PROJ_KEY_SIZE    24     /* longer keys never match */
+#define JSON_PROJ_VALUE_SIZE  128    /* longest projected value + 1, longer ones are dropped (as on the ESP32) */
+
+/* 1 = circular DMA + idle-line RX, 0 = legacy one-interrupt-per-byte RX */
+#ifndef ESP32_RX_USE_DMA
+#define ESP32_RX_USE_DMA      1
+#endif
+
+/* 1 = double-buffered DMA TX queue, 0 = blocking HAL_UART_Transmit */
+#ifndef ESP32_TX_USE_DMA
+#define ESP32_TX_USE_DMA      1
+#endif
+
+/* 1 = offer the binary frame protocol at PING time (text stays the fallback) */
+#ifndef ESP32_USE_BINARY_LINK
+#define ESP32_USE_BINARY_LINK 1
+#endif
+
+/* 1 = frame CRC on the STM32L4 CRC unit, 0 = bitwise software CRC */
+#ifndef ESP32_CRC_USE_HW
+#define ESP32_CRC_USE_HW      1
+#endif
+
+/* 1 = after PING, move the binary link to the fastest rate that passes an echo test */
+#ifndef ESP32_LINK_SPEED_UP
+#define ESP32_LINK_SPEED_UP   1
+#endif
+
+/* Rates tried, fastest first. USART2 runs from PCLK1 = 32 MHz, 2 Mbaud at most */
+#ifndef ESP32_LINK_BAUD_RATES
+#define ESP32_LINK_BAUD_RATES { 2000000, 921600 }
+#endif
+
+/* 1 = RTS/CTS at the fast rates (PA1 = RTS, PA0 = CTS). PA0/PA1 are GPIO
+ * outputs on this board, only enable where the ESP32 flow pins are wired. */
+#ifndef ESP32_LINK_FLOW_CTRL
+#define ESP32_LINK_FLOW_CTRL  0
+#endif
+
+/*
+ * Binary frame format (both directions):
+ *   0x00 | COBS( type | seq | fields... | crc16_lo | crc16_hi ) | 0x00
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over type..fields.
+ * Strings are u16 little-endian length + bytes, integers are little-endian.
+ * Replies echo the seq of the request they answer.
+ * Inside HTTP_POST_JSON, ESP32_JSON_BLOB | u16 len | bytes stands for those
+ * bytes base64-encoded; the writer escapes control characters, so the
+ * marker never occurs in the JSON text itself.
+ *
+ * HTTP_*_FIELDS carry a projection, a comma-separated list of paths such as
+ * "data[].id,data[:5].name,..txId": keys joined by '.', array selectors
+ * [] (all), [n] or [a:b] (half-open), a leading ".." matches at any depth.
+ * The ESP32 answers with HTTP_FIELDS, one record per matched value:
+ *   u8 field (position in the list) | u8 item (innermost array index) |
+ *   u16 len | value
+ * Strings arrive unescaped, numbers/true/false/null as their literal text,
+ * a matched object or array as its compact JSON.
+ */
+#define ESP32_JSON_BLOB             0x01
+/* STM32 -> ESP32 */
+#define ESP32_FRAME_PING            0x01
+#define ESP32_FRAME_RESET           0x02
+#define ESP32_FRAME_LED_ON          0x03
+#define ESP32_FRAME_LED_OFF         0x04
+#define ESP32_FRAME_LED_BLINK       0x05  /* u8 times */
+#define ESP32_FRAME_WIFI_CONNECT    0x06  /* str ssid, str password */
+#define ESP32_FRAME_WIFI_DISCONNECT 0x07
+#define ESP32_FRAME_WIFI_STATUS     0x08
+#define ESP32_FRAME_WIFI_IP         0x09
+#define ESP32_FRAME_HTTP_GET        0x0A  /* str host, u16 port, str path, str api_key, str terminal_id */
+#define ESP32_FRAME_HTTP_POST       0x0B  /* ...same as GET..., str json */
+#define ESP32_FRAME_LCD_INIT        0x0C
+#define ESP32_FRAME_LCD_CLEAR       0x0D
+#define ESP32_FRAME_LCD_PRINT       0x0E  /* str text */
+#define ESP32_FRAME_LCD_CURSOR      0x0F  /* u8 row, u8 col */
+#define ESP32_FRAME_LCD_BACKLIGHT   0x10  /* u8 on */
+#define ESP32_FRAME_LOG             0x11  /* str text (STM32 debug output) */
+#define ESP32_FRAME_HTTP_GET_CHUNKED  0x12  /* ...as GET..., u16 chunk size, u8 credits */
+#define ESP32_FRAME_HTTP_POST_CHUNKED 0x13  /* ...as POST..., u16 chunk size, u8 credits */
+#define ESP32_FRAME_CREDIT          0x14  /* u8 stream seq, u8 chunks (0 = cancel) */
+#define ESP32_FRAME_LINK_SPEED      0x15  /* u32 baud, u8 rts/cts; "OK" is sent at the old rate */
+#define ESP32_FRAME_LINK_TEST       0x16  /* pattern (rest of frame) */
+#define ESP32_FRAME_HTTP_POST_JSON  0x17  /* ...as GET..., json (rest of frame, streamed) */
+#define ESP32_FRAME_HTTP_GET_FIELDS 0x18  /* ...as GET..., str projection */
+#define ESP32_FRAME_HTTP_POST_FIELDS 0x19 /* ...as GET..., str projection, json (rest of frame) */
+#define ESP32_FRAME_HTTP_POST_JSON_CHUNKED 0x1A /* ...as GET..., u16 chunk size, u8 credits, json (rest of frame) */
+#define ESP32_FRAME_HTTP_WARM       0x1B  /* str host, u16 port; no reply */
+#define ESP32_FRAME_STATS           0x1C  /* u8 endpoint index */
+#define ESP32_FRAME_HTTP_CACHE      0x1D  /* str path prefix, u32 TTL s (0 = stop); no reply */
+#define ESP32_FRAME_WIFI_STATIC     0x1E  /* str ip, str gateway, str subnet, str dns (ip "" = DHCP) */
+#define ESP32_FRAME_WIFI_ADD        0x1F  /* u8 slot 1..3, str ssid ("" = remove), str password */
+#define ESP32_FRAME_WIFI_ROAM       0x20  /* no payload; ROAMED, STAYED, BUSY or ERROR */
+#define ESP32_FRAME_HTTP_BACKEND    0x21  /* u8 slot 0..3, str host ("" = remove), u16 port */
+/* ESP32 -> STM32 */
+#define ESP32_FRAME_REPLY           0x80  /* str text (same words as the text protocol) */
+#define ESP32_FRAME_HTTP_RESPONSE   0x81  /* u16 status, body, timing */
+#define ESP32_FRAME_HTTP_HEAD       0x82  /* u16 status, u32 body length (ESP32_STREAM_LEN_UNKNOWN if chunked) */
+#define ESP32_FRAME_HTTP_DATA       0x83  /* u32 offset, chunk (rest of frame) */
+#define ESP32_FRAME_HTTP_END        0x84  /* u8 complete, timing */
+#define ESP32_FRAME_LINK_ECHO       0x85  /* the LINK_TEST pattern */
+#define ESP32_FRAME_HTTP_ERROR      0x86  /* u16 status (0 = no HTTP exchange), str reason, body, timing */
+#define ESP32_FRAME_HTTP_FIELDS     0x87  /* u16 status, field records, timing */
+#define ESP32_FRAME_STATS_REPLY     0x88  /* u8 endpoints, str name, u16 x 12 (ESP32_EndpointStats order) */
+
+/* Timing trailer: u16 dns, u16 connect, u16 request, u16 body (ms), u8 flags */
+#define ESP32_TIMING_SIZE           9
+#define ESP32_TIMING_REUSED         0x01
+#define ESP32_TIMING_TLS            0x02
+#define ESP32_TIMING_CACHED         0x04
+#define ESP32_STATS_NAME_SIZE       21
+
+#define ESP32_STREAM_LEN_UNKNOWN    0xFFFFFFFFu  /* HTTP_HEAD length when the server sent none */
+
+typedef enum {
+    ESP32_LINK_TEXT = 0,
+    ESP32_LINK_BINARY
+} ESP32_LinkMode;
+
 /**
- * @brief ESP32 Handle Structure
- * ✅ SIMPLE: No DMA, just interrupt-driven
+ * @brief RX interrupt cost counters (DWT cycles spent in USART2/DMA ISRs)
+ */
+typedef struct {
+    volatile uint32_t isr_cycles;
+    volatile uint32_t isr_count;
+    volatile uint32_t bytes;
+} ESP32_RxStats;
+
+/**
+ * @brief Single-producer/single-consumer RX ring
+ * head is only written by the UART ISR, tail only by the main loop.
+ * Both indices run freely and are masked on access.
  */
 typedef struct {
+    uint8_t buf[ESP32_RX_RING_SIZE];
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    volatile uint32_t dropped;
+} ESP32_RxRing;
+
+/**
+ * @brief Double-buffered TX queue (USART2 TX on DMA1 channel 7)
+ * The main loop appends to buf[fill] while the DMA sends the other half;
+ * the TX complete interrupt starts the filled half, so all output - frames,
+ * text commands and logs - leaves in the order it was queued.
+ */
+typedef struct {
+    uint8_t buf[2][ESP32_TX_BUFFER_SIZE];
+    volatile uint8_t fill;             /* half being appended to */
+    volatile uint16_t fill_len;
+    volatile bool busy;                /* DMA is sending the other half */
+    uint32_t stalls;                   /* writes that had to wait for a half */
+} ESP32_TxQueue;
+
+/**
+ * @brief One piece of a gathered write
+ */
+typedef struct {
+    const void *data;
+    uint16_t len;
+} ESP32_TxSegment;
+
+typedef enum {
+    ESP32_FRAMER_IDLE = 0,
+    ESP32_FRAMER_HTTP_HEADER,   /* got HTTP_RESPONSE:<code>, waiting for BODY: */
+    ESP32_FRAMER_HTTP_BODY      /* storing body until a HTTP_END (or HTTP_ABORT) line */
+} ESP32_FramerState;
+
+typedef enum {
+    ESP32_EVT_NONE = 0,
+    ESP32_EVT_LINE,             /* a text reply line is in dev->reply */
+    ESP32_EVT_HTTP,             /* a complete HTTP response is framed */
+    ESP32_EVT_ECHO,             /* LINK_ECHO pattern is in rx_buffer */
+    ESP32_EVT_HTTP_ERROR,       /* failed request: reason in dev->reply, body in rx_buffer */
+    ESP32_EVT_HTTP_FIELDS,      /* projected response: records in rx_buffer */
+    ESP32_EVT_STATS,            /* STATS_REPLY fields in bin_small */
+    ESP32_EVT_HTTP_HEAD,        /* streamed response: status + length */
+    ESP32_EVT_HTTP_DATA,        /* streamed response: one body chunk */
+    ESP32_EVT_HTTP_END          /* streamed response: done */
+} ESP32_Event;
+
+/**
+ * @brief Incremental line framer - every received byte is looked at once
+ */
+typedef struct {
+    ESP32_FramerState state;
+    char line[ESP32_LINE_HEAD_SIZE];   /* head of the line being received */
+    uint16_t line_len;                 /* full length of that line so far */
+    uint16_t line_body_pos;            /* body offset where that line started */
+    uint16_t http_status;
+    uint16_t body_offset;              /* body start inside rx_buffer */
+    uint16_t body_len;
+    bool body_truncated;               /* text body outgrew rx_buffer, response fails */
+    /* binary link: streaming COBS decoder */
+    uint8_t cobs_code;                 /* code byte of the current block */
+    uint8_t cobs_left;                 /* data bytes left in that block */
+    uint8_t bin_type;
+    uint8_t frame_seq;                 /* seq of the last delivered frame */
+    uint16_t bin_len;
+    bool bin_overflow;                 /* frame outgrew its buffer, dropped at the delimiter */
+    uint8_t bin_small[ESP32_FRAME_SMALL_SIZE];
+    uint32_t stream_value;             /* HEAD: body length, DATA: chunk offset */
+    bool stream_complete;              /* END flag */
+    HTTP_Timing timing;                /* of the last final response frame/line */
+} ESP32_Framer;
+
+typedef enum {
+    ESP32_REQ_FREE = 0,
+    ESP32_REQ_PENDING,
+    ESP32_REQ_DONE
+} ESP32_ReqState;
+
+/**
+ * @brief Outstanding request, matched to its reply by frame seq
+ */
+typedef struct {
+    ESP32_ReqState state;
+    uint8_t seq;
+    ESP32_Event evt;                   /* LINE (reply text) or HTTP */
+    char reply[ESP32_LINE_HEAD_SIZE];
+} ESP32_Request;
+
+/**
+ * @brief Streamed body consumer
+ * @retval false to cancel the transfer
+ */
+typedef bool (*ESP32_BodyCallback)(void *ctx, const char *data, uint16_t len);
+
+/**
+ * @brief Chunked HTTP transfer in progress (one at a time)
+ */
+typedef struct {
+    bool active;
+    bool done;
+    bool ok;
+    uint8_t seq;
+    uint16_t status;
+    char error[ESP32_ERROR_SIZE];
+    uint32_t total;                    /* from HTTP_HEAD */
+    uint32_t received;
+    uint32_t last_tick;                /* last progress, for the idle timeout */
+    HTTP_Timing timing;
+    ESP32_BodyCallback on_body;
+    void *ctx;
+} ESP32_Stream;
+
+/**
+ * @brief ESP32 latency figures for one endpoint (request path), in ms
+ * total covers the whole request on the ESP32, request only sending it up
+ * to the status line; a slow backend shows in request, WiFi/TLS trouble in
+ * dns_avg/connect_avg. Percentiles are histogram bucket bounds.
+ */
+typedef struct {
+    uint8_t endpoints;                 /* endpoints the ESP32 keeps figures for */
+    char name[ESP32_STATS_NAME_SIZE];  /* tail of the path, "*" collects the overflow */
+    uint16_t samples;                  /* requests that got an HTTP status */
+    uint16_t errors;
+    uint16_t reused;                   /* on a kept-alive connection */
+    uint16_t total_p50;
+    uint16_t total_p95;
+    uint16_t total_p99;
+    uint16_t request_p50;
+    uint16_t request_p95;
+    uint16_t request_p99;
+    uint16_t dns_avg;
+    uint16_t connect_avg;
+    uint16_t body_avg;
+} ESP32_EndpointStats;
+
+typedef enum {
+    ESP32_ASYNC_IDLE = 0,
+    ESP32_ASYNC_PENDING,
+    ESP32_ASYNC_DONE,                  /* got an HTTP status, check success */
+    ESP32_ASYNC_FAILED,                /* no HTTP exchange, see response->error */
+    ESP32_ASYNC_CANCELLED
+} ESP32_AsyncState;
+
+/**
+ * @brief Async request completion, runs inside ESP32_HTTP_Poll()
+ * response->body is only valid inside the callback, copy out what is kept.
+ */
+typedef void (*ESP32_HTTPCallback)(void *ctx, ESP32_AsyncState state, const HTTP_Response *response);
+
+typedef enum {
+    JSON_BIND_STRING = 0,              /* char[], unescaped; values that do not fit are skipped */
+    JSON_BIND_INT32,
+    JSON_BIND_UINT16,
+    JSON_BIND_BOOL
+} JSON_BindType;
+
+/**
+ * @brief Maps one projection path to a struct member
+ */
+typedef struct {
+    const char *path;                  /* e.g. "data[].id", see the HTTP_*_FIELDS comment */
+    uint8_t type;                      /* JSON_BindType */
+    uint16_t offset;                   /* of the member in the record */
+    uint16_t size;                     /* of the member */
+} JSON_FieldDesc;
+
+#define JSON_FIELD(path, type, record, member) \
+    { (path), (type), (uint16_t)offsetof(record, member), (uint16_t)sizeof(((record *)0)->member) }
+
+/**
+ * @brief Constant descriptor table for one response shape
+ * Values land in record base + item * stride. A single record (max_items 1)
+ * keeps the first match of each field.
+ */
+typedef struct {
+    const JSON_FieldDesc *fields;
+    uint8_t count;                     /* at most 32 */
+    uint16_t stride;                   /* record size */
+    uint8_t max_items;                 /* records at base */
+} JSON_Binding;
+
+/**
+ * @brief Where a binding stores, and what it found
+ */
+typedef struct {
+    const JSON_Binding *binding;
+    void *base;
+    uint32_t found;                    /* bit n: fields[n] stored at least once */
+    uint8_t items;                     /* highest item stored + 1 */
+} JSON_BindTarget;
+
+/**
+ * @brief Async HTTP request (one at a time, it owns rx_buffer until done)
+ */
+typedef struct {
+    ESP32_AsyncState state;
+    bool notify;                       /* callback still due */
+    ESP32_Request *req;                /* reply slot (binary link) */
+    uint32_t start_tick;
+    HTTP_Response *response;
+    ESP32_HTTPCallback on_done;
+    void *ctx;
+    JSON_BindTarget *bind;             /* projected into this, NULL = whole body */
+} ESP32_Async;
+
+/**
+ * @brief Push parser that fills a binding from a JSON body
+ * Bytes can be fed in any slicing; only the current path is kept, never the
+ * document. The ESP32 runs the same parser, with the same limits, on the
+ * HTTP body. Fed from a stream it fills the records while the body is still
+ * arriving.
+ */
+typedef struct {
+    const char *key;                   /* object: current member name (not NUL-terminated) */
+    uint8_t key_len;
+    uint16_t index;                    /* array: current item */
+    bool array;
+} JSON_PathLevel;
+
+typedef struct {
+    JSON_BindTarget *bind;
+    JSON_PathLevel level[JSON_PROJ_MAX_DEPTH];
+    char keys[JSON_PROJ_MAX_DEPTH][JSON_PROJ_KEY_SIZE];   /* names may span fed slices */
+    uint8_t depth;                     /* open objects/arrays, may exceed the stack */
+    uint8_t state;
+    bool in_key;                       /* the string being read is a member name */
+    bool expect_key;                   /* next string in this object is a name */
+    uint8_t key_len;
+    uint8_t uni_left;                  /* hex digits of a \u escape still due */
+    uint16_t uni;
+    int16_t field;                     /* value being captured, -1 = none */
+    uint8_t item;
+    uint8_t cap_depth;                 /* depth the captured value started at */
+    uint8_t cap_kind;
+    uint16_t value_len;                /* JSON_PROJ_VALUE_SIZE = too long, dropped */
+    char value[JSON_PROJ_VALUE_SIZE];
+} JSON_Projector;
+
+/**
+ * @brief Streaming JSON writer
+ * Bytes go straight into the request being sent (COBS frame or text line),
+ * escaped as they are written; nothing is staged in a buffer.
+ */
+typedef struct {
+    struct ESP32_Handle *dev;
+    uint8_t depth;                     /* open objects/arrays */
+    bool need_comma;                   /* a value precedes at this level */
+    bool ok;                           /* cleared on TX failure or misuse */
+    uint32_t length;                   /* JSON bytes written */
+} JSON_Writer;
+
+/**
+ * @brief Writes a request body with the JSON_Add* calls
+ * Runs while the request is on the wire: only JSON_* writer calls are
+ * allowed inside, no logging or other bridge traffic.
+ */
+typedef void (*ESP32_JSONBuilder)(JSON_Writer *w, void *ctx);
+
+/**
+ * @brief ESP32 Handle Structure
+ * ✅ Circular DMA RX → SPSC ring (ISR) → framer (main loop)
+ * ✅ TX queue → double-buffered DMA (callers never wait for the wire)
+ */
+typedef struct ESP32_Handle {
     UART_HandleTypeDef *huart;
-    char rx_buffer[4096];
-    volatile uint16_t rx_index;
-    volatile bool response_ready;
+    char rx_buffer[ESP32_RX_BUFFER_SIZE];  /* HTTP body of the last response */
+    char reply[ESP32_LINE_HEAD_SIZE];      /* last text reply line */
+    ESP32_RxRing rx_ring;
+    ESP32_TxQueue tx;
+    ESP32_Framer framer;
+    uint16_t clear_mark;                   /* ring position of the last clear */
     WiFi_State wifi_state;
+    ESP32_LinkMode link_mode;
+    uint32_t link_baud;
+    bool link_flow;                        /* RTS/CTS on */
+    uint32_t link_bytes_per_s;             /* measured by the last echo test */
+    uint8_t tx_seq;
+    uint8_t tx_block[255];                 /* COBS block being encoded */
+    uint8_t tx_block_len;
+    uint16_t tx_crc;
+    bool tx_error;
+    bool link_resync;                      /* a request timed out, test the link before the next */
+    uint32_t crc_errors;
+    ESP32_Request requests[ESP32_MAX_REQUESTS];
+    ESP32_Stream stream;
+    ESP32_Async async;
+    void (*wait_hook)(void);               /* runs while an HTTP reply is pending */
+    bool in_wait_hook;
+    uint8_t rx_dma[ESP32_RX_DMA_SIZE];
+    uint16_t rx_dma_pos;
+    ESP32_RxStats rx_stats;
 } ESP32_Handle;
 
-/* Exported constants --------------------------------------------------------*/
-#define ESP32_TIMEOUT_SHORT   2000
-#define ESP32_TIMEOUT_MEDIUM  5000
-#define ESP32_TIMEOUT_LONG    30000
-#define ESP32_RX_BUFFER_SIZE  4096
-#define ESP32_TX_BUFFER_SIZE  2048
-
 
 #ifndef API_KEY
 #define API_KEY "voter-secret-key-456"
@@ -79,6 +541,8 @@ bool ESP32_Init(ESP32_Handle *dev, UART_HandleTypeDef *huart);
 bool ESP32_TestConnection(ESP32_Handle *dev);
 bool ESP32_Reset(ESP32_Handle *dev);
 bool ESP32_SendCommand(ESP32_Handle *dev, const char *cmd);
+bool ESP32_TxWrite(ESP32_Handle *dev, const ESP32_TxSegment *segs, uint8_t count);
+bool ESP32_TxFlush(ESP32_Handle *dev, uint32_t timeout);
 bool ESP32_SendCommandWithResponse(ESP32_Handle *dev, const char *cmd, char *response, uint32_t timeout);
 void ESP32_ClearBuffer(ESP32_Handle *dev);
 bool ESP32_WaitForResponse(ESP32_Handle *dev, const char *expected, uint32_t timeout);
@@ -88,19 +552,78 @@ bool ESP32_LED_Blink(ESP32_Handle *dev, uint8_t times);
 bool ESP32_ConnectWiFi(ESP32_Handle *dev, const char *ssid, const char *password);
 bool ESP32_DisconnectWiFi(ESP32_Handle *dev);
 bool ESP32_CheckConnection(ESP32_Handle *dev);
+bool ESP32_SetStaticIP(ESP32_Handle *dev, const char *ip, const char *gateway, const char *subnet,
+                       const char *dns);
+bool ESP32_WiFiAddNetwork(ESP32_Handle *dev, uint8_t slot, const char *ssid, const char *password);
+bool ESP32_WiFiRoam(ESP32_Handle *dev);
 bool ESP32_GetIP(ESP32_Handle *dev, char *ip_address);
+void ESP32_LCD_Init(ESP32_Handle *dev);
+void ESP32_LCD_Clear(ESP32_Handle *dev);
+void ESP32_LCD_SetCursor(ESP32_Handle *dev, uint8_t row, uint8_t col);
+void ESP32_LCD_Print(ESP32_Handle *dev, const char *text);
+void ESP32_Log(ESP32_Handle *dev, const char *msg);
+void ESP32_SetWaitHook(ESP32_Handle *dev, void (*hook)(void));
 bool ESP32_HTTP_GET(ESP32_Handle *dev, const char *host, uint16_t port, const char *path, HTTP_Response *response);
 bool ESP32_HTTP_POST(ESP32_Handle *dev, const char *host, uint16_t port, const char *path, const char *json_data, HTTP_Response *response);
-bool JSON_GetString(const char *json, const char *key, char *value, uint16_t max_len);
-bool JSON_GetInt(const char *json, const char *key, int32_t *value);
-bool JSON_GetBool(const char *json, const char *key, bool *value);
-bool JSON_ArrayGetItem(const char *json, const char *array_key, uint16_t index, char *item, uint16_t max_len);
-int16_t JSON_ArrayGetCount(const char *json, const char *array_key);
+bool ESP32_HTTP_GET_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                          HTTP_Response *response, ESP32_HTTPCallback on_done, void *ctx);
+bool ESP32_HTTP_POST_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                           const char *json_data, HTTP_Response *response,
+                           ESP32_HTTPCallback on_done, void *ctx);
+bool ESP32_HTTP_POST_JSON(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                          ESP32_JSONBuilder build, void *build_ctx, HTTP_Response *response);
+bool ESP32_HTTP_POST_JSON_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                ESP32_JSONBuilder build, void *build_ctx, HTTP_Response *response,
+                                ESP32_HTTPCallback on_done, void *ctx);
+bool ESP32_HTTP_GET_Bind(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                         JSON_BindTarget *target, HTTP_Response *response);
+bool ESP32_HTTP_POST_Bind(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                          ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *target,
+                          HTTP_Response *response);
+bool ESP32_HTTP_GET_Bind_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                               JSON_BindTarget *target, HTTP_Response *response,
+                               ESP32_HTTPCallback on_done, void *ctx);
+bool ESP32_HTTP_POST_Bind_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *target,
+                                HTTP_Response *response, ESP32_HTTPCallback on_done, void *ctx);
+ESP32_AsyncState ESP32_HTTP_Poll(ESP32_Handle *dev);
+void ESP32_HTTP_Cancel(ESP32_Handle *dev);
+void ESP32_HTTP_Warm(ESP32_Handle *dev, const char *host, uint16_t port);
+void ESP32_HTTP_Cache(ESP32_Handle *dev, const char *path, uint32_t ttl_s);
+bool ESP32_HTTP_Backend(ESP32_Handle *dev, uint8_t slot, const char *host, uint16_t port);
+bool ESP32_GetStats(ESP32_Handle *dev, uint8_t index, ESP32_EndpointStats *stats);
+bool ESP32_HTTP_GET_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                           ESP32_BodyCallback on_body, void *ctx, HTTP_Response *response);
+bool ESP32_HTTP_POST_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                            const char *json_data, ESP32_BodyCallback on_body, void *ctx,
+                            HTTP_Response *response);
+bool ESP32_HTTP_POST_JSON_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                 ESP32_JSONBuilder build, void *build_ctx,
+                                 ESP32_BodyCallback on_body, void *ctx, HTTP_Response *response);
+bool JSON_Bind(const char *json, uint16_t len, JSON_BindTarget *target);
+void JSON_ProjectBind(JSON_Projector *p, JSON_BindTarget *target);
+void JSON_ProjectFeed(JSON_Projector *p, const char *data, uint16_t len);
+void JSON_BeginObject(JSON_Writer *w, const char *key);
+void JSON_EndObject(JSON_Writer *w);
+void JSON_BeginArray(JSON_Writer *w, const char *key);
+void JSON_EndArray(JSON_Writer *w);
+void JSON_AddString(JSON_Writer *w, const char *key, const char *value);
+void JSON_AddInt(JSON_Writer *w, const char *key, int32_t value);
+void JSON_AddBool(JSON_Writer *w, const char *key, bool value);
+void JSON_AddHex(JSON_Writer *w, const char *key, const uint8_t *data, uint16_t len);
+void JSON_AddBase64(JSON_Writer *w, const char *key, const uint8_t *data, uint16_t len);
+void JSON_AddRaw(JSON_Writer *w, const char *key, const char *json);
 const char* ESP32_GetStatusString(ESP32_Status status);
 WiFi_State ESP32_GetWiFiState(ESP32_Handle *dev);
 
-// ✅ NEW: UART RX Callback (called from interrupt)
+// ✅ UART Callbacks (called from interrupt)
 void ESP32_UART_RxCallback(ESP32_Handle *dev, uint8_t byte);
+void ESP32_UART_RxEventCallback(ESP32_Handle *dev, uint16_t dma_pos);
+void ESP32_UART_ErrorCallback(ESP32_Handle *dev);
+void ESP32_UART_TxCpltCallback(ESP32_Handle *dev);
+void ESP32_UART_AccountISR(ESP32_Handle *dev, uint32_t start_cycles);
+uint32_t ESP32_GetRxCyclesPerKB(ESP32_Handle *dev);
+void ESP32_ResetRxStats(ESP32_Handle *dev);
 
 extern uint8_t uart_rx_byte;
 #ifdef __cplusplus
@@ -74,10 +74,12 @@ typedef struct {
     uint16_t library_size;
     uint8_t security_level;
     uint32_t baud_rate;
+    void (*log)(const char *msg);   /* debug text sink, NULL = silent */
 } R307_Handle;
 
 /* Public Functions */
 bool R307_Init(R307_Handle *dev, UART_HandleTypeDef *huart);
+void R307_SetLogger(R307_Handle *dev, void (*log)(const char *msg));
 bool R307_VerifyPassword(R307_Handle *dev);
 bool R307_GetImage(R307_Handle *dev);
 bool R307_Image2Tz(R307_Handle *dev, uint8_t buffer_id);
@@ -2,8 +2,14 @@
 /**
 ******************************************************************************
 * @file           : esp32_bridge.c
-* @brief          : ESP32 WiFi Bridge - UART Interrupt Mode
-* ✅ Simple, robust, interrupt-driven RX
+* @brief          : ESP32 WiFi Bridge - UART Circular DMA Mode
+* ✅ Circular DMA + idle-line RX (one IRQ per burst, not per byte)
+* ✅ SPSC ring + incremental framer (no rescans, O(1) clear)
+* ✅ Optional binary framed link (COBS + CRC16 + seq), negotiated at PING
+* ✅ Replies routed by seq, LCD/LED traffic keeps flowing during HTTP calls
+* ✅ Zero-copy HTTP responses (body points into rx_buffer)
+* ✅ Chunked, credit-based body streaming for responses of any size
+* ✅ Double-buffered DMA TX queue with gathered writes, nothing blocks on TX
 ******************************************************************************
 */
 /* USER CODE END Header */
@@ -16,512 +22,2870 @@ extern UART_HandleTypeDef huart2;
 uint8_t uart_rx_byte; // Single byte for interrupt RX
 
 /* Private function prototypes -----------------------------------------------*/
-static bool ESP32_ParseHTTPResponse(const char *raw_response, HTTP_Response *response);
+static bool ESP32_ParseHTTPResponse(ESP32_Handle *dev, HTTP_Response *response);
+static bool ESP32_WaitHTTPResponse(ESP32_Handle *dev, HTTP_Response *response, uint32_t timeout);
+static bool ESP32_HTTPComplete(ESP32_Handle *dev, HTTP_Response *response, ESP32_Event evt);
+static void ESP32_DeliverFields(ESP32_Handle *dev, HTTP_Response *response, bool records);
+static bool ESP32_HTTPFail(ESP32_Handle *dev, HTTP_Response *response, ESP32_Event evt, const char *reason);
+static void ESP32_SetError(char *dst, const char *reason);
+static bool ESP32_HTTP_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                             ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *bind,
+                             HTTP_Response *response, ESP32_HTTPCallback on_done, void *ctx);
+static bool ESP32_HTTP_Wait(ESP32_Handle *dev);
+static bool ESP32_HTTP_Blocking(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *bind,
+                                HTTP_Response *response);
+static void ESP32_JSONRaw(JSON_Writer *w, void *ctx);
+static void JSON_Emit(JSON_Writer *w, const char *data, uint16_t len);
+static void JSON_Key(JSON_Writer *w, const char *key);
+static void JSON_EmitEscaped(JSON_Writer *w, const char *str);
+static void JSON_ProjByte(JSON_Projector *p, char c);
+static void JSON_ProjValueStart(JSON_Projector *p, uint8_t kind);
+static bool JSON_PathMatch(const char *spec, const JSON_PathLevel *level, uint8_t depth, uint8_t *item);
+static const char *JSON_PathStep(const char *s, const char **key, uint8_t *key_len,
+                                 uint16_t *lo, uint16_t *hi);
+static bool JSON_ParseInt(const char *s, uint16_t len, int32_t *value);
+static void JSON_BindStore(JSON_BindTarget *t, uint8_t field, uint8_t item,
+                           const char *value, uint16_t len);
+static void JSON_ProjPut(JSON_Projector *p, char c);
+static void JSON_ProjText(JSON_Projector *p, char c);
+static void JSON_ProjPutUTF8(JSON_Projector *p, uint16_t cp);
+static void JSON_ProjEmit(JSON_Projector *p);
 static bool ESP32_ValidateConnection(ESP32_Handle *dev);
-static void ESP32_DebugPrint(const char *msg);
+static void ESP32_DebugPrint(ESP32_Handle *dev, const char *msg);
+static void ESP32_StartReception(ESP32_Handle *dev);
+static void ESP32_PushRx(ESP32_Handle *dev, const uint8_t *data, uint16_t len);
+static void ESP32_TxKick(ESP32_Handle *dev);
+static void ESP32_TxAbort(ESP32_Handle *dev);
+static bool ESP32_TxWaitSpace(ESP32_Handle *dev);
+static bool ESP32_TxSend(ESP32_Handle *dev, const void *data, uint16_t len);
+static ESP32_Event ESP32_FramerFeed(ESP32_Handle *dev, char c);
+static ESP32_Event ESP32_FramerEndLine(ESP32_Handle *dev);
+static ESP32_Event ESP32_FramerFeedBinary(ESP32_Handle *dev, uint8_t b);
+static ESP32_Event ESP32_FramerEndFrame(ESP32_Handle *dev);
+static void ESP32_FramerTiming(ESP32_Framer *fr, const uint8_t *buf, uint16_t *n, uint16_t fixed);
+static void ESP32_ParseTimingLine(HTTP_Timing *t, const char *s);
+static ESP32_Event ESP32_Poll(ESP32_Handle *dev);
+static uint16_t ESP32_CRC16(uint16_t crc, const uint8_t *data, uint16_t len);
+static void ESP32_FrameFlushBlock(ESP32_Handle *dev);
+static void ESP32_FramePutRaw(ESP32_Handle *dev, uint8_t b);
+static uint8_t ESP32_FrameBegin(ESP32_Handle *dev, uint8_t type);
+static void ESP32_FramePut(ESP32_Handle *dev, const void *data, uint16_t len);
+static void ESP32_FramePutU8(ESP32_Handle *dev, uint8_t v);
+static void ESP32_FramePutU16(ESP32_Handle *dev, uint16_t v);
+static void ESP32_FramePutU32(ESP32_Handle *dev, uint32_t v);
+static void ESP32_FramePutStr(ESP32_Handle *dev, const char *str);
+static void ESP32_FramePutPaths(ESP32_Handle *dev, const JSON_Binding *b);
+static bool ESP32_FrameEnd(ESP32_Handle *dev);
+static bool ESP32_Negotiate(ESP32_Handle *dev);
+static bool ESP32_ProbeBinary(ESP32_Handle *dev);
+static bool ESP32_Handshake(ESP32_Handle *dev);
+static bool ESP32_SetBaud(ESP32_Handle *dev, uint32_t baud, bool flow);
+static bool ESP32_FindBaud(ESP32_Handle *dev);
+static bool ESP32_LinkSpeed(ESP32_Handle *dev, uint32_t baud, bool flow);
+static bool ESP32_LinkTest(ESP32_Handle *dev, uint32_t *bytes_per_s);
+static void ESP32_LinkReport(ESP32_Handle *dev, uint32_t bytes_per_s);
+static bool ESP32_LinkFallback(ESP32_Handle *dev);
+static bool ESP32_LinkSpeedUp(ESP32_Handle *dev);
+static bool ESP32_WaitReply(ESP32_Handle *dev, uint8_t seq, char *response, uint32_t timeout);
+static bool ESP32_Command(ESP32_Handle *dev, const char *text_cmd, uint8_t frame_type,
+                          char *response, uint32_t timeout);
+static ESP32_Request *ESP32_RequestOpen(ESP32_Handle *dev, uint8_t seq);
+static ESP32_Event ESP32_Pump(ESP32_Handle *dev);
+static void ESP32_StreamEvent(ESP32_Handle *dev, ESP32_Event evt);
+static void ESP32_StreamCredit(ESP32_Handle *dev, uint8_t chunks);
+static bool ESP32_HTTP_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                              ESP32_JSONBuilder build, void *build_ctx, ESP32_BodyCallback on_body,
+                              void *ctx, HTTP_Response *response);
 
 /* Private user code ---------------------------------------------------------*/
 
-static void ESP32_DebugPrint(const char *msg) {
-    HAL_UART_Transmit(&huart2, (uint8_t*)msg, strlen(msg), 100);
+static void ESP32_DebugPrint(ESP32_Handle *dev, const char *msg) {
+    ESP32_Log(dev, msg);
+}
+
+/**
+ * @brief Arm USART2 reception in the configured RX mode
+ */
+static void ESP32_StartReception(ESP32_Handle *dev) {
+#if ESP32_RX_USE_DMA
+    dev->rx_dma_pos = 0;
+    HAL_UARTEx_ReceiveToIdle_DMA(dev->huart, dev->rx_dma, ESP32_RX_DMA_SIZE);
+#else
+    HAL_UART_Receive_IT(dev->huart, &uart_rx_byte, 1);
+#endif
+}
+
+/**
+ * @brief Produce received bytes into the RX ring (ISR context only)
+ */
+static void ESP32_PushRx(ESP32_Handle *dev, const uint8_t *data, uint16_t len) {
+    ESP32_RxRing *ring = &dev->rx_ring;
+    uint16_t head = ring->head;
+    uint16_t space = ESP32_RX_RING_SIZE - (uint16_t)(head - ring->tail);
+
+    if (len > space) {
+        ring->dropped += len - space;
+        len = space;
+    }
+
+    uint16_t offset = head & (ESP32_RX_RING_SIZE - 1);
+    uint16_t first = ESP32_RX_RING_SIZE - offset;
+    if (first > len) first = len;
+    memcpy(&ring->buf[offset], data, first);
+    memcpy(&ring->buf[0], data + first, len - first);
+
+    // Publish data before the new head becomes visible to the consumer
+    __DMB();
+    ring->head = head + len;
+    dev->rx_stats.bytes += len;
+}
+
+/**
+ * @brief UART RX Callback - called from interrupt (per-byte mode)
+ */
+void ESP32_UART_RxCallback(ESP32_Handle *dev, uint8_t byte) {
+    ESP32_PushRx(dev, &byte, 1);
+}
+
+/**
+ * @brief UART RX Event Callback - called on DMA half/full transfer and idle line
+ * @param dma_pos: current write position of the DMA inside rx_dma
+ */
+void ESP32_UART_RxEventCallback(ESP32_Handle *dev, uint16_t dma_pos) {
+    uint16_t old_pos = dev->rx_dma_pos;
+    if (dma_pos == old_pos) return;
+
+    if (dma_pos > old_pos) {
+        ESP32_PushRx(dev, &dev->rx_dma[old_pos], dma_pos - old_pos);
+    } else {
+        // DMA wrapped around since the last event
+        ESP32_PushRx(dev, &dev->rx_dma[old_pos], ESP32_RX_DMA_SIZE - old_pos);
+        ESP32_PushRx(dev, &dev->rx_dma[0], dma_pos);
+    }
+
+    dev->rx_dma_pos = (dma_pos >= ESP32_RX_DMA_SIZE) ? 0 : dma_pos;
+}
+
+/**
+ * @brief UART Error Callback - HAL stops reception on errors, re-arm it
+ */
+void ESP32_UART_ErrorCallback(ESP32_Handle *dev) {
+    if (dev->huart->RxState == HAL_UART_STATE_READY) {
+        ESP32_StartReception(dev);
+    }
+    // A DMA error ends the TX transfer without a completion callback
+    if (dev->tx.busy && dev->huart->gState == HAL_UART_STATE_READY) {
+        ESP32_UART_TxCpltCallback(dev);
+    }
+}
+
+/**
+ * @brief Accumulate cycles spent in a USART2/DMA ISR (call at ISR exit)
+ */
+void ESP32_UART_AccountISR(ESP32_Handle *dev, uint32_t start_cycles) {
+    dev->rx_stats.isr_cycles += DWT->CYCCNT - start_cycles;
+    dev->rx_stats.isr_count++;
+}
+
+/**
+ * @brief RX ISR cost normalised to 1 KB of received data
+ */
+uint32_t ESP32_GetRxCyclesPerKB(ESP32_Handle *dev) {
+    if (!dev || dev->rx_stats.bytes == 0) return 0;
+    return (uint32_t)(((uint64_t)dev->rx_stats.isr_cycles * 1024U) / dev->rx_stats.bytes);
+}
+
+void ESP32_ResetRxStats(ESP32_Handle *dev) {
+    if (!dev) return;
+    __disable_irq();
+    dev->rx_stats.isr_cycles = 0;
+    dev->rx_stats.isr_count = 0;
+    dev->rx_stats.bytes = 0;
+    __enable_irq();
+}
+
+/* ========================================================================== */
+/* TX QUEUE (double-buffered DMA) */
+/* ========================================================================== */
+
+/**
+ * @brief Hand the filled half to the DMA if the line is idle
+ * Interrupt context or interrupts masked: the TX complete ISR calls it too.
+ * The halves only swap once the DMA took the data, a refused start is
+ * retried by the next write or wait.
+ */
+static void ESP32_TxKick(ESP32_Handle *dev) {
+    ESP32_TxQueue *q = &dev->tx;
+    if (q->busy || q->fill_len == 0) return;
+    if (HAL_UART_Transmit_DMA(dev->huart, q->buf[q->fill], q->fill_len) != HAL_OK) return;
+    q->busy = true;
+    q->fill ^= 1;
+    q->fill_len = 0;
+}
+
+/**
+ * @brief Drop everything queued after the line stalled
+ */
+static void ESP32_TxAbort(ESP32_Handle *dev) {
+    HAL_UART_AbortTransmit(dev->huart);
+    __disable_irq();
+    dev->tx.busy = false;
+    dev->tx.fill_len = 0;
+    __enable_irq();
+}
+
+/**
+ * @brief Wait until the half being filled has room again
+ */
+static bool ESP32_TxWaitSpace(ESP32_Handle *dev) {
+    ESP32_TxQueue *q = &dev->tx;
+    uint32_t start_tick = HAL_GetTick();
+
+    q->stalls++;
+    while (q->fill_len == ESP32_TX_BUFFER_SIZE) {
+        __disable_irq();
+        ESP32_TxKick(dev);
+        __enable_irq();
+        if ((HAL_GetTick() - start_tick) >= ESP32_TX_TIMEOUT) {
+            ESP32_TxAbort(dev);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Queue a gathered write, returns once it is copied (not sent)
+ * The segments are packed back to back into the TX half being filled, so a
+ * command assembled from header, path, JSON and trailer needs no staging
+ * buffer and goes out as one DMA transfer.
+ */
+bool ESP32_TxWrite(ESP32_Handle *dev, const ESP32_TxSegment *segs, uint8_t count) {
+    if (!dev || !dev->huart || !segs) return false;
+#if ESP32_TX_USE_DMA
+    ESP32_TxQueue *q = &dev->tx;
+    bool ok = true;
+
+    for (uint8_t i = 0; i < count && ok; i++) {
+        const uint8_t *p = (const uint8_t *)segs[i].data;
+        uint16_t len = segs[i].len;
+
+        while (len > 0) {
+            if (q->fill_len == ESP32_TX_BUFFER_SIZE && !ESP32_TxWaitSpace(dev)) {
+                ok = false;
+                break;
+            }
+            // The ISR may swap halves, copy and account under one mask
+            __disable_irq();
+            uint16_t n = ESP32_TX_BUFFER_SIZE - q->fill_len;
+            if (n > len) n = len;
+            memcpy(&q->buf[q->fill][q->fill_len], p, n);
+            q->fill_len += n;
+            __enable_irq();
+            p += n;
+            len -= n;
+        }
+    }
+
+    __disable_irq();
+    ESP32_TxKick(dev);
+    __enable_irq();
+    return ok;
+#else
+    for (uint8_t i = 0; i < count; i++) {
+        if (segs[i].len == 0) continue;
+        if (HAL_UART_Transmit(dev->huart, (const uint8_t *)segs[i].data, segs[i].len, 1000) != HAL_OK) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+/**
+ * @brief Queue one buffer
+ */
+static bool ESP32_TxSend(ESP32_Handle *dev, const void *data, uint16_t len) {
+    ESP32_TxSegment seg = { data, len };
+    return ESP32_TxWrite(dev, &seg, 1);
+}
+
+/**
+ * @brief Wait until everything queued is on the wire
+ */
+bool ESP32_TxFlush(ESP32_Handle *dev, uint32_t timeout) {
+    if (!dev || !dev->huart) return false;
+#if ESP32_TX_USE_DMA
+    ESP32_TxQueue *q = &dev->tx;
+    uint32_t start_tick = HAL_GetTick();
+
+    while (q->busy || q->fill_len > 0) {
+        __disable_irq();
+        ESP32_TxKick(dev);
+        __enable_irq();
+        if ((HAL_GetTick() - start_tick) >= timeout) {
+            ESP32_TxAbort(dev);
+            return false;
+        }
+    }
+    // The DMA is done once the last byte is in the shifter, let it leave
+    while (!__HAL_UART_GET_FLAG(dev->huart, UART_FLAG_TC)) {
+        if ((HAL_GetTick() - start_tick) >= timeout) return false;
+    }
+#else
+    (void)timeout;
+#endif
+    return true;
+}
+
+/**
+ * @brief UART TX Complete Callback - DMA finished a half, start the next one
+ */
+void ESP32_UART_TxCpltCallback(ESP32_Handle *dev) {
+    dev->tx.busy = false;
+    ESP32_TxKick(dev);
+}
+
+/* ========================================================================== */
+/* FRAMER (main loop only) */
+/* ========================================================================== */
+
+/**
+ * @brief Feed one received byte through the line framer
+ */
+static ESP32_Event ESP32_FramerFeed(ESP32_Handle *dev, char c) {
+    ESP32_Framer *fr = &dev->framer;
+
+    if (fr->state == ESP32_FRAMER_HTTP_BODY) {
+        if (fr->body_len < ESP32_RX_BUFFER_SIZE - 1) {
+            dev->rx_buffer[fr->body_len++] = c;
+        } else {
+            fr->body_truncated = true;
+        }
+    }
+
+    if (c == '\n') {
+        return ESP32_FramerEndLine(dev);
+    }
+
+    if (fr->line_len < ESP32_LINE_HEAD_SIZE - 1) {
+        fr->line[fr->line_len] = c;
+    }
+    fr->line_len++;
+
+    // Body starts right after "BODY:" - everything from here is payload
+    if (fr->state == ESP32_FRAMER_HTTP_HEADER && fr->line_len == 5 &&
+        memcmp(fr->line, "BODY:", 5) == 0) {
+        fr->state = ESP32_FRAMER_HTTP_BODY;
+        fr->body_len = 0;
+        fr->line_body_pos = 0;
+    }
+    return ESP32_EVT_NONE;
+}
+
+/**
+ * @brief Classify a completed line (called on '\n')
+ */
+static ESP32_Event ESP32_FramerEndLine(ESP32_Handle *dev) {
+    ESP32_Framer *fr = &dev->framer;
+    uint16_t len = (fr->line_len < ESP32_LINE_HEAD_SIZE - 1) ? fr->line_len : ESP32_LINE_HEAD_SIZE - 1;
+
+    if (len > 0 && fr->line[len - 1] == '\r') len--;
+    fr->line[len] = '\0';
+    fr->line_len = 0;
+
+    if (strncmp(fr->line, "HTTP_RESPONSE:", 14) == 0) {
+        fr->state = ESP32_FRAMER_HTTP_HEADER;
+        fr->http_status = (uint16_t)atoi(&fr->line[14]);
+        fr->body_offset = 0;
+        fr->body_len = 0;
+        fr->body_truncated = false;
+        memset(&fr->timing, 0, sizeof(fr->timing));
+        return ESP32_EVT_NONE;
+    }
+
+    if (fr->state == ESP32_FRAMER_HTTP_BODY) {
+        if (strncmp(fr->line, "HTTP_TIMING:", 12) == 0 && !fr->body_truncated) {
+            // Longer than the line head, the full line is in rx_buffer. It is
+            // cut off the body together with HTTP_END (line_body_pos stays).
+            ESP32_ParseTimingLine(&fr->timing, dev->rx_buffer + fr->line_body_pos + 12);
+            return ESP32_EVT_NONE;
+        }
+        if (strcmp(fr->line, "HTTP_ABORT") == 0) {
+            // The body was cut off mid-transfer, an ERROR: line follows
+            fr->state = ESP32_FRAMER_IDLE;
+            fr->body_len = 0;
+            return ESP32_EVT_NONE;
+        }
+        if (strcmp(fr->line, "HTTP_END") != 0) {
+            // Multi-line body, keep going
+            fr->line_body_pos = fr->body_len;
+            return ESP32_EVT_NONE;
+        }
+
+        // Cut the HTTP_END line and trailing line breaks off the body
+        uint16_t body_len = fr->line_body_pos;
+        while (body_len > 0 && (dev->rx_buffer[body_len - 1] == '\r' || dev->rx_buffer[body_len - 1] == '\n')) {
+            body_len--;
+        }
+        dev->rx_buffer[body_len] = '\0';
+        fr->body_len = body_len;
+        fr->state = ESP32_FRAMER_IDLE;
+        return ESP32_EVT_HTTP;
+    }
+
+    if (len == 0) return ESP32_EVT_NONE;
+
+    memcpy(dev->reply, fr->line, len + 1);
+    return ESP32_EVT_LINE;
+}
+
+/**
+ * @brief Feed one received byte through the COBS frame decoder
+ * HTTP_RESPONSE/HTTP_ERROR/HTTP_DATA/LINK_ECHO frames decode straight into rx_buffer, everything
+ * else into bin_small. The type byte is kept aside, so both buffers start at seq.
+ */
+static ESP32_Event ESP32_FramerFeedBinary(ESP32_Handle *dev, uint8_t b) {
+    ESP32_Framer *fr = &dev->framer;
+
+    if (b == 0x00) {
+        ESP32_Event evt = ESP32_EVT_NONE;
+        if (fr->bin_len > 0 && fr->cobs_left == 0) {
+            evt = ESP32_FramerEndFrame(dev);
+        } else if (fr->cobs_left != 0) {
+            dev->crc_errors++;   // frame cut short
+        }
+        fr->bin_len = 0;
+        fr->cobs_code = 0;
+        fr->cobs_left = 0;
+        fr->bin_overflow = false;
+        return evt;
+    }
+
+    uint8_t data;
+    if (fr->cobs_left == 0) {
+        // Code byte: the previous block (unless it was a full 0xFF one) ended in a zero
+        bool implicit_zero = (fr->cobs_code != 0 && fr->cobs_code != 0xFF);
+        fr->cobs_code = b;
+        fr->cobs_left = b - 1;
+        if (!implicit_zero) return ESP32_EVT_NONE;
+        data = 0x00;
+    } else {
+        fr->cobs_left--;
+        data = b;
+    }
+
+    if (fr->bin_len == 0) {
+        fr->bin_type = data;
+        fr->bin_len = 1;
+        return ESP32_EVT_NONE;
+    }
+
+    bool is_body = (fr->bin_type == ESP32_FRAME_HTTP_RESPONSE || fr->bin_type == ESP32_FRAME_HTTP_DATA ||
+                    fr->bin_type == ESP32_FRAME_LINK_ECHO || fr->bin_type == ESP32_FRAME_HTTP_ERROR ||
+                    fr->bin_type == ESP32_FRAME_HTTP_FIELDS);
+    uint8_t *dst = is_body ? (uint8_t *)dev->rx_buffer : fr->bin_small;
+    uint16_t cap = is_body ? ESP32_RX_BUFFER_SIZE : ESP32_FRAME_SMALL_SIZE;
+    if (fr->bin_len - 1 < cap) {
+        dst[fr->bin_len - 1] = data;
+        fr->bin_len++;
+    } else {
+        fr->bin_overflow = true;
+    }
+    return ESP32_EVT_NONE;
+}
+
+/**
+ * @brief Check and deliver a decoded frame (called on the 0x00 delimiter)
+ */
+static ESP32_Event ESP32_FramerEndFrame(ESP32_Handle *dev) {
+    ESP32_Framer *fr = &dev->framer;
+    bool is_http = (fr->bin_type == ESP32_FRAME_HTTP_RESPONSE || fr->bin_type == ESP32_FRAME_HTTP_FIELDS);
+    ESP32_Event http_evt = (fr->bin_type == ESP32_FRAME_HTTP_FIELDS) ? ESP32_EVT_HTTP_FIELDS : ESP32_EVT_HTTP;
+    bool is_body = (is_http || fr->bin_type == ESP32_FRAME_HTTP_DATA ||
+                    fr->bin_type == ESP32_FRAME_LINK_ECHO || fr->bin_type == ESP32_FRAME_HTTP_ERROR);
+    uint8_t *buf = is_body ? (uint8_t *)dev->rx_buffer : fr->bin_small;
+    uint16_t n = fr->bin_len - 1;   // bytes after the type: seq, fields, crc
+
+    if (fr->bin_overflow) {
+        // The ESP32 never sends more than fits (HTTP_ERROR TOO_LARGE instead), so
+        // this is a corrupt frame: its CRC is gone and seq/status cannot be
+        // trusted. Dropped like a CRC error, the request ends in its timeout.
+        dev->crc_errors++;
+        return ESP32_EVT_NONE;
+    }
+
+    if (n < 3) {
+        dev->crc_errors++;
+        return ESP32_EVT_NONE;
+    }
+
+    uint16_t rx_crc = (uint16_t)(buf[n - 2] | (buf[n - 1] << 8));
+    uint16_t crc = ESP32_CRC16(0xFFFF, &fr->bin_type, 1);
+    crc = ESP32_CRC16(crc, buf, n - 2);
+    if (crc != rx_crc) {
+        dev->crc_errors++;
+        return ESP32_EVT_NONE;
+    }
+
+    fr->frame_seq = buf[0];
+    n -= 2;   // drop the CRC
+
+    if (is_http) {
+        ESP32_FramerTiming(fr, buf, &n, 3);
+        if (n < 3) return ESP32_EVT_NONE;
+        fr->http_status = (uint16_t)(buf[1] | (buf[2] << 8));
+        fr->body_offset = 3;
+        fr->body_len = n - 3;
+        fr->body_truncated = false;
+        buf[n] = '\0';   // overwrites the CRC, body is now a C string
+        return http_evt;
+    }
+
+    switch (fr->bin_type) {
+        case ESP32_FRAME_HTTP_HEAD:
+            if (n < 7) return ESP32_EVT_NONE;
+            fr->http_status = (uint16_t)(buf[1] | (buf[2] << 8));
+            fr->stream_value = (uint32_t)buf[3] | ((uint32_t)buf[4] << 8) |
+                               ((uint32_t)buf[5] << 16) | ((uint32_t)buf[6] << 24);
+            return ESP32_EVT_HTTP_HEAD;
+
+        case ESP32_FRAME_HTTP_DATA:
+            if (n < 5) return ESP32_EVT_NONE;
+            fr->stream_value = (uint32_t)buf[1] | ((uint32_t)buf[2] << 8) |
+                               ((uint32_t)buf[3] << 16) | ((uint32_t)buf[4] << 24);
+            fr->body_offset = 5;
+            fr->body_len = n - 5;
+            return ESP32_EVT_HTTP_DATA;
+
+        case ESP32_FRAME_HTTP_END:
+            ESP32_FramerTiming(fr, buf, &n, 2);
+            if (n < 2) return ESP32_EVT_NONE;
+            fr->stream_complete = (buf[1] != 0);
+            return ESP32_EVT_HTTP_END;
+
+        case ESP32_FRAME_LINK_ECHO:
+            fr->body_offset = 1;
+            fr->body_len = n - 1;
+            return ESP32_EVT_ECHO;
+
+        case ESP32_FRAME_STATS_REPLY:
+            // Read in place by ESP32_GetStats
+            if (n < 4) return ESP32_EVT_NONE;
+            fr->body_offset = 1;
+            fr->body_len = n - 1;
+            return ESP32_EVT_STATS;
+
+        case ESP32_FRAME_HTTP_ERROR: {
+            ESP32_FramerTiming(fr, buf, &n, 5);
+            if (n < 5) return ESP32_EVT_NONE;
+            uint16_t len = (uint16_t)(buf[3] | (buf[4] << 8));
+            if (len > n - 5) return ESP32_EVT_NONE;
+            fr->http_status = (uint16_t)(buf[1] | (buf[2] << 8));
+            uint16_t keep = (len < ESP32_LINE_HEAD_SIZE - 1) ? len : ESP32_LINE_HEAD_SIZE - 1;
+            memcpy(dev->reply, &buf[5], keep);
+            dev->reply[keep] = '\0';
+            fr->body_offset = 5 + len;
+            fr->body_len = n - fr->body_offset;
+            fr->body_truncated = false;
+            buf[n] = '\0';
+            return ESP32_EVT_HTTP_ERROR;
+        }
+
+        default:
+            break;
+    }
+
+    if (fr->bin_type == ESP32_FRAME_REPLY && n >= 3) {
+        uint16_t len = (uint16_t)(buf[1] | (buf[2] << 8));
+        if (len > n - 3) return ESP32_EVT_NONE;
+        if (len > ESP32_LINE_HEAD_SIZE - 1) len = ESP32_LINE_HEAD_SIZE - 1;
+        memcpy(dev->reply, &buf[3], len);
+        dev->reply[len] = '\0';
+        return ESP32_EVT_LINE;
+    }
+    return ESP32_EVT_NONE;
+}
+
+/**
+ * @brief Take the timing trailer off a final response frame
+ * @param n: frame length after the CRC was dropped, shortened by the trailer
+ * @param fixed: bytes the frame needs besides the trailer
+ */
+static void ESP32_FramerTiming(ESP32_Framer *fr, const uint8_t *buf, uint16_t *n, uint16_t fixed) {
+    memset(&fr->timing, 0, sizeof(fr->timing));
+    if (*n < fixed + ESP32_TIMING_SIZE) return;
+
+    const uint8_t *t = buf + *n - ESP32_TIMING_SIZE;
+    fr->timing.dns_ms = (uint16_t)(t[0] | (t[1] << 8));
+    fr->timing.connect_ms = (uint16_t)(t[2] | (t[3] << 8));
+    fr->timing.request_ms = (uint16_t)(t[4] | (t[5] << 8));
+    fr->timing.body_ms = (uint16_t)(t[6] | (t[7] << 8));
+    fr->timing.reused = (t[8] & ESP32_TIMING_REUSED) != 0;
+    fr->timing.tls = (t[8] & ESP32_TIMING_TLS) != 0;
+    fr->timing.cached = (t[8] & ESP32_TIMING_CACHED) != 0;
+    *n -= ESP32_TIMING_SIZE;
+}
+
+/**
+ * @brief Text link: "<dns>,<connect>,<request>,<body>,<flags>" of an HTTP_TIMING line
+ */
+static void ESP32_ParseTimingLine(HTTP_Timing *t, const char *s) {
+    uint32_t v[5] = { 0 };
+    for (uint8_t i = 0; i < 5; i++) {
+        char *end;
+        v[i] = strtoul(s, &end, 10);
+        if (*end != ',') break;
+        s = end + 1;
+    }
+    t->dns_ms = (uint16_t)v[0];
+    t->connect_ms = (uint16_t)v[1];
+    t->request_ms = (uint16_t)v[2];
+    t->body_ms = (uint16_t)v[3];
+    t->reused = (v[4] & ESP32_TIMING_REUSED) != 0;
+    t->tls = (v[4] & ESP32_TIMING_TLS) != 0;
+    t->cached = (v[4] & ESP32_TIMING_CACHED) != 0;
+}
+
+/**
+ * @brief Consume RX ring bytes until the framer reports an event
+ * @retval ESP32_EVT_NONE once the ring is empty
+ * Events for bytes received before the last ESP32_ClearBuffer() are dropped,
+ * but those bytes still go through the framer so no line is ever split.
+ */
+static ESP32_Event ESP32_Poll(ESP32_Handle *dev) {
+    ESP32_RxRing *ring = &dev->rx_ring;
+    uint16_t head = ring->head;
+    __DMB();
+
+    while (ring->tail != head) {
+        uint16_t idx = ring->tail;
+        uint8_t c = ring->buf[idx & (ESP32_RX_RING_SIZE - 1)];
+        ring->tail = idx + 1;
+
+        ESP32_Event evt = (dev->link_mode == ESP32_LINK_BINARY) ?
+                          ESP32_FramerFeedBinary(dev, c) : ESP32_FramerFeed(dev, (char)c);
+        if (evt != ESP32_EVT_NONE && (int16_t)(idx - dev->clear_mark) >= 0) {
+            return evt;
+        }
+    }
+    return ESP32_EVT_NONE;
+}
+
+/**
+ * @brief Claim a request slot for @p seq (binary link)
+ * @retval NULL when ESP32_MAX_REQUESTS replies are already outstanding
+ */
+static ESP32_Request *ESP32_RequestOpen(ESP32_Handle *dev, uint8_t seq) {
+    for (uint8_t i = 0; i < ESP32_MAX_REQUESTS; i++) {
+        ESP32_Request *req = &dev->requests[i];
+        if (req->state == ESP32_REQ_FREE) {
+            req->state = ESP32_REQ_PENDING;
+            req->seq = seq;
+            req->evt = ESP32_EVT_NONE;
+            req->reply[0] = '\0';
+            return req;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Poll once and hand a binary-link event to the request it answers
+ * Whoever polls completes every request, so a wait nested inside the wait
+ * hook never eats the reply an outer wait is after. Replies nobody waits
+ * for (LCD, LED notifications) are dropped here.
+ */
+static ESP32_Event ESP32_Pump(ESP32_Handle *dev) {
+    ESP32_Event evt = ESP32_Poll(dev);
+    if (evt == ESP32_EVT_NONE) return evt;
+
+    bool for_stream = dev->stream.active && dev->framer.frame_seq == dev->stream.seq;
+    if (evt >= ESP32_EVT_HTTP_HEAD) {
+        if (for_stream) ESP32_StreamEvent(dev, evt);
+        return evt;
+    }
+    if (for_stream && (evt == ESP32_EVT_HTTP_ERROR || evt == ESP32_EVT_LINE)) {
+        ESP32_StreamEvent(dev, evt);
+        return evt;
+    }
+
+    for (uint8_t i = 0; i < ESP32_MAX_REQUESTS; i++) {
+        ESP32_Request *req = &dev->requests[i];
+        if (req->state == ESP32_REQ_PENDING && req->seq == dev->framer.frame_seq) {
+            req->evt = evt;
+            if (evt == ESP32_EVT_LINE || evt == ESP32_EVT_HTTP_ERROR) {
+                strcpy(req->reply, dev->reply);
+            }
+            req->state = ESP32_REQ_DONE;
+            break;
+        }
+    }
+    return evt;
+}
+
+/**
+ * @brief Grant the ESP32 @p chunks more body chunks (0 cancels the transfer)
+ */
+static void ESP32_StreamCredit(ESP32_Handle *dev, uint8_t chunks) {
+    ESP32_FrameBegin(dev, ESP32_FRAME_CREDIT);
+    ESP32_FramePutU8(dev, dev->stream.seq);
+    ESP32_FramePutU8(dev, chunks);
+    ESP32_FrameEnd(dev);
+}
+
+/**
+ * @brief Handle a HEAD/DATA/END frame of the active stream
+ * Each chunk goes to the consumer straight out of rx_buffer and is paid for
+ * with one new credit, so at most ESP32_HTTP_CREDITS chunks are ever in flight.
+ */
+static void ESP32_StreamEvent(ESP32_Handle *dev, ESP32_Event evt) {
+    ESP32_Stream *st = &dev->stream;
+    ESP32_Framer *fr = &dev->framer;
+
+    st->last_tick = HAL_GetTick();
+
+    switch (evt) {
+        case ESP32_EVT_HTTP_HEAD:
+            st->status = fr->http_status;
+            st->total = fr->stream_value;
+            break;
+
+        case ESP32_EVT_HTTP_DATA:
+            // A chunk lost to a CRC error shows up as an offset gap
+            if (fr->stream_value != st->received ||
+                !st->on_body(st->ctx, dev->rx_buffer + fr->body_offset, fr->body_len)) {
+                ESP32_StreamCredit(dev, 0);
+                st->ok = false;
+                st->done = true;
+                st->active = false;
+                break;
+            }
+            st->received += fr->body_len;
+            ESP32_StreamCredit(dev, 1);
+            break;
+
+        case ESP32_EVT_HTTP_END:
+            st->timing = fr->timing;
+            st->ok = fr->stream_complete &&
+                     (st->total == ESP32_STREAM_LEN_UNKNOWN || st->received == st->total);
+            st->done = true;
+            st->active = false;
+            break;
+
+        case ESP32_EVT_HTTP_ERROR:
+        case ESP32_EVT_LINE:
+            // Failed before any data: HTTP_ERROR, or ERROR:BUSY and the like
+            if (evt == ESP32_EVT_LINE && strncmp(dev->reply, "ERROR:", 6) != 0) break;
+            st->status = (evt == ESP32_EVT_HTTP_ERROR) ? fr->http_status : 0;
+            if (evt == ESP32_EVT_HTTP_ERROR) st->timing = fr->timing;
+            ESP32_SetError(st->error, (evt == ESP32_EVT_HTTP_ERROR) ? dev->reply : dev->reply + 6);
+            st->ok = false;
+            st->done = true;
+            st->active = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ========================================================================== */
+/* BINARY LINK (COBS + CRC16) */
+/* ========================================================================== */
+
+/**
+ * @brief CRC-16/CCITT-FALSE continued from @p crc
+ * The CRC unit is re-seeded on every call, so a frame's CRC can be built up
+ * across several puts.
+ */
+static uint16_t ESP32_CRC16(uint16_t crc, const uint8_t *data, uint16_t len) {
+#if ESP32_CRC_USE_HW
+    CRC->INIT = crc;
+    CRC->CR |= CRC_CR_RESET;
+    while (len--) {
+        *(__IO uint8_t *)&CRC->DR = *data++;
+    }
+    return (uint16_t)CRC->DR;
+#else
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+#endif
+}
+
+/**
+ * @brief Send the COBS block collected so far
+ */
+static void ESP32_FrameFlushBlock(ESP32_Handle *dev) {
+    dev->tx_block[0] = dev->tx_block_len;
+    if (!ESP32_TxSend(dev, dev->tx_block, dev->tx_block_len)) {
+        dev->tx_error = true;
+    }
+    dev->tx_block_len = 1;
+}
+
+/**
+ * @brief COBS-encode one byte (no CRC update)
+ */
+static void ESP32_FramePutRaw(ESP32_Handle *dev, uint8_t b) {
+    if (b == 0x00) {
+        ESP32_FrameFlushBlock(dev);
+        return;
+    }
+    dev->tx_block[dev->tx_block_len++] = b;
+    if (dev->tx_block_len == 0xFF) {
+        ESP32_FrameFlushBlock(dev);
+    }
+}
+
+/**
+ * @brief Start a frame
+ * @retval sequence number the reply will echo
+ */
+static uint8_t ESP32_FrameBegin(ESP32_Handle *dev, uint8_t type) {
+    uint8_t seq = dev->tx_seq++;
+    dev->tx_block_len = 1;
+    dev->tx_crc = 0xFFFF;
+    dev->tx_error = false;
+    ESP32_FramePutU8(dev, type);
+    ESP32_FramePutU8(dev, seq);
+    return seq;
+}
+
+static void ESP32_FramePut(ESP32_Handle *dev, const void *data, uint16_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    dev->tx_crc = ESP32_CRC16(dev->tx_crc, p, len);
+    while (len--) {
+        ESP32_FramePutRaw(dev, *p++);
+    }
+}
+
+static void ESP32_FramePutU8(ESP32_Handle *dev, uint8_t v) {
+    ESP32_FramePut(dev, &v, 1);
+}
+
+static void ESP32_FramePutU16(ESP32_Handle *dev, uint16_t v) {
+    uint8_t b[2] = { (uint8_t)(v & 0xFF), (uint8_t)(v >> 8) };
+    ESP32_FramePut(dev, b, 2);
+}
+
+static void ESP32_FramePutU32(ESP32_Handle *dev, uint32_t v) {
+    uint8_t b[4] = { (uint8_t)(v & 0xFF), (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    ESP32_FramePut(dev, b, 4);
+}
+
+static void ESP32_FramePutStr(ESP32_Handle *dev, const char *str) {
+    uint16_t len = (uint16_t)strlen(str);
+    ESP32_FramePutU16(dev, len);
+    ESP32_FramePut(dev, str, len);
+}
+
+/**
+ * @brief The paths of a binding table as one projection string
+ */
+static void ESP32_FramePutPaths(ESP32_Handle *dev, const JSON_Binding *b) {
+    uint16_t len = 0;
+    for (uint8_t i = 0; i < b->count; i++) {
+        len += (uint16_t)strlen(b->fields[i].path) + (i > 0 ? 1 : 0);
+    }
+    ESP32_FramePutU16(dev, len);
+    for (uint8_t i = 0; i < b->count; i++) {
+        if (i > 0) ESP32_FramePut(dev, ",", 1);
+        ESP32_FramePut(dev, b->fields[i].path, (uint16_t)strlen(b->fields[i].path));
+    }
+}
+
+/**
+ * @brief Append the CRC, flush and delimit the frame
+ */
+static bool ESP32_FrameEnd(ESP32_Handle *dev) {
+    uint16_t crc = dev->tx_crc;
+    uint8_t delim = 0x00;
+
+    ESP32_FramePutRaw(dev, (uint8_t)(crc & 0xFF));
+    ESP32_FramePutRaw(dev, (uint8_t)(crc >> 8));
+    ESP32_FrameFlushBlock(dev);
+    if (!ESP32_TxSend(dev, &delim, 1)) {
+        dev->tx_error = true;
+    }
+    return !dev->tx_error;
+}
+
+/* ========================================================================== */
+/* INITIALIZATION FUNCTIONS */
+/* ========================================================================== */
+
+bool ESP32_Init(ESP32_Handle *dev, UART_HandleTypeDef *huart) {
+    if (!dev || !huart) return false;
+
+    dev->huart = huart;
+    dev->wifi_state = WIFI_DISCONNECTED;
+    dev->rx_ring.head = 0;
+    dev->rx_ring.tail = 0;
+    dev->rx_ring.dropped = 0;
+    memset(&dev->tx, 0, sizeof(dev->tx));
+    dev->clear_mark = 0;
+    dev->reply[0] = '\0';
+    memset(&dev->framer, 0, sizeof(dev->framer));
+    dev->link_mode = ESP32_LINK_TEXT;
+    dev->link_baud = huart->Init.BaudRate;
+    dev->link_flow = (huart->Init.HwFlowCtl != UART_HWCONTROL_NONE);
+    dev->link_bytes_per_s = 0;
+    dev->tx_seq = 0;
+    dev->crc_errors = 0;
+    dev->link_resync = false;
+    memset(dev->requests, 0, sizeof(dev->requests));
+    memset(&dev->stream, 0, sizeof(dev->stream));
+    memset(&dev->async, 0, sizeof(dev->async));
+    dev->wait_hook = NULL;
+    dev->in_wait_hook = false;
+
+#if ESP32_CRC_USE_HW
+    // ✅ CRC unit: 16-bit poly 0x1021, no bit reversal (CRC-16/CCITT-FALSE)
+    __HAL_RCC_CRC_CLK_ENABLE();
+    CRC->POL = 0x1021;
+    CRC->CR = CRC_CR_POLYSIZE_0;
+#endif
+
+    // ✅ DWT cycle counter for RX ISR cost accounting
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    ESP32_ResetRxStats(dev);
+
+    // ✅ RX runs continuously from here on
+    ESP32_StartReception(dev);
+
+    HAL_Delay(1000);
+    return ESP32_TestConnection(dev);
+}
+
+/**
+ * @brief Offer the binary link: "PING,BIN1" is answered with "PONG,BIN1"
+ * by firmware that speaks frames
+ */
+static bool ESP32_ProbeBinary(ESP32_Handle *dev) {
+#if ESP32_USE_BINARY_LINK
+    char response[ESP32_LINE_HEAD_SIZE];
+
+    dev->link_mode = ESP32_LINK_TEXT;
+    memset(&dev->framer, 0, sizeof(dev->framer));
+
+    // Delimiter + newline terminate whatever half frame or line the ESP32 holds
+    ESP32_TxSend(dev, "\0\n", 2);
+    if (ESP32_SendCommandWithResponse(dev, "PING,BIN1\n", response, ESP32_TIMEOUT_SHORT) &&
+        strcmp(response, "PONG,BIN1") == 0) {
+        dev->link_mode = ESP32_LINK_BINARY;
+        return true;
+    }
+#else
+    (void)dev;
+#endif
+    return false;
+}
+
+/**
+ * @brief Agree on the link format with a text PING at the current rate
+ * Older firmware answers PING,BIN1 with ERROR:UNKNOWN and gets a plain PING.
+ */
+static bool ESP32_Handshake(ESP32_Handle *dev) {
+    char response[ESP32_LINE_HEAD_SIZE];
+
+    if (ESP32_ProbeBinary(dev)) return true;
+
+    dev->link_mode = ESP32_LINK_TEXT;
+    memset(&dev->framer, 0, sizeof(dev->framer));
+    if (ESP32_SendCommandWithResponse(dev, "PING\n", response, ESP32_TIMEOUT_SHORT)) {
+        return (strstr(response, "PONG") != NULL);
+    }
+    return false;
+}
+
+static bool ESP32_Negotiate(ESP32_Handle *dev) {
+    if (ESP32_Handshake(dev)) {
+#if ESP32_LINK_SPEED_UP
+        if (dev->link_mode == ESP32_LINK_BINARY && dev->link_baud == ESP32_LINK_BAUD_DEFAULT) {
+            return ESP32_LinkSpeedUp(dev);
+        }
+#endif
+        return true;
+    }
+#if ESP32_LINK_SPEED_UP
+    // One side missed a speed change (e.g. the STM32 was reset mid-session)
+    return ESP32_FindBaud(dev);
+#else
+    return false;
+#endif
+}
+
+bool ESP32_TestConnection(ESP32_Handle *dev) {
+    if (!dev) return false;
+    char response[ESP32_LINE_HEAD_SIZE];
+
+    if (dev->link_mode == ESP32_LINK_BINARY &&
+        ESP32_Command(dev, "PING\n", ESP32_FRAME_PING, response, ESP32_TIMEOUT_SHORT) &&
+        strcmp(response, "PONG") == 0) {
+        return true;
+    }
+    // Text link, or the ESP32 lost the binary link (e.g. it rebooted)
+    return ESP32_Negotiate(dev);
+}
+
+bool ESP32_Reset(ESP32_Handle *dev) {
+    if (!dev) return false;
+    char response[ESP32_LINE_HEAD_SIZE];
+    if (ESP32_Command(dev, "RESET\n", ESP32_FRAME_RESET, response, ESP32_TIMEOUT_MEDIUM)) {
+        HAL_Delay(2000);
+        dev->wifi_state = WIFI_DISCONNECTED;
+        dev->link_mode = ESP32_LINK_TEXT;   // fresh firmware starts in text mode
+        ESP32_SetBaud(dev, ESP32_LINK_BAUD_DEFAULT, false);
+        return ESP32_TestConnection(dev);
+    }
+    return false;
+}
+
+/* ========================================================================== */
+/* LINK SPEED */
+/* ========================================================================== */
+
+/**
+ * @brief Reprogram USART2 for @p baud, RX restarts with an empty ring
+ */
+static bool ESP32_SetBaud(ESP32_Handle *dev, uint32_t baud, bool flow) {
+    ESP32_TxFlush(dev, ESP32_TX_TIMEOUT);   // queued bytes leave at the old rate
+    HAL_UART_AbortReceive(dev->huart);
+    dev->huart->Init.BaudRate = baud;
+    dev->huart->Init.HwFlowCtl = flow ? UART_HWCONTROL_RTS_CTS : UART_HWCONTROL_NONE;
+    bool ok = (HAL_UART_Init(dev->huart) == HAL_OK);
+    ESP32_StartReception(dev);
+
+    // Give the ESP32 time to switch too, whatever arrived meanwhile is noise
+    HAL_Delay(5);
+    dev->rx_ring.tail = dev->rx_ring.head;
+    dev->clear_mark = dev->rx_ring.head;
+    dev->framer.state = ESP32_FRAMER_IDLE;
+    dev->framer.line_len = 0;
+    dev->framer.bin_len = 0;
+    dev->framer.cobs_code = 0;
+    dev->framer.cobs_left = 0;
+    dev->framer.bin_overflow = false;
+
+    dev->link_baud = baud;
+    dev->link_flow = flow;
+    return ok;
+}
+
+/**
+ * @brief Look for the ESP32 at every rate the link may have been left at
+ * Fast rates are only ever used on the binary link, so they get the binary probe.
+ */
+static bool ESP32_FindBaud(ESP32_Handle *dev) {
+    static const uint32_t rates[] = ESP32_LINK_BAUD_RATES;
+    uint32_t tried = dev->link_baud;
+
+    if (tried != ESP32_LINK_BAUD_DEFAULT) {
+        ESP32_SetBaud(dev, ESP32_LINK_BAUD_DEFAULT, false);
+        if (ESP32_Handshake(dev)) return true;
+    }
+    for (uint8_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i] == tried) continue;
+        ESP32_SetBaud(dev, rates[i], ESP32_LINK_FLOW_CTRL);
+        if (ESP32_ProbeBinary(dev)) return true;
+    }
+    ESP32_SetBaud(dev, ESP32_LINK_BAUD_DEFAULT, false);
+    return false;
+}
+
+/**
+ * @brief Ask the ESP32 to change rate and follow it once it agreed
+ */
+static bool ESP32_LinkSpeed(ESP32_Handle *dev, uint32_t baud, bool flow) {
+    char response[ESP32_LINE_HEAD_SIZE];
+
+    uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_LINK_SPEED);
+    ESP32_FramePutU32(dev, baud);
+    ESP32_FramePutU8(dev, flow ? 1 : 0);
+    if (!ESP32_FrameEnd(dev)) return false;
+    if (!ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_SHORT) || strcmp(response, "OK") != 0) {
+        return false;
+    }
+    return ESP32_SetBaud(dev, baud, flow);
+}
+
+/**
+ * @brief Echo ESP32_LINK_TEST_ROUNDS test patterns and time them
+ * @param bytes_per_s: payload moved per second, both directions together
+ */
+static bool ESP32_LinkTest(ESP32_Handle *dev, uint32_t *bytes_per_s) {
+    uint8_t pattern[ESP32_LINK_TEST_SIZE];
+    char response[ESP32_LINE_HEAD_SIZE];
+    ESP32_Framer *fr = &dev->framer;
+
+    for (uint16_t i = 0; i < ESP32_LINK_TEST_SIZE; i++) {
+        pattern[i] = (uint8_t)i;
+    }
+
+    uint32_t start = DWT->CYCCNT;
+    for (uint8_t round = 0; round < ESP32_LINK_TEST_ROUNDS; round++) {
+        uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_LINK_TEST);
+        ESP32_FramePut(dev, pattern, ESP32_LINK_TEST_SIZE);
+        if (!ESP32_FrameEnd(dev)) return false;
+        if (!ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_SHORT)) return false;
+
+        // The reply is still the last frame decoded, ERROR:UNKNOWN on old firmware
+        if (fr->bin_type != ESP32_FRAME_LINK_ECHO || fr->body_len != ESP32_LINK_TEST_SIZE ||
+            memcmp(&dev->rx_buffer[fr->body_offset], pattern, ESP32_LINK_TEST_SIZE) != 0) {
+            return false;
+        }
+    }
+    uint32_t us = (DWT->CYCCNT - start) / (SystemCoreClock / 1000000U);
+    if (us == 0) us = 1;
+
+    *bytes_per_s = (uint32_t)((2ULL * ESP32_LINK_TEST_SIZE * ESP32_LINK_TEST_ROUNDS * 1000000ULL) / us);
+    dev->link_bytes_per_s = *bytes_per_s;
+    return true;
+}
+
+static void ESP32_LinkReport(ESP32_Handle *dev, uint32_t bytes_per_s) {
+    char debug[96];
+    // 10 bits per byte on the wire (8N1)
+    snprintf(debug, sizeof(debug), "💬 [STM32] 📶 Link %lu baud%s: %lu B/s (%lu%% of line rate)\r\n",
+             (unsigned long)dev->link_baud, dev->link_flow ? " RTS/CTS" : "",
+             (unsigned long)bytes_per_s, (unsigned long)((bytes_per_s * 1000ULL) / dev->link_baud));
+    ESP32_DebugPrint(dev, debug);
+}
+
+/**
+ * @brief Return both sides to the boot rate after a failed echo test
+ * The request may not get through at the failing rate; the ESP32 then drops
+ * back on its own once its probation runs out without a valid frame.
+ */
+static bool ESP32_LinkFallback(ESP32_Handle *dev) {
+    char response[ESP32_LINE_HEAD_SIZE];
+
+    if (!ESP32_LinkSpeed(dev, ESP32_LINK_BAUD_DEFAULT, false)) {
+        ESP32_SetBaud(dev, ESP32_LINK_BAUD_DEFAULT, false);
+        HAL_Delay(ESP32_LINK_PROBATION_MS + 200);
+    }
+    if (ESP32_Command(dev, "PING\n", ESP32_FRAME_PING, response, ESP32_TIMEOUT_SHORT) &&
+        strcmp(response, "PONG") == 0) {
+        return true;
+    }
+    return ESP32_Handshake(dev) || ESP32_FindBaud(dev);
+}
+
+/**
+ * @brief Move the binary link to the fastest rate that passes the echo test
+ * Measures the boot rate first so every report has a baseline.
+ * @retval false if the link was lost on the way
+ */
+static bool ESP32_LinkSpeedUp(ESP32_Handle *dev) {
+    static const uint32_t rates[] = ESP32_LINK_BAUD_RATES;
+    uint32_t bytes_per_s;
+
+    // Firmware without LINK_TEST stays at the boot rate
+    if (!ESP32_LinkTest(dev, &bytes_per_s)) return true;
+    ESP32_LinkReport(dev, bytes_per_s);
+
+    for (uint8_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (!ESP32_LinkSpeed(dev, rates[i], ESP32_LINK_FLOW_CTRL)) {
+            // Refused, or the OK was lost and the ESP32 switched anyway
+            if (dev->link_baud == ESP32_LINK_BAUD_DEFAULT) HAL_Delay(ESP32_LINK_PROBATION_MS + 200);
+            continue;
+        }
+        if (ESP32_LinkTest(dev, &bytes_per_s)) {
+            ESP32_LinkReport(dev, bytes_per_s);
+            return true;
+        }
+
+        char debug[80];
+        snprintf(debug, sizeof(debug), "💬 [STM32] ⚠️ Link %lu baud failed the echo test\r\n",
+                 (unsigned long)rates[i]);
+        ESP32_DebugPrint(dev, debug);
+        if (!ESP32_LinkFallback(dev)) return false;
+    }
+    return true;
+}
+
+/* ========================================================================== */
+/* COMMAND FUNCTIONS */
+/* ========================================================================== */
+
+bool ESP32_SendCommand(ESP32_Handle *dev, const char *cmd) {
+    if (!dev || !cmd) return false;
+    ESP32_ClearBuffer(dev);
+    return ESP32_TxSend(dev, cmd, (uint16_t)strlen(cmd));
+}
+
+bool ESP32_SendCommandWithResponse(ESP32_Handle *dev, const char *cmd, char *response, uint32_t timeout) {
+    if (!dev || !cmd || !response) return false;
+    ESP32_ClearBuffer(dev);
+
+    if (!ESP32_TxSend(dev, cmd, (uint16_t)strlen(cmd))) return false;
+
+    uint32_t start_tick = HAL_GetTick();
+    while ((HAL_GetTick() - start_tick) < timeout) {
+        ESP32_Event evt = ESP32_Poll(dev);
+        if (evt == ESP32_EVT_LINE) {
+            strcpy(response, dev->reply);
+            return true;
+        }
+        if (evt == ESP32_EVT_NONE) HAL_Delay(1);
+    }
+    return false;
+}
+
+/**
+ * @brief Discard everything received so far (O(1))
+ * ✅ RX keeps running: bytes already in the ring are still framed, only the
+ *    replies they complete are ignored, so a line straddling the clear is
+ *    never corrupted and nothing arriving afterwards is lost.
+ */
+void ESP32_ClearBuffer(ESP32_Handle *dev) {
+    if (!dev) return;
+    dev->clear_mark = dev->rx_ring.head;
+    dev->reply[0] = '\0';
+}
+
+
+/**
+ * @brief Wait for the reply to request @p seq
+ * On the binary link replies are routed by seq, so other traffic may come
+ * and go meanwhile; on the text link the first line received is the reply.
+ */
+static bool ESP32_WaitReply(ESP32_Handle *dev, uint8_t seq, char *response, uint32_t timeout) {
+    uint32_t start_tick = HAL_GetTick();
+
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_Request *req = ESP32_RequestOpen(dev, seq);
+        if (!req) return false;
+
+        bool ok = false;
+        while ((HAL_GetTick() - start_tick) < timeout) {
+            ESP32_Event evt = ESP32_Pump(dev);
+            if (req->state == ESP32_REQ_DONE) {
+                strcpy(response, req->reply);
+                ok = true;
+                break;
+            }
+            if (evt == ESP32_EVT_NONE) HAL_Delay(1);
+        }
+        req->state = ESP32_REQ_FREE;
+        return ok;
+    }
+
+    while ((HAL_GetTick() - start_tick) < timeout) {
+        ESP32_Event evt = ESP32_Poll(dev);
+        if (evt == ESP32_EVT_LINE) {
+            strcpy(response, dev->reply);
+            return true;
+        }
+        if (evt == ESP32_EVT_NONE) HAL_Delay(1);
+    }
+    return false;
+}
+
+/**
+ * @brief Send an argument-less command on the active link and wait for its reply
+ */
+static bool ESP32_Command(ESP32_Handle *dev, const char *text_cmd, uint8_t frame_type,
+                          char *response, uint32_t timeout) {
+    if (!dev || !response) return false;
+
+    if (dev->link_mode == ESP32_LINK_TEXT) {
+        return ESP32_SendCommandWithResponse(dev, text_cmd, response, timeout);
+    }
+
+    uint8_t seq = ESP32_FrameBegin(dev, frame_type);
+    if (!ESP32_FrameEnd(dev)) return false;
+    return ESP32_WaitReply(dev, seq, response, timeout);
+}
+
+bool ESP32_WaitForResponse(ESP32_Handle *dev, const char *expected, uint32_t timeout) {
+    if (!dev || !expected) return false;
+    uint32_t start_tick = HAL_GetTick();
+    while ((HAL_GetTick() - start_tick) < timeout) {
+        ESP32_Event evt = ESP32_Poll(dev);
+        if (evt == ESP32_EVT_LINE && strstr(dev->reply, expected) != NULL) {
+            return true;
+        }
+        if (evt == ESP32_EVT_NONE) HAL_Delay(1);
+    }
+    return false;
+}
+
+/* ========================================================================== */
+/* LED, WIFI, etc. - ALL UNCHANGED */
+/* ========================================================================== */
+
+bool ESP32_LED_On(ESP32_Handle *dev) {
+    char response[32];
+    if (ESP32_Command(dev, "LED_ON\n", ESP32_FRAME_LED_ON, response, ESP32_TIMEOUT_SHORT)) {
+        return (strstr(response, "OK") != NULL);
+    }
+    return false;
+}
+
+bool ESP32_LED_Off(ESP32_Handle *dev) {
+    char response[32];
+    if (ESP32_Command(dev, "LED_OFF\n", ESP32_FRAME_LED_OFF, response, ESP32_TIMEOUT_SHORT)) {
+        return (strstr(response, "OK") != NULL);
+    }
+    return false;
+}
+
+bool ESP32_LED_Blink(ESP32_Handle *dev, uint8_t times) {
+    if (!dev) return false;
+    char response[32];
+
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_LED_BLINK);
+        ESP32_FramePutU8(dev, times);
+        if (ESP32_FrameEnd(dev) && ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_MEDIUM)) {
+            return (strcmp(response, "OK") == 0);
+        }
+        return false;
+    }
+
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "LED_BLINK,%d\n", times);
+    if (ESP32_SendCommandWithResponse(dev, cmd, response, ESP32_TIMEOUT_MEDIUM)) {
+        return (strstr(response, "OK") != NULL);
+    }
+    return false;
+}
+
+bool ESP32_ConnectWiFi(ESP32_Handle *dev, const char *ssid, const char *password) {
+    if (!dev || !ssid || !password) return false;
+    char cmd[256];
+    dev->wifi_state = WIFI_CONNECTING;
+
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        char response[ESP32_LINE_HEAD_SIZE];
+        uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_WIFI_CONNECT);
+        ESP32_FramePutStr(dev, ssid);
+        ESP32_FramePutStr(dev, password);
+        if (ESP32_FrameEnd(dev) && ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_WIFI) &&
+            strcmp(response, "CONNECTED") == 0) {
+            dev->wifi_state = WIFI_CONNECTED;
+            return true;
+        }
+        dev->wifi_state = WIFI_ERROR;
+        return false;
+    }
+
+    snprintf(cmd, sizeof(cmd), "WIFI_CONNECT,%s,%s\n", ssid, password);
+    ESP32_ClearBuffer(dev);
+
+    if (!ESP32_SendCommand(dev, cmd)) {
+        dev->wifi_state = WIFI_ERROR;
+        return false;
+    }
+
+    if (ESP32_WaitForResponse(dev, "CONNECTED", ESP32_TIMEOUT_WIFI)) {
+        dev->wifi_state = WIFI_CONNECTED;
+        return true;
+    }
+
+    dev->wifi_state = WIFI_ERROR;
+    return false;
+}
+
+bool ESP32_DisconnectWiFi(ESP32_Handle *dev) {
+    char response[64];
+    if (ESP32_Command(dev, "WIFI_DISCONNECT\n", ESP32_FRAME_WIFI_DISCONNECT, response, ESP32_TIMEOUT_SHORT)) {
+        if (strstr(response, "OK") != NULL) {
+            dev->wifi_state = WIFI_DISCONNECTED;
+            return true;
+        }
+    }
+    return false;
 }
 
 /**
- * @brief UART RX Callback - called from interrupt
+ * @brief Ask the ESP32 for its WiFi state (answered from its cache, no radio work)
+ * CONNECTING means the ESP32 is (re)joining in the background.
  */
-void ESP32_UART_RxCallback(ESP32_Handle *dev, uint8_t byte) {
-    if (dev->rx_index < ESP32_RX_BUFFER_SIZE - 1) {
-        dev->rx_buffer[dev->rx_index++] = (char)byte;
-        dev->rx_buffer[dev->rx_index] = '\0';
+bool ESP32_CheckConnection(ESP32_Handle *dev) {
+    char response[64];
+    /* No reply says nothing about the WiFi, wifi_state keeps its last value */
+    if (!ESP32_Command(dev, "WIFI_STATUS\n", ESP32_FRAME_WIFI_STATUS, response, ESP32_TIMEOUT_SHORT)) {
+        return false;
     }
+    // Whole-word compare, "DISCONNECTED" contains "CONNECTED"
+    size_t len = strcspn(response, "\r\n");
+    if (len == 9 && strncmp(response, "CONNECTED", 9) == 0) {
+        dev->wifi_state = WIFI_CONNECTED;
+        return true;
+    }
+    if (len == 10 && strncmp(response, "CONNECTING", 10) == 0) {
+        dev->wifi_state = WIFI_CONNECTING;
+    } else {
+        dev->wifi_state = WIFI_DISCONNECTED;
+    }
+    return false;
 }
 
-/* ========================================================================== */
-/* INITIALIZATION FUNCTIONS */
-/* ========================================================================== */
-
-bool ESP32_Init(ESP32_Handle *dev, UART_HandleTypeDef *huart) {
-    if (!dev || !huart) return false;
+/**
+ * @brief Fixed address for the ESP32's joins from now on, skipping DHCP
+ * @param ip: NULL or "" for DHCP; dns NULL or "" uses the gateway
+ * The ESP32 keeps it in flash and rejoins if it is connected with another.
+ */
+bool ESP32_SetStaticIP(ESP32_Handle *dev, const char *ip, const char *gateway, const char *subnet,
+                       const char *dns) {
+    if (!dev) return false;
+    char response[32];
+    if (!ip) ip = "";
+    if (!gateway) gateway = "";
+    if (!subnet) subnet = "";
+    if (!dns) dns = "";
+
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_WIFI_STATIC);
+        ESP32_FramePutStr(dev, ip);
+        ESP32_FramePutStr(dev, gateway);
+        ESP32_FramePutStr(dev, subnet);
+        ESP32_FramePutStr(dev, dns);
+        if (ESP32_FrameEnd(dev) && ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_SHORT)) {
+            return (strcmp(response, "OK") == 0);
+        }
+        return false;
+    }
 
-    dev->huart = huart;
-    dev->rx_index = 0;
-    dev->response_ready = false;
-    dev->wifi_state = WIFI_DISCONNECTED;
+    char cmd[96];
+    if (ip[0] == '\0') {
+        snprintf(cmd, sizeof(cmd), "WIFI_STATIC\n");
+    } else {
+        snprintf(cmd, sizeof(cmd), "WIFI_STATIC,%s,%s,%s,%s\n", ip, gateway, subnet, dns);
+    }
+    if (ESP32_SendCommandWithResponse(dev, cmd, response, ESP32_TIMEOUT_SHORT)) {
+        return (strstr(response, "OK") != NULL);
+    }
+    return false;
+}
 
-    ESP32_ClearBuffer(dev);
+/**
+ * @brief Another network the ESP32 may roam to, besides the one of ESP32_ConnectWiFi
+ * @param slot: 1..3; ssid NULL or "" removes the network in that slot
+ * Kept in the ESP32's flash, which is only written when it changes.
+ */
+bool ESP32_WiFiAddNetwork(ESP32_Handle *dev, uint8_t slot, const char *ssid, const char *password) {
+    if (!dev) return false;
+    char response[32];
+    if (!ssid) ssid = "";
+    if (!password) password = "";
+
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_WIFI_ADD);
+        ESP32_FramePutU8(dev, slot);
+        ESP32_FramePutStr(dev, ssid);
+        ESP32_FramePutStr(dev, password);
+        if (ESP32_FrameEnd(dev) && ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_SHORT)) {
+            return (strcmp(response, "OK") == 0);
+        }
+        return false;
+    }
 
-    // ✅ Start interrupt RX for single byte
-    HAL_UART_Receive_IT(dev->huart, &uart_rx_byte, 1);
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "WIFI_ADD,%u,%s,%s\n", slot, ssid, password);
+    if (ESP32_SendCommandWithResponse(dev, cmd, response, ESP32_TIMEOUT_SHORT)) {
+        return (strstr(response, "OK") != NULL);
+    }
+    return false;
+}
 
-    HAL_Delay(1000);
-    return ESP32_TestConnection(dev);
+/**
+ * @brief Let the ESP32 switch networks now, while no voter is mid-flow
+ * It moves only if another configured network (or access point) scores
+ * clearly better. Only the decision is waited for: the ESP32 holds the
+ * requests sent after this until the switch is done (11 s at worst), so
+ * they go out on the new network.
+ * @retval true if the ESP32 is switching networks
+ */
+bool ESP32_WiFiRoam(ESP32_Handle *dev) {
+    char response[32];
+    if (!ESP32_Command(dev, "WIFI_ROAM\n", ESP32_FRAME_WIFI_ROAM, response, ESP32_TIMEOUT_SHORT)) {
+        return false;
+    }
+    return (strstr(response, "ROAMING") != NULL);
 }
 
-bool ESP32_TestConnection(ESP32_Handle *dev) {
-    if (!dev) return false;
+bool ESP32_GetIP(ESP32_Handle *dev, char *ip_address) {
+    if (!dev || !ip_address) return false;
     char response[64];
-    memset(response, 0, sizeof(response));
-    if (ESP32_SendCommandWithResponse(dev, "PING\n", response, ESP32_TIMEOUT_SHORT)) {
-        return (strstr(response, "PONG") != NULL);
+    if (!ESP32_Command(dev, "WIFI_IP\n", ESP32_FRAME_WIFI_IP, response, ESP32_TIMEOUT_SHORT)) {
+        return false;
+    }
+
+    char *ip_start = strstr(response, "IP:");
+    if (ip_start != NULL) {
+        ip_start += 3;
+        size_t len = strcspn(ip_start, "\r\n");
+        if (len > 0 && len < 16) {
+            strncpy(ip_address, ip_start, len);
+            ip_address[len] = '\0';
+            return true;
+        }
     }
     return false;
 }
 
-bool ESP32_Reset(ESP32_Handle *dev) {
-    if (!dev) return false;
-    char response[64];
-    if (ESP32_SendCommandWithResponse(dev, "RESET\n", response, ESP32_TIMEOUT_MEDIUM)) {
-        HAL_Delay(2000);
-        dev->wifi_state = WIFI_DISCONNECTED;
-        return ESP32_TestConnection(dev);
+/* ========================================================================== */
+/* LCD + LOG (fire and forget, replies are not awaited) */
+/* ========================================================================== */
+
+/**
+ * @brief Send an argument-less command without waiting for the reply
+ */
+static void ESP32_Notify(ESP32_Handle *dev, const char *text_cmd, uint8_t frame_type) {
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_FrameBegin(dev, frame_type);
+        ESP32_FrameEnd(dev);
+    } else {
+        ESP32_TxSend(dev, text_cmd, (uint16_t)strlen(text_cmd));
     }
-    return false;
+}
+
+void ESP32_LCD_Init(ESP32_Handle *dev) {
+    if (!dev || !dev->huart) return;
+    ESP32_Notify(dev, "LCD_INIT\n", ESP32_FRAME_LCD_INIT);
+}
+
+void ESP32_LCD_Clear(ESP32_Handle *dev) {
+    if (!dev || !dev->huart) return;
+    ESP32_Notify(dev, "LCD_CLEAR\n", ESP32_FRAME_LCD_CLEAR);
+}
+
+void ESP32_LCD_SetCursor(ESP32_Handle *dev, uint8_t row, uint8_t col) {
+    if (!dev || !dev->huart) return;
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_FrameBegin(dev, ESP32_FRAME_LCD_CURSOR);
+        ESP32_FramePutU8(dev, row);
+        ESP32_FramePutU8(dev, col);
+        ESP32_FrameEnd(dev);
+        return;
+    }
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "LCD_CURSOR,%d,%d\n", row, col);
+    ESP32_TxSend(dev, cmd, (uint16_t)strlen(cmd));
+}
+
+void ESP32_LCD_Print(ESP32_Handle *dev, const char *text) {
+    if (!dev || !dev->huart || !text) return;
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_FrameBegin(dev, ESP32_FRAME_LCD_PRINT);
+        ESP32_FramePutStr(dev, text);
+        ESP32_FrameEnd(dev);
+        return;
+    }
+    const ESP32_TxSegment cmd[] = {
+        { "LCD_PRINT,", 10 }, { text, (uint16_t)strlen(text) }, { "\n", 1 }
+    };
+    ESP32_TxWrite(dev, cmd, 3);
+}
+
+/**
+ * @brief Debug text to the ESP32 console
+ * Plain text on the text link (also before ESP32_Init), LOG frame otherwise,
+ * so it can never be mistaken for a command.
+ */
+void ESP32_Log(ESP32_Handle *dev, const char *msg) {
+    if (!msg) return;
+    if (dev && dev->huart && dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_FrameBegin(dev, ESP32_FRAME_LOG);
+        ESP32_FramePutStr(dev, msg);
+        ESP32_FrameEnd(dev);
+        return;
+    }
+    if (dev && dev->huart) {
+        ESP32_TxSend(dev, msg, (uint16_t)strlen(msg));
+        return;
+    }
+    // Before ESP32_Init the queue is not running yet
+    HAL_UART_Transmit(&huart2, (uint8_t*)msg, strlen(msg), 100);
+}
+
+/**
+ * @brief Register a function to run while an HTTP reply is pending
+ * Only called on the binary link, where the ESP32 keeps serving LCD/LED
+ * commands during HTTP. The hook may use any bridge call except HTTP.
+ */
+void ESP32_SetWaitHook(ESP32_Handle *dev, void (*hook)(void)) {
+    if (!dev) return;
+    dev->wait_hook = hook;
 }
 
 /* ========================================================================== */
-/* COMMAND FUNCTIONS */
+/* HTTP FUNCTIONS */
 /* ========================================================================== */
 
-bool ESP32_SendCommand(ESP32_Handle *dev, const char *cmd) {
-    if (!dev || !cmd) return false;
-    ESP32_ClearBuffer(dev);
-    HAL_StatusTypeDef status = HAL_UART_Transmit(dev->huart, (uint8_t*)cmd, strlen(cmd), 1000);
-    return (status == HAL_OK);
+static bool ESP32_ValidateConnection(ESP32_Handle *dev) {
+    if (dev->wifi_state != WIFI_CONNECTED) {
+        if (!ESP32_CheckConnection(dev)) {
+            // A dropped binary link looks the same, renegotiate and retry once
+            if (dev->link_mode != ESP32_LINK_BINARY || !ESP32_TestConnection(dev) ||
+                !ESP32_CheckConnection(dev)) {
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
-bool ESP32_SendCommandWithResponse(ESP32_Handle *dev, const char *cmd, char *response, uint32_t timeout) {
-    if (!dev || !cmd || !response) return false;
-    ESP32_ClearBuffer(dev);
+/**
+ * @brief Validate, then send a GET (build NULL) or POST request
+ * On the binary link the request slot is claimed before anything is sent.
+ * With a binding the binary link asks the ESP32 for just its fields; the
+ * text link fetches the whole body and binds it on completion.
+ */
+static bool ESP32_HTTP_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                             ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *bind,
+                             HTTP_Response *response, ESP32_HTTPCallback on_done, void *ctx) {
+    ESP32_Async *as = &dev->async;
 
-    HAL_StatusTypeDef status = HAL_UART_Transmit(dev->huart, (uint8_t*)cmd, strlen(cmd), 1000);
-    if (status != HAL_OK) return false;
+    response->body = "";
+    response->body_length = 0;
+    response->success = false;
+    response->status_code = 0;
+    memset(&response->timing, 0, sizeof(response->timing));
+    ESP32_SetError(response->error, "BUSY");
+    if (dev->in_wait_hook) return false;                // rx_buffer holds the outer response
+    if (as->state == ESP32_ASYNC_PENDING) return false;  // ...or the pending one
+    if (dev->link_resync) {
+        dev->link_resync = false;
+        ESP32_TestConnection(dev);
+    }
+    if (!ESP32_ValidateConnection(dev)) {
+        ESP32_SetError(response->error, "NO_WIFI");
+        return false;
+    }
+    response->error[0] = '\0';
+
+    as->response = response;
+    as->on_done = on_done;
+    as->ctx = ctx;
+    as->notify = false;
+    as->req = NULL;
+    as->bind = bind;
+    ESP32_ResetRxStats(dev);
+
+    // The JSON is written by the builder straight into the frame or line
+    JSON_Writer w = { dev, 0, false, true, 0 };
+    bool sent;
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        // JSON is the rest of the frame, COBS delimits it, no length up front
+        uint8_t type;
+        if (bind) {
+            type = build ? ESP32_FRAME_HTTP_POST_FIELDS : ESP32_FRAME_HTTP_GET_FIELDS;
+        } else {
+            type = build ? ESP32_FRAME_HTTP_POST_JSON : ESP32_FRAME_HTTP_GET;
+        }
+        uint8_t seq = ESP32_FrameBegin(dev, type);
+        ESP32_FramePutStr(dev, host);
+        ESP32_FramePutU16(dev, port);
+        ESP32_FramePutStr(dev, path);
+        ESP32_FramePutStr(dev, API_KEY);
+        ESP32_FramePutStr(dev, TERMINAL_ID);
+        if (bind) ESP32_FramePutPaths(dev, bind->binding);
+        if (build) build(&w, build_ctx);
+
+        as->req = ESP32_RequestOpen(dev, seq);
+        sent = (as->req != NULL);
+        if (!ESP32_FrameEnd(dev)) sent = false;
+    } else {
+        // Gathered straight from the caller's strings, no 2 KB staging buffer
+        char port_str[8];
+        uint16_t port_len = (uint16_t)snprintf(port_str, sizeof(port_str), "%d", port);
+        const ESP32_TxSegment head[] = {
+            { build ? "HTTP_POST," : "HTTP_GET,", build ? 10 : 9 },
+            { host, (uint16_t)strlen(host) }, { ",", 1 },
+            { port_str, port_len }, { ",", 1 },
+            { path, (uint16_t)strlen(path) }, { ",", 1 }
+        };
+        ESP32_ClearBuffer(dev);   // stale lines must not pass for the reply
+        sent = ESP32_TxWrite(dev, head, sizeof(head) / sizeof(head[0]));
+        if (build) {
+            build(&w, build_ctx);
+            sent = ESP32_TxSend(dev, ",", 1) && sent;
+        }
+        sent = ESP32_TxSend(dev, API_KEY "," TERMINAL_ID "\n",
+                            sizeof(API_KEY "," TERMINAL_ID "\n") - 1) && sent;
+    }
+    if (!w.ok || w.depth != 0) sent = false;   // the ESP32 would get broken JSON
+
+    if (!sent) {
+        if (as->req) as->req->state = ESP32_REQ_FREE;
+        ESP32_SetError(response->error, "LINK");
+        ESP32_DebugPrint(dev, build ? "💬 [STM32] ❌ Failed to send POST\r\n"
+                                    : "💬 [STM32] ❌ Failed to send GET\r\n");
+        return false;
+    }
+
+    ESP32_DebugPrint(dev, "💬 [STM32] ⏳ Waiting...\r\n");
+    as->start_tick = HAL_GetTick();
+    as->state = ESP32_ASYNC_PENDING;
+
+    if (dev->link_mode == ESP32_LINK_TEXT) {
+        // The text link cannot interleave replies: complete here, report at the next poll
+        as->state = ESP32_WaitHTTPResponse(dev, response, ESP32_TIMEOUT_LONG) ?
+                    ESP32_ASYNC_DONE : ESP32_ASYNC_FAILED;
+        as->notify = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Poll the pending async request to completion, running the wait hook
+ */
+static bool ESP32_HTTP_Wait(ESP32_Handle *dev) {
+    ESP32_AsyncState state;
+
+    while ((state = ESP32_HTTP_Poll(dev)) == ESP32_ASYNC_PENDING) {
+        if (dev->wait_hook && !dev->in_wait_hook) {
+            dev->in_wait_hook = true;
+            dev->wait_hook();
+            dev->in_wait_hook = false;
+        }
+        HAL_Delay(1);
+    }
+    return (state == ESP32_ASYNC_DONE);
+}
+
+/**
+ * @brief Blocking request: a pending async request is finished first,
+ * requests never overlap
+ */
+static bool ESP32_HTTP_Blocking(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *bind,
+                                HTTP_Response *response) {
+    if (!dev->in_wait_hook) ESP32_HTTP_Wait(dev);
+    if (!ESP32_HTTP_Start(dev, host, port, path, build, build_ctx, bind, response, NULL, NULL)) return false;
+    return ESP32_HTTP_Wait(dev);
+}
+
+/**
+ * @brief Builder for a body that is already a JSON string
+ */
+static void ESP32_JSONRaw(JSON_Writer *w, void *ctx) {
+    JSON_AddRaw(w, NULL, (const char *)ctx);
+}
+
+bool ESP32_HTTP_GET(ESP32_Handle *dev, const char *host, uint16_t port,
+                    const char *path, HTTP_Response *response) {
+    if (!dev || !host || !path || !response) return false;
+    return ESP32_HTTP_Blocking(dev, host, port, path, NULL, NULL, NULL, response);
+}
+
+bool ESP32_HTTP_POST(ESP32_Handle *dev, const char *host, uint16_t port,
+                     const char *path, const char *json_data, HTTP_Response *response) {
+    if (!dev || !host || !path || !json_data || !response) return false;
+    return ESP32_HTTP_Blocking(dev, host, port, path, ESP32_JSONRaw, (void *)json_data, NULL, response);
+}
+
+/**
+ * @brief POST whose body is written by @p build while it is being sent
+ */
+bool ESP32_HTTP_POST_JSON(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                          ESP32_JSONBuilder build, void *build_ctx, HTTP_Response *response) {
+    if (!dev || !host || !path || !build || !response) return false;
+    return ESP32_HTTP_Blocking(dev, host, port, path, build, build_ctx, NULL, response);
+}
+
+/**
+ * @brief GET straight into the records of @p target (see JSON_Binding)
+ * The binding's paths go out as the projection; the text link binds the
+ * whole body through the same projector instead.
+ */
+bool ESP32_HTTP_GET_Bind(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                         JSON_BindTarget *target, HTTP_Response *response) {
+    if (!dev || !host || !path || !target || !target->binding || !response) return false;
+    target->found = 0;
+    target->items = 0;
+    return ESP32_HTTP_Blocking(dev, host, port, path, NULL, NULL, target, response);
+}
+
+bool ESP32_HTTP_POST_Bind(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                          ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *target,
+                          HTTP_Response *response) {
+    if (!dev || !host || !path || !build || !target || !target->binding || !response) return false;
+    target->found = 0;
+    target->items = 0;
+    return ESP32_HTTP_Blocking(dev, host, port, path, build, build_ctx, target, response);
+}
+
+/**
+ * @brief Background ESP32_HTTP_GET_Bind, completed by ESP32_HTTP_Poll()
+ * @p target (and the records it points at) must outlive the request.
+ */
+bool ESP32_HTTP_GET_Bind_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                               JSON_BindTarget *target, HTTP_Response *response,
+                               ESP32_HTTPCallback on_done, void *ctx) {
+    if (!dev || !host || !path || !target || !target->binding || !response) return false;
+    target->found = 0;
+    target->items = 0;
+    return ESP32_HTTP_Start(dev, host, port, path, NULL, NULL, target, response, on_done, ctx);
+}
+
+bool ESP32_HTTP_POST_Bind_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                ESP32_JSONBuilder build, void *build_ctx, JSON_BindTarget *target,
+                                HTTP_Response *response, ESP32_HTTPCallback on_done, void *ctx) {
+    if (!dev || !host || !path || !build || !target || !target->binding || !response) return false;
+    target->found = 0;
+    target->items = 0;
+    return ESP32_HTTP_Start(dev, host, port, path, build, build_ctx, target, response, on_done, ctx);
+}
+
+bool ESP32_HTTP_GET_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                          HTTP_Response *response, ESP32_HTTPCallback on_done, void *ctx) {
+    if (!dev || !host || !path || !response) return false;
+    return ESP32_HTTP_Start(dev, host, port, path, NULL, NULL, NULL, response, on_done, ctx);
+}
+
+bool ESP32_HTTP_POST_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                           const char *json_data, HTTP_Response *response,
+                           ESP32_HTTPCallback on_done, void *ctx) {
+    if (!dev || !host || !path || !json_data || !response) return false;
+    return ESP32_HTTP_Start(dev, host, port, path, ESP32_JSONRaw, (void *)json_data, NULL,
+                            response, on_done, ctx);
+}
 
+bool ESP32_HTTP_POST_JSON_Start(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                ESP32_JSONBuilder build, void *build_ctx, HTTP_Response *response,
+                                ESP32_HTTPCallback on_done, void *ctx) {
+    if (!dev || !host || !path || !build || !response) return false;
+    return ESP32_HTTP_Start(dev, host, port, path, build, build_ctx, NULL, response, on_done, ctx);
+}
+
+/**
+ * @brief Advance the async request without blocking; call from the main loop
+ * Drains whatever the link has received, and on completion fills in the
+ * response and runs the callback (from here, never from an interrupt).
+ * @retval PENDING while in flight, then DONE/FAILED until the next start
+ */
+ESP32_AsyncState ESP32_HTTP_Poll(ESP32_Handle *dev) {
+    if (!dev) return ESP32_ASYNC_IDLE;
+    ESP32_Async *as = &dev->async;
+
+    if (as->state == ESP32_ASYNC_PENDING) {
+        ESP32_Request *req = as->req;
+        while (req->state != ESP32_REQ_DONE && ESP32_Pump(dev) != ESP32_EVT_NONE) {
+            if (req->state == ESP32_REQ_DONE && req->evt == ESP32_EVT_LINE &&
+                strncmp(req->reply, "ERROR:", 6) != 0) {
+                req->state = ESP32_REQ_PENDING;   // not an answer to a request
+            }
+        }
+
+        if (req->state == ESP32_REQ_DONE) {
+            // ✅ Errors end the wait as soon as the ESP32 reports them
+            bool done = (req->evt == ESP32_EVT_HTTP || req->evt == ESP32_EVT_HTTP_FIELDS) ?
+                        ESP32_HTTPComplete(dev, as->response, req->evt) :
+                        ESP32_HTTPFail(dev, as->response, req->evt, req->reply);
+            req->state = ESP32_REQ_FREE;
+            as->state = done ? ESP32_ASYNC_DONE : ESP32_ASYNC_FAILED;
+            as->notify = true;
+        } else if ((HAL_GetTick() - as->start_tick) >= ESP32_TIMEOUT_LONG) {
+            req->state = ESP32_REQ_FREE;
+            as->state = ESP32_ASYNC_FAILED;
+            as->notify = true;
+            ESP32_SetError(as->response->error, "TIMEOUT");
+            ESP32_DebugPrint(dev, "💬 [STM32] ⏱️ Timeout!\r\n");
+            // The ESP32 may have restarted in text mode. The resync blocks, so
+            // it waits for the next request instead of holding up this poll.
+            dev->link_resync = true;
+        }
+    }
+
+    if (as->notify) {
+        as->notify = false;
+        if (as->on_done) as->on_done(as->ctx, as->state, as->response);
+    }
+    return as->state;
+}
+
+/**
+ * @brief Drop the pending async request, no callback runs
+ * The ESP32 still completes it; its late reply finds no slot and is discarded.
+ */
+void ESP32_HTTP_Cancel(ESP32_Handle *dev) {
+    if (!dev) return;
+    ESP32_Async *as = &dev->async;
+    if (as->state == ESP32_ASYNC_PENDING && as->req) {
+        as->req->state = ESP32_REQ_FREE;
+    }
+    if (as->state == ESP32_ASYNC_PENDING || as->notify) {
+        as->state = ESP32_ASYNC_CANCELLED;
+        as->notify = false;
+    }
+}
+
+/**
+ * @brief Report and parse the HTTP response the framer just completed
+ */
+static bool ESP32_HTTPComplete(ESP32_Handle *dev, HTTP_Response *response, ESP32_Event evt) {
+    char debug[128];
+    snprintf(debug, sizeof(debug), "💬 [STM32] 📦 Got %d bytes (RX ISR: %lu cycles/KB, %lu IRQs)\r\n",
+             dev->framer.body_len, (unsigned long)ESP32_GetRxCyclesPerKB(dev),
+             (unsigned long)dev->rx_stats.isr_count);
+    ESP32_DebugPrint(dev, debug);
+    bool ok = ESP32_ParseHTTPResponse(dev, response);
+    const HTTP_Timing *t = &response->timing;
+    snprintf(debug, sizeof(debug), "💬 [STM32] ⏱️ dns %u, connect %u%s, request %u, body %u ms%s\r\n",
+             t->dns_ms, t->connect_ms, t->reused ? " (kept open)" : "", t->request_ms, t->body_ms,
+             t->cached ? " (cached)" : "");
+    ESP32_DebugPrint(dev, debug);
+    if (ok && response->success && dev->async.bind) {
+        ESP32_DeliverFields(dev, response, evt == ESP32_EVT_HTTP_FIELDS);
+    }
+    return ok;
+}
+
+/**
+ * @brief Hand the projected values of a completed response to the caller
+ * HTTP_FIELDS records are walked in place in rx_buffer; a whole body (text
+ * link) goes through the same projection here instead.
+ */
+static void ESP32_DeliverFields(ESP32_Handle *dev, HTTP_Response *response, bool records) {
+    JSON_BindTarget *bind = dev->async.bind;
+    uint16_t count = 0;
+
+    if (records) {
+        char *p = (char *)response->body;
+        uint16_t left = response->body_length;
+        while (left >= 4) {
+            uint16_t len = (uint16_t)((uint8_t)p[2] | ((uint8_t)p[3] << 8));
+            if (len > left - 4) break;   // cut off by a truncated frame
+            // The byte after the value is the next record (or the body NUL), lend it
+            char *value = p + 4;
+            char saved = value[len];
+            value[len] = '\0';
+            JSON_BindStore(bind, (uint8_t)p[0], (uint8_t)p[1], value, len);
+            value[len] = saved;
+            p += 4 + len;
+            left -= 4 + len;
+            count++;
+        }
+    } else {
+        JSON_Bind(response->body, response->body_length, bind);
+    }
+
+    if (records) {
+        char debug[64];
+        snprintf(debug, sizeof(debug), "💬 [STM32] 🔎 %d fields from the ESP32\r\n", count);
+        ESP32_DebugPrint(dev, debug);
+    } else {
+        ESP32_DebugPrint(dev, "💬 [STM32] 🔎 Fields projected locally\r\n");
+    }
+    response->body = "";
+    response->body_length = 0;
+}
+
+static void ESP32_SetError(char *dst, const char *reason) {
+    strncpy(dst, reason, ESP32_ERROR_SIZE - 1);
+    dst[ESP32_ERROR_SIZE - 1] = '\0';
+}
+
+/**
+ * @brief Fill in a failed request from an HTTP_ERROR frame or an ERROR:<reason> line
+ * Firmware without HTTP_ERROR reports HTTP failures as ERROR:HTTP_<status>.
+ * @retval true if an HTTP status came back (the request itself completed)
+ */
+static bool ESP32_HTTPFail(ESP32_Handle *dev, HTTP_Response *response, ESP32_Event evt, const char *reason) {
+    if (evt == ESP32_EVT_HTTP_ERROR) {
+        ESP32_ParseHTTPResponse(dev, response);
+    } else {
+        reason += 6;   // skip "ERROR:"
+        response->status_code = (strncmp(reason, "HTTP_", 5) == 0) ? (uint16_t)atoi(reason + 5) : 0;
+        memset(&response->timing, 0, sizeof(response->timing));
+    }
+    response->success = false;
+    ESP32_SetError(response->error, reason);
+
+    char debug[96];
+    snprintf(debug, sizeof(debug), "💬 [STM32] ❌ ESP32 error: %s (HTTP %d, %d byte body)\r\n",
+             response->error, response->status_code, response->body_length);
+    ESP32_DebugPrint(dev, debug);
+    return (response->status_code != 0);
+}
+
+/**
+ * @brief Text link: drive the framer until a complete HTTP response arrives
+ * @retval true once an HTTP status is known, false on timeout or transport errors
+ */
+static bool ESP32_WaitHTTPResponse(ESP32_Handle *dev, HTTP_Response *response, uint32_t timeout) {
     uint32_t start_tick = HAL_GetTick();
+
     while ((HAL_GetTick() - start_tick) < timeout) {
-        if (strchr(dev->rx_buffer, '\n') != NULL) {
-            strcpy(response, dev->rx_buffer);
-            return true;
+        ESP32_Event evt = ESP32_Poll(dev);
+        if (evt == ESP32_EVT_HTTP) {
+            return ESP32_HTTPComplete(dev, response, evt);
+        }
+        if (evt == ESP32_EVT_LINE && strncmp(dev->reply, "ERROR:", 6) == 0) {
+            return ESP32_HTTPFail(dev, response, evt, dev->reply);
+        }
+        if (evt == ESP32_EVT_NONE) HAL_Delay(1);
+    }
+
+    ESP32_SetError(response->error, "TIMEOUT");
+    ESP32_DebugPrint(dev, "💬 [STM32] ⏱️ Timeout!\r\n");
+    return false;
+}
+
+/**
+ * @brief Chunked GET/POST: the body is handed to @p on_body piece by piece
+ * A POST body is written by @p build into the request frame, as for
+ * ESP32_HTTP_POST_JSON. On the text link the whole (size-limited) body is
+ * delivered in one call.
+ */
+static bool ESP32_HTTP_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                              ESP32_JSONBuilder build, void *build_ctx, ESP32_BodyCallback on_body,
+                              void *ctx, HTTP_Response *response) {
+    if (!dev || !host || !path || !on_body || !response) return false;
+    // As ESP32_HTTP_Blocking: a pending async request owns rx_buffer, finish it first
+    if (!dev->in_wait_hook) ESP32_HTTP_Wait(dev);
+
+    if (dev->link_mode == ESP32_LINK_TEXT) {
+        bool ok = ESP32_HTTP_Blocking(dev, host, port, path, build, build_ctx, NULL, response);
+        if (!ok || !response->success) return ok;
+        return on_body(ctx, response->body, response->body_length);
+    }
+
+    response->body = "";
+    response->body_length = 0;
+    response->success = false;
+    response->status_code = 0;
+    memset(&response->timing, 0, sizeof(response->timing));
+    ESP32_SetError(response->error, "BUSY");
+    if (dev->in_wait_hook) return false;   // rx_buffer carries the outer transfer
+    if (!ESP32_ValidateConnection(dev)) {
+        ESP32_SetError(response->error, "NO_WIFI");
+        return false;
+    }
+    ESP32_SetError(response->error, "LINK");
+
+    ESP32_Stream *st = &dev->stream;
+    memset(st, 0, sizeof(*st));
+    st->on_body = on_body;
+    st->ctx = ctx;
+
+    // JSON is the rest of the frame, so the chunk parameters go first
+    JSON_Writer w = { dev, 0, false, true, 0 };
+    st->seq = ESP32_FrameBegin(dev, build ? ESP32_FRAME_HTTP_POST_JSON_CHUNKED
+                                          : ESP32_FRAME_HTTP_GET_CHUNKED);
+    ESP32_FramePutStr(dev, host);
+    ESP32_FramePutU16(dev, port);
+    ESP32_FramePutStr(dev, path);
+    ESP32_FramePutStr(dev, API_KEY);
+    ESP32_FramePutStr(dev, TERMINAL_ID);
+    ESP32_FramePutU16(dev, ESP32_HTTP_CHUNK_SIZE);
+    ESP32_FramePutU8(dev, ESP32_HTTP_CREDITS);
+    if (build) build(&w, build_ctx);
+    if (!ESP32_FrameEnd(dev) || !w.ok || w.depth != 0) {
+        ESP32_DebugPrint(dev, "💬 [STM32] ❌ Failed to send request\r\n");
+        return false;
+    }
+    st->active = true;
+    st->last_tick = HAL_GetTick();
+
+    // Timeout counts from the last frame of this transfer, not from the start
+    while (!st->done && (HAL_GetTick() - st->last_tick) < ESP32_TIMEOUT_LONG) {
+        if (ESP32_Pump(dev) == ESP32_EVT_NONE) {
+            if (dev->wait_hook && !dev->in_wait_hook) {
+                dev->in_wait_hook = true;
+                dev->wait_hook();
+                dev->in_wait_hook = false;
+            }
+            HAL_Delay(1);
         }
-        HAL_Delay(10);
     }
 
-    if (dev->rx_index > 0) {
-        strcpy(response, dev->rx_buffer);
-        return true;
+    if (!st->done) {
+        ESP32_StreamCredit(dev, 0);
+        st->active = false;
+        ESP32_SetError(response->error, "TIMEOUT");
+        ESP32_DebugPrint(dev, "💬 [STM32] ⏱️ Stream timeout!\r\n");
+        return false;
     }
-    return false;
-}
-
-/**
- * @brief Clear ESP32 RX buffer safely (PRODUCTION READY)
- * ✅ Stops UART, clears atomically, restarts cleanly
- */
-void ESP32_ClearBuffer(ESP32_Handle *dev) {
-    if (!dev) return;
 
-    // Stop UART reception completely (aborts any ongoing DMA/IT)
-    HAL_UART_AbortReceive_IT(dev->huart);
+    response->status_code = st->status;
+    response->success = st->ok && (st->status >= 200 && st->status < 300);
+    response->timing = st->timing;
+    ESP32_SetError(response->error, st->error);
 
-    // Memory barrier - ensure all pending writes complete before clearing
-    __DMB();
+    char debug[96];
+    snprintf(debug, sizeof(debug), "💬 [STM32] 📦 Streamed %lu/%lu bytes, status %d\r\n",
+             (unsigned long)st->received, (unsigned long)st->total, st->status);
+    ESP32_DebugPrint(dev, debug);
+    return st->ok;
+}
 
-    // Clear buffer atomically
-    memset((void*)dev->rx_buffer, 0, ESP32_RX_BUFFER_SIZE);
-    dev->rx_index = 0;
-    dev->response_ready = false;
+bool ESP32_HTTP_GET_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                           ESP32_BodyCallback on_body, void *ctx, HTTP_Response *response) {
+    return ESP32_HTTP_Stream(dev, host, port, path, NULL, NULL, on_body, ctx, response);
+}
 
-    // Restart UART reception
-    extern uint8_t uart_rx_byte;
-    HAL_UART_Receive_IT(dev->huart, &uart_rx_byte, 1);
+bool ESP32_HTTP_POST_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                            const char *json_data, ESP32_BodyCallback on_body, void *ctx,
+                            HTTP_Response *response) {
+    if (!json_data) return false;
+    return ESP32_HTTP_Stream(dev, host, port, path, ESP32_JSONRaw, (void *)json_data,
+                             on_body, ctx, response);
 }
 
+/**
+ * @brief Chunked POST whose body is written by @p build while it is being sent
+ */
+bool ESP32_HTTP_POST_JSON_Stream(ESP32_Handle *dev, const char *host, uint16_t port, const char *path,
+                                 ESP32_JSONBuilder build, void *build_ctx,
+                                 ESP32_BodyCallback on_body, void *ctx, HTTP_Response *response) {
+    if (!build) return false;
+    return ESP32_HTTP_Stream(dev, host, port, path, build, build_ctx, on_body, ctx, response);
+}
 
-bool ESP32_WaitForResponse(ESP32_Handle *dev, const char *expected, uint32_t timeout) {
-    if (!dev || !expected) return false;
-    uint32_t start_tick = HAL_GetTick();
-    while ((HAL_GetTick() - start_tick) < timeout) {
-        if (strstr(dev->rx_buffer, expected) != NULL) {
-            return true;
-        }
-        HAL_Delay(10);
+/**
+ * @brief Have the ESP32 open its connection to @p host ahead of the next request
+ * A hint only: nothing is waited for and the ESP32 does not reply.
+ */
+void ESP32_HTTP_Warm(ESP32_Handle *dev, const char *host, uint16_t port) {
+    if (!dev || !dev->huart || !host) return;
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_FrameBegin(dev, ESP32_FRAME_HTTP_WARM);
+        ESP32_FramePutStr(dev, host);
+        ESP32_FramePutU16(dev, port);
+        ESP32_FrameEnd(dev);
+        return;
     }
-    return false;
+    char port_str[8];
+    uint16_t port_len = (uint16_t)snprintf(port_str, sizeof(port_str), ",%u\n", port);
+    const ESP32_TxSegment cmd[] = {
+        { "HTTP_WARM,", 10 }, { host, (uint16_t)strlen(host) }, { port_str, port_len }
+    };
+    ESP32_TxWrite(dev, cmd, 3);
 }
 
-/* ========================================================================== */
-/* LED, WIFI, etc. - ALL UNCHANGED */
-/* ========================================================================== */
-
-bool ESP32_LED_On(ESP32_Handle *dev) {
-    char response[32];
-    if (ESP32_SendCommandWithResponse(dev, "LED_ON\n", response, ESP32_TIMEOUT_SHORT)) {
-        return (strstr(response, "OK") != NULL);
+/**
+ * @brief Let the ESP32 cache GETs on paths starting with @p path for @p ttl_s seconds
+ * After that the cached copy is still answered at once while the ESP32
+ * revalidates it with the backend; 0 stops caching the path. The ESP32 keeps
+ * the rules and copies in flash, no reply.
+ */
+void ESP32_HTTP_Cache(ESP32_Handle *dev, const char *path, uint32_t ttl_s) {
+    if (!dev || !dev->huart || !path) return;
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_FrameBegin(dev, ESP32_FRAME_HTTP_CACHE);
+        ESP32_FramePutStr(dev, path);
+        ESP32_FramePutU32(dev, ttl_s);
+        ESP32_FrameEnd(dev);
+        return;
     }
-    return false;
+    char ttl_str[16];
+    uint16_t ttl_len = (uint16_t)snprintf(ttl_str, sizeof(ttl_str), ",%lu\n", (unsigned long)ttl_s);
+    const ESP32_TxSegment cmd[] = {
+        { "HTTP_CACHE,", 11 }, { path, (uint16_t)strlen(path) }, { ttl_str, ttl_len }
+    };
+    ESP32_TxWrite(dev, cmd, 3);
 }
 
-bool ESP32_LED_Off(ESP32_Handle *dev) {
+/**
+ * @brief Endpoint @p slot of the backends the ESP32 picks from
+ * @param slot: 0 is the host the requests name, 1..3 serve the same API;
+ *        host NULL or "" removes the slot
+ * A request to any listed host goes to the fastest one that is up, and
+ * fails over to the next if it cannot get through. Kept in the ESP32's flash.
+ */
+bool ESP32_HTTP_Backend(ESP32_Handle *dev, uint8_t slot, const char *host, uint16_t port) {
+    if (!dev) return false;
     char response[32];
-    if (ESP32_SendCommandWithResponse(dev, "LED_OFF\n", response, ESP32_TIMEOUT_SHORT)) {
+    if (!host) host = "";
+
+    if (dev->link_mode == ESP32_LINK_BINARY) {
+        uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_HTTP_BACKEND);
+        ESP32_FramePutU8(dev, slot);
+        ESP32_FramePutStr(dev, host);
+        ESP32_FramePutU16(dev, port);
+        if (ESP32_FrameEnd(dev) && ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_SHORT)) {
+            return (strcmp(response, "OK") == 0);
+        }
+        return false;
+    }
+
+    char cmd[128];
+    if (host[0] == '\0') {
+        snprintf(cmd, sizeof(cmd), "HTTP_BACKEND,%u\n", slot);
+    } else {
+        snprintf(cmd, sizeof(cmd), "HTTP_BACKEND,%u,%s,%u\n", slot, host, port);
+    }
+    if (ESP32_SendCommandWithResponse(dev, cmd, response, ESP32_TIMEOUT_SHORT)) {
         return (strstr(response, "OK") != NULL);
     }
     return false;
 }
 
-bool ESP32_LED_Blink(ESP32_Handle *dev, uint8_t times) {
-    char cmd[32];
-    char response[32];
-    snprintf(cmd, sizeof(cmd), "LED_BLINK,%d\n", times);
-    if (ESP32_SendCommandWithResponse(dev, cmd, response, ESP32_TIMEOUT_MEDIUM)) {
-        return (strstr(response, "OK") != NULL);
+/**
+ * @brief Read the ESP32's latency figures for endpoint @p index (binary link)
+ * Walk index up from 0 until it returns false; stats->endpoints tells how
+ * many there are. The text link's STATS reply does not fit a reply line.
+ */
+bool ESP32_GetStats(ESP32_Handle *dev, uint8_t index, ESP32_EndpointStats *stats) {
+    char response[ESP32_LINE_HEAD_SIZE];
+
+    if (!dev || !stats) return false;
+    memset(stats, 0, sizeof(*stats));
+    if (dev->link_mode != ESP32_LINK_BINARY) return false;
+
+    uint8_t seq = ESP32_FrameBegin(dev, ESP32_FRAME_STATS);
+    ESP32_FramePutU8(dev, index);
+    if (!ESP32_FrameEnd(dev)) return false;
+    if (!ESP32_WaitReply(dev, seq, response, ESP32_TIMEOUT_SHORT)) return false;
+
+    // The reply is still the last frame decoded, ERROR:UNKNOWN on old firmware
+    ESP32_Framer *fr = &dev->framer;
+    if (fr->bin_type != ESP32_FRAME_STATS_REPLY) return false;
+    const uint8_t *p = fr->bin_small + fr->body_offset;
+    uint16_t left = fr->body_len;
+
+    stats->endpoints = p[0];
+    uint16_t len = (uint16_t)(p[1] | (p[2] << 8));
+    if (3 + len + 12 * 2 > left) return false;
+    uint16_t keep = (len < ESP32_STATS_NAME_SIZE - 1) ? len : ESP32_STATS_NAME_SIZE - 1;
+    memcpy(stats->name, &p[3], keep);
+    stats->name[keep] = '\0';
+    p += 3 + len;
+
+    uint16_t v[12];
+    for (uint8_t i = 0; i < 12; i++, p += 2) {
+        v[i] = (uint16_t)(p[0] | (p[1] << 8));
     }
-    return false;
+    stats->samples = v[0];
+    stats->errors = v[1];
+    stats->reused = v[2];
+    stats->total_p50 = v[3];
+    stats->total_p95 = v[4];
+    stats->total_p99 = v[5];
+    stats->request_p50 = v[6];
+    stats->request_p95 = v[7];
+    stats->request_p99 = v[8];
+    stats->dns_avg = v[9];
+    stats->connect_avg = v[10];
+    stats->body_avg = v[11];
+    return index < stats->endpoints;
 }
 
-bool ESP32_ConnectWiFi(ESP32_Handle *dev, const char *ssid, const char *password) {
-    if (!dev || !ssid || !password) return false;
-    char cmd[256];
-    dev->wifi_state = WIFI_CONNECTING;
+/* ========================================================================== */
+/* PARSER */
+/* ========================================================================== */
 
-    snprintf(cmd, sizeof(cmd), "WIFI_CONNECT,%s,%s\n", ssid, password);
-    ESP32_ClearBuffer(dev);
+static bool ESP32_ParseHTTPResponse(ESP32_Handle *dev, HTTP_Response *response) {
+    if (!dev || !response) return false;
 
-    if (!ESP32_SendCommand(dev, cmd)) {
-        dev->wifi_state = WIFI_ERROR;
-        return false;
+    const ESP32_Framer *fr = &dev->framer;
+    response->status_code = fr->http_status;
+    response->success = (response->status_code >= 200 && response->status_code < 300);
+    response->error[0] = '\0';
+    if (!response->success) {
+        snprintf(response->error, ESP32_ERROR_SIZE, "HTTP_%d", response->status_code);
     }
 
-    if (ESP32_WaitForResponse(dev, "CONNECTED", 15000)) {
-        dev->wifi_state = WIFI_CONNECTED;
-        return true;
+    char debug[64];
+    snprintf(debug, sizeof(debug), "💬 [STM32] Status: %d\r\n", response->status_code);
+    ESP32_DebugPrint(dev, debug);
+
+    // ✅ Zero-copy: the framer already NUL-terminated the body in rx_buffer
+    response->body = dev->rx_buffer + fr->body_offset;
+    response->body_length = fr->body_len;
+    response->timing = fr->timing;
+
+    if (fr->body_truncated) {
+        // Part of the backend's answer is missing, never treat it as one
+        response->success = false;
+        ESP32_SetError(response->error, "TRUNCATED");
+        ESP32_DebugPrint(dev, "💬 [STM32] ❌ Body truncated\r\n");
     }
+    snprintf(debug, sizeof(debug), "💬 [STM32] Body: %d bytes\r\n", response->body_length);
+    ESP32_DebugPrint(dev, debug);
 
-    dev->wifi_state = WIFI_ERROR;
-    return false;
+    ESP32_DebugPrint(dev, "💬 [STM32] ✅ Parse OK!\r\n");
+    return true;
 }
 
-bool ESP32_DisconnectWiFi(ESP32_Handle *dev) {
-    char response[64];
-    if (ESP32_SendCommandWithResponse(dev, "WIFI_DISCONNECT\n", response, ESP32_TIMEOUT_SHORT)) {
-        if (strstr(response, "OK") != NULL) {
-            dev->wifi_state = WIFI_DISCONNECTED;
-            return true;
-        }
+/* ========================================================================== */
+/* JSON BINDING (projected values into struct records) */
+/* ========================================================================== */
+
+static bool JSON_ParseInt(const char *s, uint16_t len, int32_t *value) {
+    bool neg = (len > 0 && *s == '-');
+    int32_t v = 0;
+    uint16_t i = neg ? 1 : 0;
+
+    if (i >= len || s[i] < '0' || s[i] > '9') return false;
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+        v = v * 10 + (s[i] - '0');
     }
-    return false;
+    *value = neg ? -v : v;
+    return true;
 }
 
-bool ESP32_CheckConnection(ESP32_Handle *dev) {
-    char response[64];
-    if (ESP32_SendCommandWithResponse(dev, "WIFI_STATUS\n", response, ESP32_TIMEOUT_SHORT)) {
-        if (strstr(response, "CONNECTED") != NULL) {
-            dev->wifi_state = WIFI_CONNECTED;
-            return true;
+/**
+ * @brief Store one matched value into its member
+ * Values that do not fit or do not parse leave the member empty and the
+ * field not found.
+ */
+static void JSON_BindStore(JSON_BindTarget *t, uint8_t field, uint8_t item,
+                           const char *value, uint16_t len) {
+    const JSON_Binding *b = t->binding;
+    if (field >= b->count || item >= b->max_items) return;
+    if (b->max_items == 1 && (t->found & (1UL << field))) return;   // first match wins
+
+    const JSON_FieldDesc *fd = &b->fields[field];
+    uint8_t *dst = (uint8_t *)t->base + (uint32_t)item * b->stride + fd->offset;
+    int32_t v;
+
+    switch (fd->type) {
+        case JSON_BIND_STRING:
+            if (len >= fd->size) {
+                dst[0] = '\0';
+                return;
+            }
+            memcpy(dst, value, len);
+            dst[len] = '\0';
+            break;
+
+        case JSON_BIND_INT32:
+            if (!JSON_ParseInt(value, len, &v)) return;
+            memcpy(dst, &v, sizeof(v));
+            break;
+
+        case JSON_BIND_UINT16: {
+            if (!JSON_ParseInt(value, len, &v) || v < 0 || v > 0xFFFF) return;
+            uint16_t u = (uint16_t)v;
+            memcpy(dst, &u, sizeof(u));
+            break;
         }
+
+        case JSON_BIND_BOOL:
+            if (len == 4 && memcmp(value, "true", 4) == 0) *(bool *)dst = true;
+            else if (len == 5 && memcmp(value, "false", 5) == 0) *(bool *)dst = false;
+            else return;
+            break;
+
+        default:
+            return;
     }
-    dev->wifi_state = WIFI_DISCONNECTED;
-    return false;
+
+    t->found |= 1UL << field;
+    if (item >= t->items) t->items = item + 1;
 }
 
-bool ESP32_GetIP(ESP32_Handle *dev, char *ip_address) {
-    if (!dev || !ip_address) return false;
-    char response[64];
-    if (!ESP32_SendCommandWithResponse(dev, "WIFI_IP\n", response, ESP32_TIMEOUT_SHORT)) {
-        return false;
-    }
+/* Whole-body binds run from the main loop only and never nest */
+static JSON_Projector json_bind_parser;
 
-    char *ip_start = strstr(response, "IP:");
-    if (ip_start != NULL) {
-        ip_start += 3;
-        char *ip_end = strchr(ip_start, '\r');
-        if (ip_end == NULL) ip_end = strchr(ip_start, '\n');
-        if (ip_end != NULL) {
-            size_t len = ip_end - ip_start;
-            if (len < 16) {
-                strncpy(ip_address, ip_start, len);
-                ip_address[len] = '\0';
-                return true;
-            }
-        }
-    }
-    return false;
+/**
+ * @brief Fill @p target from a body that is already in memory
+ * Same projector as a streamed body, fed in one slice.
+ * @retval true if at least one field was stored
+ */
+bool JSON_Bind(const char *json, uint16_t len, JSON_BindTarget *target) {
+    if (!json || !target || !target->binding || !target->base) return false;
+    JSON_ProjectBind(&json_bind_parser, target);
+    JSON_ProjectFeed(&json_bind_parser, json, len);
+    return target->found != 0;
 }
 
 /* ========================================================================== */
-/* HTTP FUNCTIONS */
+/* JSON WRITER (straight into the request on the wire) */
 /* ========================================================================== */
 
-static bool ESP32_ValidateConnection(ESP32_Handle *dev) {
-    if (dev->wifi_state != WIFI_CONNECTED) {
-        if (!ESP32_CheckConnection(dev)) {
-            return false;
-        }
+/**
+ * @brief Write JSON bytes into the frame or line being sent
+ */
+static void JSON_Emit(JSON_Writer *w, const char *data, uint16_t len) {
+    if (!w->ok || len == 0) return;
+    if (w->dev->link_mode == ESP32_LINK_BINARY) {
+        ESP32_FramePut(w->dev, data, len);   // errors surface at ESP32_FrameEnd
+    } else if (!ESP32_TxSend(w->dev, data, len)) {
+        w->ok = false;
     }
-    return true;
+    w->length += len;
 }
 
-bool ESP32_HTTP_GET(ESP32_Handle *dev, const char *host, uint16_t port,
-                    const char *path, HTTP_Response *response) {
-    if (!dev || !host || !path || !response) return false;
-    if (!ESP32_ValidateConnection(dev)) {
-        response->success = false;
-        response->status_code = 0;
-        return false;
-    }
-
-    char cmd[1024];
-    snprintf(cmd, sizeof(cmd), "HTTP_GET,%s,%d,%s,%s,%s\n", host, port, path, API_KEY, TERMINAL_ID);
-
-    ESP32_ClearBuffer(dev);
-    if (!ESP32_SendCommand(dev, cmd)) {
-        ESP32_DebugPrint("💬 [STM32] ❌ Failed to send GET\r\n");
-        return false;
+/**
+ * @brief Separator and "key": ahead of a value (key NULL inside arrays)
+ */
+static void JSON_Key(JSON_Writer *w, const char *key) {
+    if (w->need_comma) JSON_Emit(w, ",", 1);
+    w->need_comma = true;
+    if (key) {
+        JSON_Emit(w, "\"", 1);
+        JSON_Emit(w, key, (uint16_t)strlen(key));
+        JSON_Emit(w, "\":", 2);
     }
+}
 
-    ESP32_DebugPrint("💬 [STM32] ⏳ Waiting...\r\n");
-
-    uint32_t start_tick = HAL_GetTick();
-    bool header_found = false;
-
-    while ((HAL_GetTick() - start_tick) < ESP32_TIMEOUT_LONG) {
-        if (!header_found && strstr(dev->rx_buffer, "HTTP_RESPONSE:") != NULL) {
-            header_found = true;
-            ESP32_DebugPrint("💬 [STM32] ✅ Found header\r\n");
-        }
-
-        if (header_found && strstr(dev->rx_buffer, "HTTP_END") != NULL) {
-            char debug[128];
-            snprintf(debug, sizeof(debug), "💬 [STM32] 📦 Got %d bytes\r\n", dev->rx_index);
-            ESP32_DebugPrint(debug);
-            return ESP32_ParseHTTPResponse(dev->rx_buffer, response);
+/**
+ * @brief Quoted, escaped string: runs of plain characters go out in one put
+ * Control characters are escaped too, so a value can never end a text line.
+ */
+static void JSON_EmitEscaped(JSON_Writer *w, const char *str) {
+    const char *run = str;
+
+    JSON_Emit(w, "\"", 1);
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c != '"' && c != '\\' && c >= 0x20) continue;
+
+        JSON_Emit(w, run, (uint16_t)(str - run));
+        run = str + 1;
+        char esc[7];
+        if (c == '"' || c == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)c;
+            JSON_Emit(w, esc, 2);
+        } else {
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            JSON_Emit(w, esc, 6);
         }
-
-        HAL_Delay(50); // Check every 50ms
     }
+    JSON_Emit(w, run, (uint16_t)(str - run));
+    JSON_Emit(w, "\"", 1);
+}
 
-    ESP32_DebugPrint("💬 [STM32] ⏱️ Timeout!\r\n");
-    response->success = false;
-    return false;
+void JSON_BeginObject(JSON_Writer *w, const char *key) {
+    if (!w) return;
+    JSON_Key(w, key);
+    JSON_Emit(w, "{", 1);
+    w->depth++;
+    w->need_comma = false;
 }
 
-bool ESP32_HTTP_POST(ESP32_Handle *dev, const char *host, uint16_t port,
-                     const char *path, const char *json_data, HTTP_Response *response) {
-    if (!dev || !host || !path || !json_data || !response) return false;
-    if (!ESP32_ValidateConnection(dev)) {
-        response->success = false;
-        response->status_code = 0;
-        return false;
+void JSON_EndObject(JSON_Writer *w) {
+    if (!w) return;
+    if (w->depth == 0) {
+        w->ok = false;
+        return;
     }
+    JSON_Emit(w, "}", 1);
+    w->depth--;
+    w->need_comma = true;
+}
 
-    char cmd[2048];
-    snprintf(cmd, sizeof(cmd), "HTTP_POST,%s,%d,%s,%s,%s,%s\n", host, port, path, json_data, API_KEY, TERMINAL_ID);
+void JSON_BeginArray(JSON_Writer *w, const char *key) {
+    if (!w) return;
+    JSON_Key(w, key);
+    JSON_Emit(w, "[", 1);
+    w->depth++;
+    w->need_comma = false;
+}
 
-    ESP32_ClearBuffer(dev);
-    if (!ESP32_SendCommand(dev, cmd)) {
-        ESP32_DebugPrint("💬 [STM32] ❌ Failed to send POST\r\n");
-        return false;
+void JSON_EndArray(JSON_Writer *w) {
+    if (!w) return;
+    if (w->depth == 0) {
+        w->ok = false;
+        return;
     }
+    JSON_Emit(w, "]", 1);
+    w->depth--;
+    w->need_comma = true;
+}
 
-    ESP32_DebugPrint("💬 [STM32] ⏳ Waiting...\r\n");
+void JSON_AddString(JSON_Writer *w, const char *key, const char *value) {
+    if (!w) return;
+    JSON_Key(w, key);
+    JSON_EmitEscaped(w, value ? value : "");
+}
 
-    uint32_t start_tick = HAL_GetTick();
-    bool header_found = false;
+void JSON_AddInt(JSON_Writer *w, const char *key, int32_t value) {
+    if (!w) return;
+    char num[12];
+    JSON_Key(w, key);
+    JSON_Emit(w, num, (uint16_t)snprintf(num, sizeof(num), "%ld", (long)value));
+}
 
-    while ((HAL_GetTick() - start_tick) < ESP32_TIMEOUT_LONG) {
-        if (!header_found && strstr(dev->rx_buffer, "HTTP_RESPONSE:") != NULL) {
-            header_found = true;
-            ESP32_DebugPrint("💬 [STM32] ✅ Found header\r\n");
-        }
+void JSON_AddBool(JSON_Writer *w, const char *key, bool value) {
+    if (!w) return;
+    JSON_Key(w, key);
+    JSON_Emit(w, value ? "true" : "false", value ? 4 : 5);
+}
 
-        if (header_found && strstr(dev->rx_buffer, "HTTP_END") != NULL) {
-            return ESP32_ParseHTTPResponse(dev->rx_buffer, response);
+/**
+ * @brief Binary data as an uppercase hex string, encoded on the fly
+ */
+void JSON_AddHex(JSON_Writer *w, const char *key, const uint8_t *data, uint16_t len) {
+    static const char hex[] = "0123456789ABCDEF";
+    char out[32];
+    uint16_t n = 0;
+
+    if (!w || (!data && len)) return;
+    JSON_Key(w, key);
+    JSON_Emit(w, "\"", 1);
+    while (len--) {
+        out[n++] = hex[*data >> 4];
+        out[n++] = hex[*data++ & 0x0F];
+        if (n == sizeof(out)) {
+            JSON_Emit(w, out, n);
+            n = 0;
         }
+    }
+    JSON_Emit(w, out, n);
+    JSON_Emit(w, "\"", 1);
+}
 
-        HAL_Delay(50);
+/**
+ * @brief Binary data as a base64 string
+ * The binary link carries the raw bytes as a blob and the ESP32 encodes them,
+ * so the UART sees 3 bytes where the backend gets 4; the text link encodes here.
+ */
+void JSON_AddBase64(JSON_Writer *w, const char *key, const uint8_t *data, uint16_t len) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char out[32];
+    uint16_t n = 0;
+
+    if (!w || (!data && len)) return;
+    JSON_Key(w, key);
+    JSON_Emit(w, "\"", 1);
+    if (w->dev->link_mode == ESP32_LINK_BINARY) {
+        char blob[3] = { ESP32_JSON_BLOB, (char)(len & 0xFF), (char)(len >> 8) };
+        JSON_Emit(w, blob, 3);
+        JSON_Emit(w, (const char *)data, len);
+        JSON_Emit(w, "\"", 1);
+        return;
     }
+    while (len > 0) {
+        uint32_t v = (uint32_t)data[0] << 16;
+        if (len > 1) v |= (uint32_t)data[1] << 8;
+        if (len > 2) v |= data[2];
+        out[n++] = b64[(v >> 18) & 0x3F];
+        out[n++] = b64[(v >> 12) & 0x3F];
+        out[n++] = (len > 1) ? b64[(v >> 6) & 0x3F] : '=';
+        out[n++] = (len > 2) ? b64[v & 0x3F] : '=';
+        if (n == sizeof(out)) {
+            JSON_Emit(w, out, n);
+            n = 0;
+        }
+        data += (len > 3) ? 3 : len;
+        len -= (len > 3) ? 3 : len;
+    }
+    JSON_Emit(w, out, n);
+    JSON_Emit(w, "\"", 1);
+}
 
-    ESP32_DebugPrint("💬 [STM32] ⏱️ Timeout!\r\n");
-    response->success = false;
-    return false;
+/**
+ * @brief Pre-serialised JSON value, written as is
+ */
+void JSON_AddRaw(JSON_Writer *w, const char *key, const char *json) {
+    if (!w || !json) return;
+    JSON_Key(w, key);
+    JSON_Emit(w, json, (uint16_t)strlen(json));
 }
 
 /* ========================================================================== */
-/* PARSER */
+/* JSON PROJECTION (requested fields only, one byte at a time) */
 /* ========================================================================== */
 
-static bool ESP32_ParseHTTPResponse(const char *raw_response, HTTP_Response *response) {
-    if (!raw_response || !response) return false;
+enum {
+    JSON_PROJ_VALUE = 0,               /* between tokens */
+    JSON_PROJ_STRING,
+    JSON_PROJ_ESCAPE,
+    JSON_PROJ_UNICODE,
+    JSON_PROJ_LITERAL                  /* number, true, false, null */
+};
 
-    response->success = false;
-    response->status_code = 0;
-    response->body_length = 0;
-    memset(response->body, 0, sizeof(response->body));
-
-    const char *status_start = strstr(raw_response, "HTTP_RESPONSE:");
-    if (!status_start) {
-        ESP32_DebugPrint("💬 [STM32] ❌ No HTTP_RESPONSE\r\n");
-        return false;
-    }
-
-    status_start += strlen("HTTP_RESPONSE:");
-    response->status_code = (uint16_t)atoi(status_start);
-    response->success = (response->status_code >= 200 && response->status_code < 300);
+enum {
+    JSON_CAP_STRING = 0,               /* unescaped text */
+    JSON_CAP_LITERAL,                  /* as written */
+    JSON_CAP_CONTAINER                 /* compact JSON of the object/array */
+};
 
-    char debug[64];
-    snprintf(debug, sizeof(debug), "💬 [STM32] Status: %d\r\n", response->status_code);
-    ESP32_DebugPrint(debug);
+/**
+ * @brief Start filling @p target from a body fed in slices
+ * Records are complete once target->items has moved past them.
+ */
+void JSON_ProjectBind(JSON_Projector *p, JSON_BindTarget *target) {
+    if (!p || !target) return;
+    memset(p, 0, sizeof(*p));
+    p->bind = target;
+    p->field = -1;
+    target->found = 0;
+    target->items = 0;
+}
 
-    const char *body_start = strstr(raw_response, "BODY:");
-    if (!body_start) {
-        ESP32_DebugPrint("💬 [STM32] ❌ No BODY\r\n");
-        return false;
+/**
+ * @brief Feed the next slice of the body; matches are reported as they end
+ */
+void JSON_ProjectFeed(JSON_Projector *p, const char *data, uint16_t len) {
+    if (!p || !data || !p->bind || !p->bind->binding) return;
+    while (len--) {
+        JSON_ProjByte(p, *data++);
     }
+}
 
-    body_start += strlen("BODY:");
-    const char *end_marker = strstr(body_start, "HTTP_END");
-    if (!end_marker) {
-        ESP32_DebugPrint("💬 [STM32] ❌ No HTTP_END\r\n");
-        return false;
+static void JSON_ProjPut(JSON_Projector *p, char c) {
+    if (p->value_len < JSON_PROJ_VALUE_SIZE - 1) {
+        p->value[p->value_len++] = c;
+    } else {
+        p->value_len = JSON_PROJ_VALUE_SIZE;   // too long, a cut value must not be stored
     }
+}
 
-    const char *body_end = end_marker;
-    while (body_end > body_start && (*(body_end - 1) == '\r' || *(body_end - 1) == '\n')) {
-        body_end--;
+/**
+ * @brief Decoded string text: into the member name or the captured string
+ */
+static void JSON_ProjText(JSON_Projector *p, char c) {
+    if (p->in_key) {
+        if (p->depth == 0 || p->depth > JSON_PROJ_MAX_DEPTH) return;
+        JSON_PathLevel *lvl = &p->level[p->depth - 1];
+        if (p->key_len >= JSON_PROJ_KEY_SIZE) {
+            lvl->key_len = 0;   // too long, must never match
+            return;
+        }
+        p->keys[p->depth - 1][p->key_len++] = c;
+        lvl->key_len = p->key_len;
+    } else if (p->field >= 0 && p->cap_kind == JSON_CAP_STRING) {
+        JSON_ProjPut(p, c);
     }
+}
 
-    size_t body_len = (size_t)(body_end - body_start);
-    if (body_len >= sizeof(response->body)) {
-        body_len = sizeof(response->body) - 1;
+static void JSON_ProjPutUTF8(JSON_Projector *p, uint16_t cp) {
+    if (cp < 0x80) {
+        JSON_ProjText(p, (char)cp);
+    } else if (cp < 0x800) {
+        JSON_ProjText(p, (char)(0xC0 | (cp >> 6)));
+        JSON_ProjText(p, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        JSON_ProjText(p, (char)(0xE0 | (cp >> 12)));
+        JSON_ProjText(p, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        JSON_ProjText(p, (char)(0x80 | (cp & 0x3F)));
     }
-
-    memcpy(response->body, body_start, body_len);
-    response->body[body_len] = '\0';
-    response->body_length = (uint16_t)body_len;
-
-    snprintf(debug, sizeof(debug), "💬 [STM32] Body: %d bytes\r\n", response->body_length);
-    ESP32_DebugPrint(debug);
-
-    ESP32_DebugPrint("💬 [STM32] ✅ Parse OK!\r\n");
-    return true;
 }
 
-/* ========================================================================== */
-/* JSON FUNCTIONS - ALL UNCHANGED */
-/* ========================================================================== */
-
-bool JSON_GetString(const char *json, const char *key, char *value, uint16_t max_len) {
-    if (!json || !key || !value) return false;
-    char search_key[64];
-    snprintf(search_key, sizeof(search_key), "\"%s\":", key);
-    char *key_pos = strstr(json, search_key);
-    if (key_pos == NULL) return false;
-
-    char *value_start = strchr(key_pos + strlen(search_key), '"');
-    if (value_start == NULL) return false;
-    value_start++;
-
-    char *value_end = strchr(value_start, '"');
-    if (value_end == NULL) return false;
+static void JSON_ProjEmit(JSON_Projector *p) {
+    if (p->value_len < JSON_PROJ_VALUE_SIZE) {
+        p->value[p->value_len] = '\0';
+        JSON_BindStore(p->bind, (uint8_t)p->field, p->item, p->value, p->value_len);
+    }
+    p->field = -1;
+}
 
-    size_t len = value_end - value_start;
-    if (len >= max_len) len = max_len - 1;
+/**
+ * @brief Next step of a projection path: a key (*key set) or a selector (*key NULL)
+ * @retval position after the step, NULL at the end of the path
+ */
+static const char *JSON_PathStep(const char *s, const char **key, uint8_t *key_len,
+                                 uint16_t *lo, uint16_t *hi) {
+    if (*s == '.') s++;
+    if (*s == '\0' || *s == ',') return NULL;
+
+    if (*s == '[') {
+        *key = NULL;
+        *lo = 0;
+        *hi = 0xFFFF;
+        s++;
+        if (*s >= '0' && *s <= '9') {
+            for (*lo = 0; *s >= '0' && *s <= '9'; s++) *lo = (uint16_t)(*lo * 10 + (*s - '0'));
+            *hi = *lo + 1;
+        }
+        if (*s == ':') {
+            s++;
+            *hi = 0xFFFF;
+            if (*s >= '0' && *s <= '9') {
+                for (*hi = 0; *s >= '0' && *s <= '9'; s++) *hi = (uint16_t)(*hi * 10 + (*s - '0'));
+            }
+        }
+        if (*s == ']') s++;
+        return s;
+    }
 
-    strncpy(value, value_start, len);
-    value[len] = '\0';
-    return true;
+    *key = s;
+    while (*s != '\0' && *s != '.' && *s != '[' && *s != ',') s++;
+    *key_len = (uint8_t)(s - *key);
+    return s;
 }
 
-bool JSON_GetInt(const char *json, const char *key, int32_t *value) {
-    if (!json || !key || !value) return false;
-    char search_key[64];
-    snprintf(search_key, sizeof(search_key), "\"%s\":", key);
-    char *key_pos = strstr(json, search_key);
-    if (key_pos == NULL) return false;
-
-    char *value_start = key_pos + strlen(search_key);
-    while (*value_start == ' ' || *value_start == '\t') value_start++;
+/**
+ * @brief Is the value at @p level[0..depth) on path @p spec?
+ * spec ends at ',' or NUL.
+ * @param item: set to the index in the innermost array on the path
+ */
+static bool JSON_PathMatch(const char *spec, const JSON_PathLevel *level, uint8_t depth, uint8_t *item) {
+    const char *key;
+    uint8_t key_len = 0;
+    uint16_t lo, hi;
+    uint8_t steps = 0;
+
+    bool anywhere = (spec[0] == '.' && spec[1] == '.');
+    if (anywhere) spec += 2;
+    for (const char *s = spec; (s = JSON_PathStep(s, &key, &key_len, &lo, &hi)) != NULL; ) {
+        steps++;
+    }
+    if (steps == 0 || depth > JSON_PROJ_MAX_DEPTH) return false;
+    if (anywhere ? (depth < steps) : (depth != steps)) return false;
+
+    // A leading ".." lines the steps up with the innermost levels
+    const JSON_PathLevel *lvl = &level[depth - steps];
+    for (const char *s = spec; (s = JSON_PathStep(s, &key, &key_len, &lo, &hi)) != NULL; lvl++) {
+        if (key) {
+            if (lvl->array || key_len == 0 || lvl->key_len != key_len ||
+                memcmp(lvl->key, key, key_len) != 0) {
+                return false;
+            }
+        } else if (!lvl->array || lvl->index < lo || lvl->index >= hi) {
+            return false;
+        }
+    }
 
-    *value = atoi(value_start);
+    *item = 0;
+    for (uint8_t i = 0; i < depth; i++) {
+        if (level[i].array) *item = (level[i].index > 0xFF) ? 0xFF : (uint8_t)level[i].index;
+    }
     return true;
 }
 
-bool JSON_GetBool(const char *json, const char *key, bool *value) {
-    if (!json || !key || !value) return false;
-    char search_key[64];
-    snprintf(search_key, sizeof(search_key), "\"%s\":", key);
-    char *key_pos = strstr(json, search_key);
-    if (key_pos == NULL) return false;
-
-    char *value_start = key_pos + strlen(search_key);
-    while (*value_start == ' ' || *value_start == '\t') value_start++;
-
-    if (strncmp(value_start, "true", 4) == 0) {
-        *value = true;
-        return true;
-    } else if (strncmp(value_start, "false", 5) == 0) {
-        *value = false;
-        return true;
+/**
+ * @brief A value begins at the current path, capture it if it is projected
+ * Values inside a captured one are part of it, never matched on their own.
+ */
+static void JSON_ProjValueStart(JSON_Projector *p, uint8_t kind) {
+    if (p->field >= 0) return;
+
+    const JSON_Binding *b = p->bind->binding;
+    for (uint8_t f = 0; f < b->count; f++) {
+        uint8_t item;
+        if (JSON_PathMatch(b->fields[f].path, p->level, p->depth, &item)) {
+            p->field = f;
+            p->item = item;
+            p->cap_kind = kind;
+            p->cap_depth = p->depth;
+            p->value_len = 0;
+            return;
+        }
     }
-    return false;
 }
 
-bool JSON_ArrayGetItem(const char *json, const char *array_key, uint16_t index,
-                       char *item, uint16_t max_len) {
-    if (!json || !array_key || !item) return false;
-    char search_key[64];
-    snprintf(search_key, sizeof(search_key), "\"%s\":[", array_key);
-    char *array_start = strstr(json, search_key);
-    if (array_start == NULL) return false;
-    array_start += strlen(search_key);
-
-    uint16_t current_index = 0;
-    char *current_pos = array_start;
-    while (current_index < index) {
-        current_pos = strchr(current_pos, ',');
-        if (current_pos == NULL) return false;
-        current_pos++;
-        current_index++;
-    }
-
-    while (*current_pos == ' ' || *current_pos == '\t' || *current_pos == '\n')
-        current_pos++;
-
-    if (*current_pos == '{') {
-        char *obj_end = strchr(current_pos, '}');
-        if (obj_end == NULL) return false;
-        size_t len = obj_end - current_pos + 1;
-        if (len >= max_len) len = max_len - 1;
-        strncpy(item, current_pos, len);
-        item[len] = '\0';
-        return true;
+static void JSON_ProjByte(JSON_Projector *p, char c) {
+    bool raw = (p->field >= 0 && p->cap_kind == JSON_CAP_CONTAINER);
+
+    switch (p->state) {
+        case JSON_PROJ_STRING:
+            if (raw) JSON_ProjPut(p, c);
+            if (c == '\\') {
+                p->state = JSON_PROJ_ESCAPE;
+            } else if (c == '"') {
+                p->state = JSON_PROJ_VALUE;
+                if (!p->in_key && p->field >= 0 && p->cap_kind == JSON_CAP_STRING) JSON_ProjEmit(p);
+                p->in_key = false;
+            } else {
+                JSON_ProjText(p, c);
+            }
+            return;
+
+        case JSON_PROJ_ESCAPE:
+            if (raw) JSON_ProjPut(p, c);
+            p->state = JSON_PROJ_STRING;
+            switch (c) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u':
+                    p->state = JSON_PROJ_UNICODE;
+                    p->uni = 0;
+                    p->uni_left = 4;
+                    return;
+                default: break;   // \" \\ \/ stand for themselves
+            }
+            JSON_ProjText(p, c);
+            return;
+
+        case JSON_PROJ_UNICODE:
+            if (raw) JSON_ProjPut(p, c);
+            p->uni <<= 4;
+            if (c >= '0' && c <= '9') p->uni |= (uint16_t)(c - '0');
+            else if (c >= 'a' && c <= 'f') p->uni |= (uint16_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') p->uni |= (uint16_t)(c - 'A' + 10);
+            if (--p->uni_left == 0) {
+                p->state = JSON_PROJ_STRING;
+                JSON_ProjPutUTF8(p, p->uni);
+            }
+            return;
+
+        case JSON_PROJ_LITERAL:
+            if (c != ',' && c != '}' && c != ']' && c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                if (p->field >= 0) JSON_ProjPut(p, c);
+                return;
+            }
+            p->state = JSON_PROJ_VALUE;
+            if (p->field >= 0 && p->cap_kind == JSON_CAP_LITERAL) JSON_ProjEmit(p);
+            raw = (p->field >= 0 && p->cap_kind == JSON_CAP_CONTAINER);
+            break;   // the delimiter is handled below
+
+        default:
+            break;
     }
-    return false;
-}
 
-int16_t JSON_ArrayGetCount(const char *json, const char *array_key) {
-    if (!json || !array_key) return -1;
-    char search_key[64];
-    snprintf(search_key, sizeof(search_key), "\"%s\":[", array_key);
-    char *array_start = strstr(json, search_key);
-    if (array_start == NULL) return -1;
-    array_start += strlen(search_key);
-
-    int16_t count = 0;
-    char *pos = array_start;
-    bool in_item = false;
-    while (*pos != ']' && *pos != '\0') {
-        if (*pos == '{' || (*pos >= '0' && *pos <= '9') || *pos == '"') {
-            if (!in_item) {
-                count++;
-                in_item = true;
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n':
+            return;
+
+        case ':':
+            if (raw) JSON_ProjPut(p, c);
+            p->expect_key = false;
+            return;
+
+        case ',':
+            if (raw) JSON_ProjPut(p, c);
+            if (p->depth > 0 && p->depth <= JSON_PROJ_MAX_DEPTH) {
+                JSON_PathLevel *lvl = &p->level[p->depth - 1];
+                if (lvl->array) lvl->index++;
+                else p->expect_key = true;
             }
-        }
-        if (*pos == ',' || *pos == ']') {
-            in_item = false;
-        }
-        pos++;
+            return;
+
+        case '{':
+        case '[':
+            JSON_ProjValueStart(p, JSON_CAP_CONTAINER);
+            if (p->field >= 0 && p->cap_kind == JSON_CAP_CONTAINER) JSON_ProjPut(p, c);
+            if (p->depth < JSON_PROJ_MAX_DEPTH) {
+                JSON_PathLevel *lvl = &p->level[p->depth];
+                lvl->array = (c == '[');
+                lvl->index = 0;
+                lvl->key = p->keys[p->depth];
+                lvl->key_len = 0;
+            }
+            if (p->depth < 0xFF) p->depth++;
+            p->expect_key = (c == '{');
+            return;
+
+        case '}':
+        case ']':
+            if (raw) JSON_ProjPut(p, c);
+            if (p->depth > 0) p->depth--;
+            p->expect_key = false;
+            if (raw && p->depth == p->cap_depth) JSON_ProjEmit(p);
+            return;
+
+        case '"':
+            p->in_key = p->expect_key;
+            if (p->in_key) {
+                p->key_len = 0;
+                if (p->depth > 0 && p->depth <= JSON_PROJ_MAX_DEPTH) p->level[p->depth - 1].key_len = 0;
+            } else {
+                JSON_ProjValueStart(p, JSON_CAP_STRING);
+            }
+            if (p->field >= 0 && p->cap_kind == JSON_CAP_CONTAINER) JSON_ProjPut(p, c);
+            p->state = JSON_PROJ_STRING;
+            return;
+
+        default:
+            JSON_ProjValueStart(p, JSON_CAP_LITERAL);
+            if (p->field >= 0) JSON_ProjPut(p, c);
+            p->state = JSON_PROJ_LITERAL;
+            return;
     }
-    return count;
 }
 
 const char* ESP32_GetStatusString(ESP32_Status status) {
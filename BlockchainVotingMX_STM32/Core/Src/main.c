@@ -29,18 +29,52 @@
 #define WIFI_PASSWORD   "123456789"               // ⚠️ CHANGE THIS!
 #define BACKEND_HOST    "automatic-space-garbanzo-x5wjwqpqqjgqhv4w9-3000.app.github.dev"            // ⚠️ YOUR PC IP!
 #define BACKEND_PORT    443
+/* Optional further backends serving the same API (e.g. a station-local relay
+ * or the cloud), in order of preference after BACKEND_HOST; "" = none */
+#define BACKEND_HOST_2  ""
+#define BACKEND_PORT_2  443
+#define BACKEND_HOST_3  ""
+#define BACKEND_PORT_3  443
 #define TERMINAL_ID     "TERM_001"
 #define API_KEY         "voter-secret-key-456"
 
+/* Optional fixed address, skips DHCP on every (re)join; "" = DHCP */
+#define WIFI_STATIC_IP  ""
+#define WIFI_GATEWAY    ""
+#define WIFI_SUBNET     "255.255.255.0"
+#define WIFI_DNS        ""              // "" = the gateway
+
+/* Optional networks to roam to when they serve better than WIFI_SSID; "" = none */
+#define WIFI_SSID_2     ""
+#define WIFI_PASSWORD_2 ""
+#define WIFI_SSID_3     ""
+#define WIFI_PASSWORD_3 ""
+
 /* API Endpoints */
 #define API_BASE        "/api/v1/terminal"
 #define API_ELECTIONS   "/api/v1/terminal/elections"
 #define API_VERIFY      "/api/v1/terminal/verify-identity"
+#define API_MATCH_TEMPLATE "/api/v1/terminal/match-template"
+#define API_CAPABILITIES "/api/v1/terminal/capabilities"
 #define API_SEND_OTP    "/api/v1/terminal/send-otp"
 #define API_VERIFY_OTP  "/api/v1/terminal/verify-otp"
 #define API_CAST_VOTE   "/api/v1/terminal/cast-vote"
 #define API_GET_RECEIPT "/api/v1/terminal/receipt"
 #define API_SEND_EMAIL  "/api/v1/terminal/send-receipt-email"
+#define API_GET_CANDIDATES "/api/v1/terminal/get-candidates"
+
+/* Idle-time prefetch of the election and candidate lists (ms). The one cache
+ * layer for them: the ESP32 response cache is left off for these paths, so a
+ * list is never older than PREFETCH_MAX_AGE_MS. */
+#define PREFETCH_REFRESH_MS 60000    // refreshed this often while the terminal waits
+#define PREFETCH_MAX_AGE_MS 300000   // older lists are fetched on demand instead
+#define PREFETCH_RETRY_MS   15000    // pause after a failed prefetch
+
+/* 1 = print the ESP32's per-endpoint latency figures after every session
+ * (one STATS round trip per endpoint, between voters) */
+#ifndef LOG_NETWORK_STATS
+#define LOG_NETWORK_STATS   0
+#endif
 
 /* Voting Flow States */
 typedef enum {
@@ -64,7 +98,6 @@ typedef enum {
 typedef struct {
     char id[32];
     char name[64];
-    char description[128];
 } Election;
 
 /* Candidate Structure */
@@ -101,6 +134,7 @@ typedef struct {
 
     // OTP Data
     char otp[7];
+    bool otp_sent;          // set when the background send-OTP request succeeds
 
     // Receipt Data
     char transaction_id[128];
@@ -112,6 +146,38 @@ typedef struct {
     uint8_t retry_count;
 } VotingSession;
 
+/* Prefetch in flight */
+typedef enum {
+    PREFETCH_NONE = 0,
+    PREFETCH_ELECTIONS,
+    PREFETCH_CANDIDATES
+} PrefetchJob;
+
+/* Lists fetched while the terminal waits for input, ready before they are needed */
+typedef struct {
+    Election elections[10];
+    uint8_t election_count;
+    uint16_t elections_version;        // bumped when the list changes, 0 = none yet
+    uint32_t elections_tick;           // last refresh
+
+    char candidates_for[32];           // election id
+    Candidate candidates[5];
+    uint8_t candidate_count;
+    uint16_t candidates_version;       // bumped when the list changes, 0 = none yet
+    uint16_t candidates_elections;     // elections_version they were fetched under
+    uint32_t candidates_tick;
+
+    PrefetchJob job;
+    char job_election[32];             // PREFETCH_CANDIDATES: for which election
+    bool backoff;                      // last prefetch failed at backoff_tick
+    uint32_t backoff_tick;
+    JSON_BindTarget target;
+    union {
+        Election elections[10];
+        Candidate candidates[5];
+    } staging;                         // responses land here, the lists stay usable meanwhile
+} PrefetchCache;
+
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -134,16 +200,28 @@ UART_HandleTypeDef huart2;
 DMA_HandleTypeDef hdma_usart1_rx;
 DMA_HandleTypeDef hdma_usart1_tx;
 DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
 R307_Handle fingerprint;
 ESP32_Handle esp32;
 VotingSession session;
 
-/* Large buffers for JSON */
-char json_buffer[512];
+/* Large buffers */
 char response_buffer[512];
 char debug_buffer[256];
+
+/* Loading screen animation while a backend call is in flight */
+static bool loading_active = false;
+static char loading_line[17];           // second LCD row, queued by body callbacks
+static bool loading_line_due = false;
+
+/* Background (async) backend request */
+static HTTP_Response async_response;
+static bool input_abort = false;   // makes the keypad input prompt give up
+
+/* Idle-time prefetch */
+static PrefetchCache prefetch;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -160,6 +238,7 @@ void LCD_Print(const char *format, ...);
 void LCD_Clear(void);
 void LCD_SetCursor(uint8_t row, uint8_t col);
 void Reset_Session(void);
+void Log_NetworkStats(void);
 void SHA256_Hash_Hex(const char *input, char *output_hex);
 
 // Voting Flow Functions
@@ -180,20 +259,31 @@ void State_ShowReceipt(void);
 // Backend API Functions
 bool Backend_GetElections(void);
 bool Backend_VerifyIdentity(void);
-bool Backend_SendOTP(void);
+bool Backend_SendOTP_Start(void);
+bool Backend_SendOTP_Finish(void);
 bool Backend_VerifyOTP(void);
 bool Backend_GetCandidates(void);
 bool Backend_CastVote(void);
 bool Backend_GetReceipt(void);
 bool Backend_SendReceiptEmail(void);
 
+// Idle Prefetch
+void Prefetch_Tick(void);
+void Prefetch_Wait(void);
+bool Prefetch_UseElections(void);
+bool Prefetch_UseCandidates(void);
+void Prefetch_PutElections(const Election *list, uint8_t count);
+void Prefetch_PutCandidates(const char *election_id, const Candidate *list, uint8_t count);
+
 // UI Helper Functions
 bool Get_Number_Input(char *buffer, uint8_t max_len, const char *prompt);
 bool Get_String_Input(char *buffer, uint8_t max_len, const char *prompt);
 uint8_t Show_Scrolling_List(const char items[][64], uint8_t count, const char *title);
 void Show_Loading(const char *message);
+void Loading_Tick(void);
 void Show_Error(const char *message);
 void Show_Success(const char *message);
+void Input_Idle(uint32_t ms);
 
 /* USER CODE END PFP */
 
@@ -208,7 +298,15 @@ void Debug_Printf(const char *format, ...)
     va_start(args, format);
     vsnprintf(debug_buffer, sizeof(debug_buffer), format, args);
     va_end(args);
-    HAL_UART_Transmit(&huart2, (uint8_t*)debug_buffer, strlen(debug_buffer), 100);
+    ESP32_Log(&esp32, debug_buffer);
+}
+
+/**
+  * @brief  R307 driver logger, sends its text through the ESP32 TX queue
+  */
+static void R307_Log(const char *msg)
+{
+    ESP32_Log(&esp32, msg);
 }
 
 /**
@@ -222,10 +320,7 @@ void LCD_Print(const char *format, ...)
     vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
 
-    char cmd[150];
-    snprintf(cmd, sizeof(cmd), "LCD_PRINT,%s\n", buffer);
-    HAL_UART_Transmit(&huart2, (uint8_t*)cmd, strlen(cmd), 100);
-    HAL_Delay(50);
+    ESP32_LCD_Print(&esp32, buffer);
 }
 
 /**
@@ -233,8 +328,8 @@ void LCD_Print(const char *format, ...)
   */
 void LCD_Clear(void)
 {
-    HAL_UART_Transmit(&huart2, (uint8_t*)"LCD_CLEAR\n", 10, 100);
-    HAL_Delay(50);
+    loading_active = false;
+    ESP32_LCD_Clear(&esp32);
 }
 
 /**
@@ -242,10 +337,7 @@ void LCD_Clear(void)
   */
 void LCD_SetCursor(uint8_t row, uint8_t col)
 {
-    char cmd[32];
-    snprintf(cmd, sizeof(cmd), "LCD_CURSOR,%d,%d\n", row, col);
-    HAL_UART_Transmit(&huart2, (uint8_t*)cmd, strlen(cmd), 100);
-    HAL_Delay(30);
+    ESP32_LCD_SetCursor(&esp32, row, col);
 }
 
 /**
@@ -268,15 +360,68 @@ void SHA256_Hash_Hex(const char *input, char *output_hex)
   */
 void Reset_Session(void)
 {
+    ESP32_HTTP_Cancel(&esp32);
+    prefetch.job = PREFETCH_NONE;   // a cancelled request never calls back
+    input_abort = false;
     memset(&session, 0, sizeof(VotingSession));
     session.state = STATE_SELECT_ELECTION;
     session.retry_count = 0;
 
+    // No voter mid-flow: if the ESP32 is to change networks, now; the warm-up waits for it
+    if (ESP32_WiFiRoam(&esp32)) {
+        Debug_Printf("🔀 ESP32 switching networks\r\n");
+    }
+    // The next voter's first request finds the backend connection open
+    ESP32_HTTP_Warm(&esp32, BACKEND_HOST, BACKEND_PORT);
+
+#if LOG_NETWORK_STATS
+    Log_NetworkStats();
+#endif
     Debug_Printf("\r\n🔄 Session Reset\r\n\r\n");
 }
 
+/**
+  * @brief  Print the ESP32's per-endpoint latency figures
+  * request is time to the status line (backend), dns/connect the WiFi and
+  * TLS side of it.
+  */
+void Log_NetworkStats(void)
+{
+    ESP32_EndpointStats st;
+    for (uint8_t i = 0; ESP32_GetStats(&esp32, i, &st); i++) {
+        Debug_Printf("📊 %s: %u req (%u err, %u kept open), p50/p95/p99 %u/%u/%u ms, "
+                     "request p95 %u ms, avg dns %u connect %u body %u ms\r\n",
+                     st.name, st.samples, st.errors, st.reused, st.total_p50, st.total_p95,
+                     st.total_p99, st.request_p95, st.dns_avg, st.connect_avg, st.body_avg);
+    }
+}
+
+/**
+  * @brief  Sleep until the next interrupt: the 1 ms SysTick at the latest,
+  *         sooner when the ESP32 UART or its DMA has data
+  */
+static void Idle_Pace(void)
+{
+    __WFI();
+}
+
+/**
+  * @brief  Keypad wait step, keeps a background backend request moving
+  *         and hands the idle link to the prefetch
+  */
+void Input_Idle(uint32_t ms)
+{
+    uint32_t start = HAL_GetTick();
+    do {
+        ESP32_HTTP_Poll(&esp32);
+        Prefetch_Tick();
+        Idle_Pace();
+    } while ((HAL_GetTick() - start) < ms);
+}
+
 /**
   * @brief  Get number input from keypad
+  * @retval false on a bad entry, or when a background request failed
   */
 bool Get_Number_Input(char *buffer, uint8_t max_len, const char *prompt)
 {
@@ -289,6 +434,11 @@ bool Get_Number_Input(char *buffer, uint8_t max_len, const char *prompt)
     char display[17] = {0};
 
     while (1) {
+        if (input_abort) {
+            input_abort = false;
+            return false;
+        }
+
         char key = Keypad_GetKey();
         if (key != '\0') {
             Debug_Printf("Key: %c\r\n", key);
@@ -322,7 +472,7 @@ bool Get_Number_Input(char *buffer, uint8_t max_len, const char *prompt)
                 }
             }
         }
-        HAL_Delay(100);
+        Input_Idle(100);
     }
 }
 
@@ -362,7 +512,7 @@ bool Get_String_Input(char *buffer, uint8_t max_len, const char *prompt)
                 LCD_Print(buffer);
             }
         }
-        HAL_Delay(100);
+        Input_Idle(100);
     }
 }
 
@@ -389,7 +539,7 @@ uint8_t Show_Scrolling_List(const char items[][64], uint8_t count, const char *t
         char key = '\0';
         while (key == '\0') {
             key = Keypad_GetKey();
-            HAL_Delay(50);
+            Input_Idle(50);
         }
 
         Debug_Printf("Key: %c\r\n", key);
@@ -411,10 +561,11 @@ uint8_t Show_Scrolling_List(const char items[][64], uint8_t count, const char *t
 }
 
 /**
- * @brief HAL UART RX Complete Callback - Routes ESP32 data
+ * @brief HAL UART RX Complete Callback - Routes ESP32 data (per-byte RX mode)
  */
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
     if (huart->Instance == USART2) {
+#if !ESP32_RX_USE_DMA
         // ✅ Pass received byte to ESP32 handler
         extern uint8_t uart_rx_byte;
         extern ESP32_Handle esp32;
@@ -423,12 +574,40 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
 
         // ✅ Restart reception for next byte
         HAL_UART_Receive_IT(&huart2, &uart_rx_byte, 1);
+#endif
     }
     else if (huart->Instance == USART1) {
         // R307 handling (if you have any)
     }
 }
 
+/**
+ * @brief HAL UART RX Event Callback - DMA half/full transfer or idle line
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size) {
+    if (huart->Instance == USART2) {
+        ESP32_UART_RxEventCallback(&esp32, Size);
+    }
+}
+
+/**
+ * @brief HAL UART Error Callback - re-arm ESP32 reception after line errors
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance == USART2) {
+        ESP32_UART_ErrorCallback(&esp32);
+    }
+}
+
+/**
+ * @brief HAL UART TX Complete Callback - next half of the ESP32 TX queue
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance == USART2) {
+        ESP32_UART_TxCpltCallback(&esp32);
+    }
+}
+
 /**
   * @brief  Show loading screen
   */
@@ -440,6 +619,35 @@ void Show_Loading(const char *message)
     LCD_SetCursor(1, 0);
     LCD_Print(message);
     Debug_Printf("⏳ %s\r\n", message);
+    loading_active = true;
+}
+
+/**
+  * @brief  Spin the loading indicator (ESP32 wait hook, runs during HTTP calls)
+  * @note   Talks to the bridge directly: the LCD_* pacing delays would stall
+  *         RX draining while the response is streaming in.
+  */
+void Loading_Tick(void)
+{
+    static const char spinner[] = "|/-\\";
+    static uint32_t last_tick = 0;
+    static uint8_t frame = 0;
+    char glyph[2];
+
+    // Queued from a body callback, which runs on the bridge's RX path
+    if (loading_line_due) {
+        loading_line_due = false;
+        ESP32_LCD_SetCursor(&esp32, 1, 0);
+        ESP32_LCD_Print(&esp32, loading_line);
+    }
+
+    if (!loading_active || (HAL_GetTick() - last_tick) < 250) return;
+    last_tick = HAL_GetTick();
+
+    glyph[0] = spinner[frame++ & 3];
+    glyph[1] = '\0';
+    ESP32_LCD_SetCursor(&esp32, 0, 15);
+    ESP32_LCD_Print(&esp32, glyph);
 }
 
 /**
@@ -484,12 +692,15 @@ void State_SelectElection(void)
     Debug_Printf("       STEP 1: SELECT ELECTION        \r\n");
     Debug_Printf("══════════════════════════════════════\r\n");
 
-    Show_Loading("Fetching...");
+    // Usually refreshed in the background while the previous voter was busy
+    if (!Prefetch_UseElections()) {
+        Show_Loading("Fetching...");
 
-    if (!Backend_GetElections()) {
-        Show_Error("Backend Failed!");
-        HAL_Delay(2000);
-        return;
+        if (!Backend_GetElections()) {
+            Show_Error("Backend Failed!");
+            HAL_Delay(2000);
+            return;
+        }
     }
 
     if (session.election_count == 0) {
@@ -514,6 +725,8 @@ void State_SelectElection(void)
 
     session.selected_election_idx = result;
     Debug_Printf("✅ Selected: %s\r\n", session.elections[result].name);
+    // Identity entry takes a while, keep the connection warm for the lookups after it
+    ESP32_HTTP_Warm(&esp32, BACKEND_HOST, BACKEND_PORT);
     /* Move to next state */
     session.state = STATE_ENTER_AADHAAR;
 }
@@ -526,7 +739,7 @@ void State_EnterAadhaar(void)
 	Debug_Printf("═══════════════════════════\r\n");
 	Debug_Printf("STEP 2: ENTER AADHAAR\r\n");
 	Debug_Printf("═══════════════════════════\r\n");
-    HAL_UART_Transmit(&huart2, (uint8_t*)"💬 [STM32] 🔹 Calling GetNumberInput...\r\n", 50, 100);
+    Debug_Printf("💬 [STM32] 🔹 Calling GetNumberInput...\r\n");
     if (Get_Number_Input(session.aadhaar, 12, "Enter Aadhaar:")) {
         Debug_Printf("✅ Aadhaar: %s\r\n", session.aadhaar);
         session.state = STATE_ENTER_VOTER_ID;
@@ -644,15 +857,16 @@ void State_SendOTP(void)
 
     Show_Loading("Sending OTP...");
 
-    if (Backend_SendOTP()) {
+    // The request completes in the background while the voter types the OTP
+    if (Backend_SendOTP_Start()) {
         LCD_Clear();
         LCD_SetCursor(0, 0);
-        LCD_Print("OTP Sent!");
+        LCD_Print("OTP Sending to");
         LCD_SetCursor(1, 0);
         LCD_Print(session.masked_email);
 
-        Debug_Printf("✅ OTP sent to: %s\r\n", session.masked_email);
-        HAL_Delay(2000);
+        Debug_Printf("📨 OTP requested for: %s\r\n", session.masked_email);
+        Input_Idle(2000);
 
         session.state = STATE_ENTER_OTP;
     } else {
@@ -669,7 +883,15 @@ void State_EnterOTP(void)
     Debug_Printf("       STEP 7: ENTER OTP              \r\n");
     Debug_Printf("══════════════════════════════════════\r\n");
 
-    if (Get_Number_Input(session.otp, 6, "Enter 6-Dig OTP:")) {
+    bool entered = Get_Number_Input(session.otp, 6, "Enter 6-Dig OTP:");
+
+    if (!Backend_SendOTP_Finish()) {
+        Show_Error("OTP Send Failed!");
+        session.state = STATE_SEND_OTP;
+        return;
+    }
+
+    if (entered) {
         Debug_Printf("OTP Entered: %s\r\n", session.otp);
         session.state = STATE_VERIFY_OTP;
     } else {
@@ -694,11 +916,15 @@ void State_VerifyOTP(void)
 
         Show_Success("OTP Correct!");
 
-        // ✅ IMPROVED: Fetch candidates from backend
-        Debug_Printf("📋 Fetching candidates...\r\n");
-        Show_Loading("Loading...");
+        // Prefetched while the voter was typing, else fetched now
+        bool have_candidates = Prefetch_UseCandidates();
+        if (!have_candidates) {
+            Debug_Printf("📋 Fetching candidates...\r\n");
+            Show_Loading("Loading...");
+            have_candidates = Backend_GetCandidates();
+        }
 
-        if (Backend_GetCandidates()) {
+        if (have_candidates) {
             Debug_Printf("✅ Got %d candidates:\r\n", session.candidate_count);
 
             // ✅ NEW: Display parsed candidates for verification
@@ -765,54 +991,80 @@ void State_SelectCandidate(void)
     session.state = STATE_CONFIRM_VOTE;
 }
 
+/* Template upload state handed to the chunk builder */
+typedef struct {
+    char chunk_id[64];
+    int chunk;
+} TemplateChunk;
+
 /**
- * @brief Upload scanned fingerprint template to backend for matching (CHUNKED)
- * @retval true if match found
+ * @brief Request body: {aadhaar, voterId, chunkId, chunkNum, chunkData}
  */
-bool Backend_VerifyIdentity(void)
+static void Build_TemplateChunk(JSON_Writer *w, void *ctx)
 {
-    static HTTP_Response response;
+    const TemplateChunk *tc = (const TemplateChunk *)ctx;
+
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "aadhaar", session.aadhaar);
+    JSON_AddString(w, "voterId", session.voter_id);
+    JSON_AddString(w, "chunkId", tc->chunk_id);
+    JSON_AddInt(w, "chunkNum", tc->chunk);
+    JSON_AddHex(w, "chunkData", &session.fingerprint_template[tc->chunk * 128], 128);
+    JSON_EndObject(w);
+}
 
-    Debug_Printf("\r\n══════════════════════════════════════\r\n");
-    Debug_Printf("  BACKEND TEMPLATE MATCHING  \r\n");
-    Debug_Printf("══════════════════════════════════════\r\n");
+/**
+ * @brief Request body: {aadhaar, voterId, chunkId}
+ */
+static void Build_MatchRequest(JSON_Writer *w, void *ctx)
+{
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "aadhaar", session.aadhaar);
+    JSON_AddString(w, "voterId", session.voter_id);
+    JSON_AddString(w, "chunkId", (const char *)ctx);
+    JSON_EndObject(w);
+}
 
-    // Convert scanned template to hex string
-    char template_hex[1025];
-    for (int i = 0; i < 512; i++) {
-        sprintf(&template_hex[i * 2], "%02X", session.fingerprint_template[i]);
-    }
-    template_hex[1024] = '\0';
+/**
+ * @brief Request body: {aadhaar, voterId, template (base64)}
+ */
+static void Build_MatchTemplate(JSON_Writer *w, void *ctx)
+{
+    (void)ctx;
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "aadhaar", session.aadhaar);
+    JSON_AddString(w, "voterId", session.voter_id);
+    JSON_AddBase64(w, "template", session.fingerprint_template, sizeof(session.fingerprint_template));
+    JSON_EndObject(w);
+}
 
-    Debug_Printf("✅ Template converted to hex\r\n");
+/**
+ * @brief Legacy upload: 4 hex chunks + a match request (backends without match-template)
+ * @retval true if the match request got an answer, result in *response
+ */
+static bool Backend_MatchTemplateChunked(HTTP_Response *response)
+{
+    HTTP_Response chunk_response;
 
     // Generate unique chunk ID
-    char chunk_id[64];
-    sprintf(chunk_id, "%s_%s_%lu", session.aadhaar, session.voter_id, HAL_GetTick());
+    TemplateChunk tc;
+    sprintf(tc.chunk_id, "%s_%s_%lu", session.aadhaar, session.voter_id, HAL_GetTick());
 
-    // Upload in 4 chunks (256 chars each = 128 bytes)
+    // Upload in 4 chunks (128 bytes each, hex-encoded on the way out)
     Debug_Printf("📤 Uploading template in 4 chunks...\r\n");
 
-    for (int chunk = 0; chunk < 4; chunk++) {
-        // Build JSON for this chunk
-        snprintf(json_buffer, sizeof(json_buffer),
-                 "{\"aadhaar\":\"%s\",\"voterId\":\"%s\",\"chunkId\":\"%s\",\"chunkNum\":%d,\"chunkData\":\"%.256s\"}",
-                 session.aadhaar,
-                 session.voter_id,
-                 chunk_id,
-                 chunk,
-                 &template_hex[chunk * 256]);
-
-        Debug_Printf("  Chunk %d/4... (%d bytes)\r\n", chunk + 1, strlen(json_buffer));
-
-        if (!ESP32_HTTP_POST(&esp32, BACKEND_HOST, BACKEND_PORT,
-                             "/api/v1/terminal/upload-template-chunk",
-                             json_buffer, &response)) {
+    for (tc.chunk = 0; tc.chunk < 4; tc.chunk++) {
+        int chunk = tc.chunk;
+        Debug_Printf("  Chunk %d/4...\r\n", chunk + 1);
+
+        if (!ESP32_HTTP_POST_JSON(&esp32, BACKEND_HOST, BACKEND_PORT,
+                                  "/api/v1/terminal/upload-template-chunk",
+                                  Build_TemplateChunk, &tc, &chunk_response)) {
             Debug_Printf("❌ Chunk %d upload failed!\r\n", chunk + 1);
             return false;
         }
 
-        if (!response.success) {
+        if (!chunk_response.success) {
             Debug_Printf("❌ Chunk %d rejected!\r\n", chunk + 1);
             return false;
         }
@@ -823,15 +1075,106 @@ bool Backend_VerifyIdentity(void)
     Debug_Printf("✅ All chunks uploaded!\r\n");
 
     // Request backend to match
-    snprintf(json_buffer, sizeof(json_buffer),
-             "{\"aadhaar\":\"%s\",\"voterId\":\"%s\",\"chunkId\":\"%s\"}",
-             session.aadhaar, session.voter_id, chunk_id);
-
     Debug_Printf("🔍 Requesting backend matching...\r\n");
 
-    if (!ESP32_HTTP_POST(&esp32, BACKEND_HOST, BACKEND_PORT,
-                         "/api/v1/terminal/match-fingerprint",
-                         json_buffer, &response)) {
+    return ESP32_HTTP_POST_JSON(&esp32, BACKEND_HOST, BACKEND_PORT,
+                                "/api/v1/terminal/match-fingerprint",
+                                Build_MatchRequest, tc.chunk_id, response);
+}
+
+/* Match result, straight into the session; field numbers follow the table */
+enum { MATCH_MATCHED = 0, MATCH_SCORE, MATCH_NAME };
+static const JSON_FieldDesc MATCH_FIELDS[] = {
+    JSON_FIELD("..matched", JSON_BIND_BOOL,   VotingSession, fingerprint_matched),
+    JSON_FIELD("..score",   JSON_BIND_UINT16, VotingSession, match_score),
+    JSON_FIELD("..name",    JSON_BIND_STRING, VotingSession, voter_name),
+};
+static const JSON_Binding MATCH_BINDING = { MATCH_FIELDS, 3, sizeof(VotingSession), 1 };
+
+/* {"matchTemplate": true, "publicCandidates": true} from the capabilities route */
+typedef struct {
+    bool match_template;               // takes the whole template in one request
+    bool public_candidates;            // get-candidates answers without the voter's token
+} BackendCaps;
+static const JSON_FieldDesc CAPS_FIELDS[] = {
+    JSON_FIELD("..matchTemplate",    JSON_BIND_BOOL, BackendCaps, match_template),
+    JSON_FIELD("..publicCandidates", JSON_BIND_BOOL, BackendCaps, public_candidates),
+};
+static const JSON_Binding CAPS_BINDING = { CAPS_FIELDS, 2, sizeof(BackendCaps), 1 };
+
+static BackendCaps backend_caps;
+static bool backend_caps_known;          // false = not asked yet, or to be asked again
+
+/**
+ * @brief Ask the backend once what it supports
+ * Only an explicit true turns a capability on. A backend without the
+ * capabilities route, or one that leaves a flag out, predates it: chunked
+ * template upload, and candidates only fetched with the voter's token.
+ * @retval false if the backend could not be reached (nothing is cached)
+ */
+static bool Backend_CheckCapabilities(void)
+{
+    HTTP_Response response;
+    BackendCaps caps = { false, false };
+
+    if (backend_caps_known) {
+        return true;
+    }
+
+    JSON_BindTarget target = { &CAPS_BINDING, &caps, 0, 0 };
+    if (!ESP32_HTTP_GET_Bind(&esp32, BACKEND_HOST, BACKEND_PORT, API_CAPABILITIES,
+                             &target, &response)) {
+        Debug_Printf("❌ Capabilities request failed!\r\n");
+        return false;
+    }
+
+    if (!response.success) {
+        memset(&caps, 0, sizeof(caps));
+    }
+    backend_caps = caps;
+    backend_caps_known = true;
+    Debug_Printf("🧩 Template upload: %s, candidate prefetch: %s\r\n",
+                 caps.match_template ? "match-template" : "chunked",
+                 caps.public_candidates ? "on" : "off");
+    return true;
+}
+
+/**
+ * @brief Upload scanned fingerprint template to backend for matching
+ * One match-template request carries the whole template when the backend
+ * says it supports it; otherwise the old chunked upload. A 404 from
+ * match-template is reported like any other error and the capability is
+ * asked again for the next voter.
+ * @retval true if match found
+ */
+bool Backend_VerifyIdentity(void)
+{
+    HTTP_Response response;
+
+    Debug_Printf("\r\n══════════════════════════════════════\r\n");
+    Debug_Printf("  BACKEND TEMPLATE MATCHING  \r\n");
+    Debug_Printf("══════════════════════════════════════\r\n");
+
+    if (!Backend_CheckCapabilities()) {
+        return false;
+    }
+
+    uint32_t start = HAL_GetTick();
+    bool ok;
+    if (backend_caps.match_template) {
+        Debug_Printf("📤 POST %s (%u byte template)\r\n", API_MATCH_TEMPLATE,
+                     (unsigned)sizeof(session.fingerprint_template));
+        ok = ESP32_HTTP_POST_JSON(&esp32, BACKEND_HOST, BACKEND_PORT, API_MATCH_TEMPLATE,
+                                  Build_MatchTemplate, NULL, &response);
+        if (ok && response.status_code == 404) {
+            backend_caps_known = false;
+        }
+    } else {
+        ok = Backend_MatchTemplateChunked(&response);
+    }
+    Debug_Printf("⏱️ Upload + match: %lu ms\r\n", HAL_GetTick() - start);
+
+    if (!ok) {
         Debug_Printf("❌ Match request failed!\r\n");
         return false;
     }
@@ -842,184 +1185,147 @@ bool Backend_VerifyIdentity(void)
     }
 
     // Parse match result
-    char *matched_marker = strstr(response.body, "\"matched\":");
-    if (!matched_marker) {
+    JSON_BindTarget target = { &MATCH_BINDING, &session, 0, 0 };
+    JSON_Bind(response.body, response.body_length, &target);
+    if (!(target.found & (1UL << MATCH_MATCHED))) {
         Debug_Printf("❌ Invalid response\r\n");
         return false;
     }
 
-    bool matched = (strstr(matched_marker, "true") != NULL);
-
-    if (!matched) {
+    if (!session.fingerprint_matched) {
         Debug_Printf("❌ No match found\r\n");
         return false;
     }
 
-    // Extract match score
-    char *score_marker = strstr(response.body, "\"score\":");
-    if (score_marker) {
-        score_marker += 8;
-        session.match_score = (uint16_t)atoi(score_marker);
+    if (target.found & (1UL << MATCH_SCORE)) {
         Debug_Printf("📊 Match Score: %d%%\r\n", session.match_score);
     }
 
-    // Extract voter info
-    char *name_marker = strstr(response.body, "\"name\":\"");
-    if (name_marker) {
-        name_marker += 8;
-        char *name_end = strchr(name_marker, '\"');
-        if (name_end) {
-            size_t name_len = name_end - name_marker;
-            if (name_len < sizeof(session.voter_name)) {
-                strncpy(session.voter_name, name_marker, name_len);
-                session.voter_name[name_len] = '\0';
-            }
-        }
-    }
-
     Debug_Printf("✅ MATCH FOUND!\r\n");
     Debug_Printf("   Name: %s\r\n", session.voter_name);
-
-    session.fingerprint_matched = true;
     return true;
 }
 
 /**
- * @brief Fetch candidates for selected election
- * Handles BOTH string arrays and object arrays
+ * @brief Request body: {electionId, authToken}
+ * ctx is the election id, NULL for the selected election. The token is
+ * empty before OTP (prefetch).
  */
-bool Backend_GetCandidates(void)
+static void Build_CandidatesRequest(JSON_Writer *w, void *ctx)
 {
-    static HTTP_Response response;
+    const char *election = ctx ? (const char *)ctx : session.elections[session.selected_election_idx].id;
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "electionId", election);
+    JSON_AddString(w, "authToken", session.auth_token);
+    JSON_EndObject(w);
+}
 
-    snprintf(json_buffer, sizeof(json_buffer),
-             "{\"electionId\":\"%s\",\"authToken\":\"%s\"}",
-             session.elections[session.selected_election_idx].id,
-             session.auth_token);
+/* data[].id/name/party -> session.candidates[]; values that do not fit are
+ * dropped and the entry is then skipped */
+static const JSON_FieldDesc CANDIDATE_FIELDS[] = {
+    JSON_FIELD("data[:5].id",    JSON_BIND_STRING, Candidate, id),
+    JSON_FIELD("data[:5].name",  JSON_BIND_STRING, Candidate, name),
+    JSON_FIELD("data[:5].party", JSON_BIND_STRING, Candidate, party),
+};
+static const JSON_Binding CANDIDATE_BINDING = { CANDIDATE_FIELDS, 3, sizeof(Candidate), 5 };
 
-    Debug_Printf("📡 POST /api/v1/terminal/get-candidates\r\n");
+/* Candidate list parsed chunk by chunk as it streams in */
+typedef struct {
+    JSON_Projector parser;
+    JSON_BindTarget target;
+    bool first_shown;
+} CandidateStream;
 
-    if (!ESP32_HTTP_POST(&esp32, BACKEND_HOST, BACKEND_PORT,
-                         "/api/v1/terminal/get-candidates",
-                         json_buffer, &response)) {
-        Debug_Printf("❌ HTTP POST failed!\r\n");
-        return false;
+static CandidateStream candidate_stream;   // the parser state is too big for the stack
+
+/**
+ * @brief Next slice of the candidate list (runs from the bridge's RX path)
+ * The first candidate is queued for the LCD as soon as it is complete, and
+ * Loading_Tick shows it while the rest of the list is still on its way.
+ */
+static bool On_CandidatesBody(void *ctx, const char *data, uint16_t len)
+{
+    CandidateStream *cs = (CandidateStream *)ctx;
+
+    JSON_ProjectFeed(&cs->parser, data, len);
+
+    // Record 0 is complete once the parser has moved on to record 1
+    if (!cs->first_shown && cs->target.items > 1) {
+        cs->first_shown = true;
+        if (session.candidates[0].name[0] != '\0') {
+            snprintf(loading_line, sizeof(loading_line), "1.%-14.14s", session.candidates[0].name);
+            loading_line_due = true;
+        }
     }
+    return true;
+}
 
-    if (!response.success) {
-        Debug_Printf("❌ HTTP %d\r\n", response.status_code);
-        return false;
+/**
+ * @brief Move the usable candidates (id and name set) to the front
+ * @retval how many there are
+ */
+static uint8_t Compact_Candidates(Candidate *list, uint8_t max)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < max; i++) {
+        Candidate *c = &list[i];
+        if (c->id[0] == '\0' || c->name[0] == '\0') continue;
+        if (c->party[0] == '\0') strcpy(c->party, "Independent");
+        if (i != count) list[count] = *c;
+        count++;
     }
+    return count;
+}
 
-    Debug_Printf("📥 Response (%d bytes): %s\r\n", strlen(response.body), response.body);
+/**
+ * @brief Fetch candidates for selected election
+ * The body is parsed as it streams in, it never has to fit in rx_buffer.
+ * Unlike the bound requests the whole body crosses the UART (manifestos
+ * included): the ESP32 does not project chunked transfers.
+ */
+bool Backend_GetCandidates(void)
+{
+    HTTP_Response response;
+    CandidateStream *cs = &candidate_stream;
+
+    Debug_Printf("📡 POST %s\r\n", API_GET_CANDIDATES);
 
     // ✅ RESET: Clear candidate array first
     memset(session.candidates, 0, sizeof(session.candidates));
     session.candidate_count = 0;
 
-    // Find the "data" array
-    char *data_array = strstr(response.body, "\"data\":[");
-    if (!data_array) {
-        Debug_Printf("❌ No 'data' array found\r\n");
+    cs->target.binding = &CANDIDATE_BINDING;
+    cs->target.base = session.candidates;
+    cs->first_shown = false;
+    JSON_ProjectBind(&cs->parser, &cs->target);
+    bool ok = ESP32_HTTP_POST_JSON_Stream(&esp32, BACKEND_HOST, BACKEND_PORT,
+                                          API_GET_CANDIDATES,
+                                          Build_CandidatesRequest, NULL,
+                                          On_CandidatesBody, cs, &response);
+    loading_line_due = false;   // the whole list is in (or not coming), no preview
+    if (!ok) {
+        Debug_Printf("❌ HTTP POST failed!\r\n");
         return false;
     }
 
-    char *search_pos = data_array + 8; // Skip past '"data":['
-    Debug_Printf("🔍 Starting parse...\r\n");
-
-    // Parse each candidate object (max 10)
-    while (session.candidate_count < 10 && *search_pos != '\0') {
-
-        // Look for opening brace of next object
-        char *obj_start = strchr(search_pos, '{');
-        if (!obj_start || (obj_start - search_pos) > 50) {
-            Debug_Printf("⏹ No more candidates (count: %d)\r\n", session.candidate_count);
-            break;
-        }
-
-        search_pos = obj_start + 1; // Move past '{'
-
-        // ✅ NEW: Look for "id" field (REQUIRED)
-        char *id_marker = strstr(search_pos, "\"id\":\"");
-        if (!id_marker || (id_marker - search_pos) > 200) {
-            // Skip this object if no id found
-            char *closing = strchr(search_pos, '}');
-            if (closing) {
-                search_pos = closing + 1;
-            }
-            continue;
-        }
-
-        // Extract ID
-        char *id_start = id_marker + 6;
-        char *id_end = strchr(id_start, '\"');
-        if (id_end && (id_end - id_start) > 0 && (id_end - id_start) < 32) {
-            strncpy(session.candidates[session.candidate_count].id, id_start, id_end - id_start);
-            session.candidates[session.candidate_count].id[id_end - id_start] = '\0';
-        } else {
-            // Skip if ID extraction failed
-            search_pos = id_end ? id_end : search_pos + 50;
-            continue;
-        }
-
-        // ✅ NEW: Look for "name" field (REQUIRED)
-        char *name_marker = strstr(id_end, "\"name\":\"");
-        if (!name_marker || (name_marker - id_end) > 100) {
-            Debug_Printf("⚠️ No 'name' in object, skipping\r\n");
-            search_pos = strchr(id_end, '}');
-            if (search_pos) search_pos++;
-            continue;
-        }
-
-        // Extract Name
-        char *name_start = name_marker + 8;
-        char *name_end = strchr(name_start, '\"');
-        if (name_end && (name_end - name_start) > 0 && (name_end - name_start) < 64) {
-            strncpy(session.candidates[session.candidate_count].name, name_start, name_end - name_start);
-            session.candidates[session.candidate_count].name[name_end - name_start] = '\0';
-        } else {
-            strcpy(session.candidates[session.candidate_count].name, "Unknown");
-        }
-
-        // Extract Party (OPTIONAL)
-        char *party_marker = strstr(name_end, "\"party\":\"");
-        if (party_marker && (party_marker - name_end) < 100) {
-            char *party_start = party_marker + 9;
-            char *party_end = strchr(party_start, '\"');
-            if (party_end && (party_end - party_start) < 64) {
-                strncpy(session.candidates[session.candidate_count].party, party_start, party_end - party_start);
-                session.candidates[session.candidate_count].party[party_end - party_start] = '\0';
-                search_pos = party_end;
-            } else {
-                strcpy(session.candidates[session.candidate_count].party, "Independent");
-                search_pos = name_end;
-            }
-        } else {
-            strcpy(session.candidates[session.candidate_count].party, "Independent");
-            search_pos = name_end;
-        }
-
-        Debug_Printf("  ✅ [%d] ID: %s | Name: %s | Party: %s\r\n",
-                     session.candidate_count + 1,
-                     session.candidates[session.candidate_count].id,
-                     session.candidates[session.candidate_count].name,
-                     session.candidates[session.candidate_count].party);
-
-        session.candidate_count++;
+    if (!response.success) {
+        Debug_Printf("❌ HTTP %d\r\n", response.status_code);
+        return false;
+    }
 
-        // Move to next object
-        char *closing_brace = strchr(search_pos, '}');
-        if (closing_brace) {
-            search_pos = closing_brace + 1;
-        } else {
-            break;
-        }
+    // Keep the entries that have an id and a name, in order
+    session.candidate_count = Compact_Candidates(session.candidates, 5);
+    for (uint8_t i = 0; i < session.candidate_count; i++) {
+        const Candidate *c = &session.candidates[i];
+        Debug_Printf("  ✅ [%d] ID: %s | Name: %s | Party: %s\r\n", i + 1, c->id, c->name, c->party);
     }
 
     if (session.candidate_count == 0) {
         Debug_Printf("❌ No candidates parsed\r\n");
         return false;
     }
+    Prefetch_PutCandidates(session.elections[session.selected_election_idx].id,
+                           session.candidates, session.candidate_count);
 
     Debug_Printf("✅ Parsed %d candidates successfully\r\n", session.candidate_count);
     return true;
@@ -1159,6 +1465,28 @@ void State_ShowReceipt(void)
 /* BACKEND API FUNCTIONS                                                       */
 /* ========================================================================== */
 
+/* data[].id/title -> session.elections[] */
+static const JSON_FieldDesc ELECTION_FIELDS[] = {
+    JSON_FIELD("data[:10].id",    JSON_BIND_STRING, Election, id),
+    JSON_FIELD("data[:10].title", JSON_BIND_STRING, Election, name),
+};
+static const JSON_Binding ELECTION_BINDING = { ELECTION_FIELDS, 2, sizeof(Election), 10 };
+
+/**
+ * @brief Move the usable elections (id and title set) to the front
+ * @retval how many there are
+ */
+static uint8_t Compact_Elections(Election *list, uint8_t max)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < max; i++) {
+        if (list[i].id[0] == '\0' || list[i].name[0] == '\0') continue;
+        if (i != count) list[count] = list[i];
+        count++;
+    }
+    return count;
+}
+
 /**
   * @brief  Fetch active elections from backend
   */
@@ -1170,10 +1498,16 @@ void State_ShowReceipt(void)
  */
 bool Backend_GetElections(void)
 {
-    static HTTP_Response response;
+    HTTP_Response response;
     Debug_Printf("📡 GET %s\r\n", API_ELECTIONS);
 
-    if (!ESP32_HTTP_GET(&esp32, BACKEND_HOST, BACKEND_PORT, API_ELECTIONS, &response)) {
+    // Format: {"success":true,"data":[{...},{...}]}, only id/title come over
+    memset(session.elections, 0, sizeof(session.elections));
+    session.election_count = 0;
+
+    JSON_BindTarget target = { &ELECTION_BINDING, session.elections, 0, 0 };
+    if (!ESP32_HTTP_GET_Bind(&esp32, BACKEND_HOST, BACKEND_PORT, API_ELECTIONS,
+                             &target, &response)) {
         Debug_Printf("❌ HTTP GET Failed!\r\n");
         return false;
     }
@@ -1182,67 +1516,23 @@ bool Backend_GetElections(void)
         Debug_Printf("❌ HTTP %d\r\n", response.status_code);
         return false;
     }
+    if (response.timing.cached) {
+        Debug_Printf("🗄️ Election list from the ESP32 cache\r\n");
+    }
 
-    Debug_Printf("📥 Response: %s\r\n", response.body);
-
-    // ✅ SIMPLE PARSER: Just extract election objects one by one
-    // Format: {"success":true,"data":[{...},{...}]}
-
-    session.election_count = 0;
-    char *search_pos = response.body;
-
-    // Find each election object in the data array
-    while (session.election_count < 10) {
-        // Look for "id":" pattern (start of each election)
-        char *id_marker = strstr(search_pos, "\"id\":\"");
-        if (!id_marker) break; // No more elections
-
-        // Make sure this "id" is inside the data array (not success field)
-        char *data_array = strstr(response.body, "\"data\":[");
-        if (!data_array || id_marker < data_array) break;
-
-        // Extract ID
-        char *id_start = id_marker + 6; // Skip past "id":"
-        char *id_end = strchr(id_start, '"');
-        if (id_end) {
-            size_t id_len = id_end - id_start;
-            if (id_len < sizeof(session.elections[0].id)) {
-                strncpy(session.elections[session.election_count].id, id_start, id_len);
-                session.elections[session.election_count].id[id_len] = '\0';
-            }
-        }
-
-        // Extract Title (look for "title":" after current position)
-        char *title_marker = strstr(id_end, "\"title\":\"");
-        if (title_marker && (title_marker - id_end) < 50) { // Make sure it's in same object
-            char *title_start = title_marker + 9; // Skip past "title":"
-            char *title_end = strchr(title_start, '"');
-            if (title_end) {
-                size_t title_len = title_end - title_start;
-                if (title_len < sizeof(session.elections[0].name)) {
-                    strncpy(session.elections[session.election_count].name, title_start, title_len);
-                    session.elections[session.election_count].name[title_len] = '\0';
-                }
-            }
-
-            Debug_Printf("  ✅ Election %d:\r\n", session.election_count + 1);
-            Debug_Printf("     ID: %s\r\n", session.elections[session.election_count].id);
-            Debug_Printf("     Name: %s\r\n", session.elections[session.election_count].name);
-
-            session.election_count++;
-
-            // Move search position past this election
-            search_pos = title_end;
-        } else {
-            // No title found for this ID, skip it
-            search_pos = id_end;
-        }
+    // Elections without an id or a title are skipped
+    session.election_count = Compact_Elections(session.elections, 10);
+    for (uint8_t i = 0; i < session.election_count; i++) {
+        Debug_Printf("  ✅ Election %d:\r\n", i + 1);
+        Debug_Printf("     ID: %s\r\n", session.elections[i].id);
+        Debug_Printf("     Name: %s\r\n", session.elections[i].name);
     }
 
     if (session.election_count == 0) {
         Debug_Printf("❌ No elections parsed\r\n");
         return false;
     }
+    Prefetch_PutElections(session.elections, session.election_count);
 
     Debug_Printf("✅ Total elections parsed: %d\r\n", session.election_count);
     return true;
@@ -1295,25 +1585,80 @@ uint8_t Compare_Fingerprint_Templates(uint8_t *template1, uint8_t *template2) {
 }
 
 /**
-  * @brief  Send OTP to voter's email
+  * @brief  Send-OTP completion (runs from ESP32_HTTP_Poll)
   */
-bool Backend_SendOTP(void)
+static void Backend_SendOTP_Done(void *ctx, ESP32_AsyncState state, const HTTP_Response *response)
 {
-    HTTP_Response response;
+    (void)ctx;
+    session.otp_sent = (state == ESP32_ASYNC_DONE && response->success);
+    if (!session.otp_sent) {
+        Debug_Printf("❌ OTP send failed (HTTP %d)\r\n", response->status_code);
+        input_abort = true;   // no point typing an OTP that never comes
+    }
+}
 
-    snprintf(json_buffer, sizeof(json_buffer),
-             "{\"aadhaar\":\"%s\",\"voterId\":\"%s\"}",
-             session.aadhaar, session.voter_id);
+/**
+  * @brief  Request body: {aadhaar, voterId}
+  */
+static void Build_VoterRequest(JSON_Writer *w, void *ctx)
+{
+    (void)ctx;
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "aadhaar", session.aadhaar);
+    JSON_AddString(w, "voterId", session.voter_id);
+    JSON_EndObject(w);
+}
 
-    Debug_Printf("📡 POST %s\r\n", API_SEND_OTP);
+/**
+  * @brief  Start sending the OTP to the voter's email (non-blocking)
+  */
+bool Backend_SendOTP_Start(void)
+{
+    Debug_Printf("📡 POST %s (background)\r\n", API_SEND_OTP);
 
-    if (!ESP32_HTTP_POST(&esp32, BACKEND_HOST, BACKEND_PORT, API_SEND_OTP, json_buffer, &response)) {
-        return false;
+    Prefetch_Wait();
+    session.otp_sent = false;
+    return ESP32_HTTP_POST_JSON_Start(&esp32, BACKEND_HOST, BACKEND_PORT, API_SEND_OTP,
+                                      Build_VoterRequest, NULL,
+                                      &async_response, Backend_SendOTP_Done, NULL);
+}
+
+/**
+  * @brief  Wait for the background send-OTP request if it is still running
+  * @retval true if the OTP went out
+  */
+bool Backend_SendOTP_Finish(void)
+{
+    // A pending prefetch only started once the send-OTP request was done
+    if (prefetch.job == PREFETCH_NONE && ESP32_HTTP_Poll(&esp32) == ESP32_ASYNC_PENDING) {
+        Show_Loading("Sending OTP...");
+        while (ESP32_HTTP_Poll(&esp32) == ESP32_ASYNC_PENDING) {
+            Loading_Tick();
+            Idle_Pace();
+        }
     }
+    input_abort = false;
+    return session.otp_sent;
+}
 
-    return response.success;
+/**
+  * @brief  Request body: {aadhaar, voterId, otp}
+  */
+static void Build_VerifyOTPRequest(JSON_Writer *w, void *ctx)
+{
+    (void)ctx;
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "aadhaar", session.aadhaar);
+    JSON_AddString(w, "voterId", session.voter_id);
+    JSON_AddString(w, "otp", session.otp);
+    JSON_EndObject(w);
 }
 
+static const JSON_FieldDesc AUTH_FIELDS[] = {
+    JSON_FIELD("..authToken", JSON_BIND_STRING, VotingSession, auth_token),
+};
+static const JSON_Binding AUTH_BINDING = { AUTH_FIELDS, 1, sizeof(VotingSession), 1 };
+
 /**
   * @brief  Verify OTP and get auth token
   */
@@ -1321,13 +1666,10 @@ bool Backend_VerifyOTP(void)
 {
     HTTP_Response response;
 
-    snprintf(json_buffer, sizeof(json_buffer),
-             "{\"aadhaar\":\"%s\",\"voterId\":\"%s\",\"otp\":\"%s\"}",
-             session.aadhaar, session.voter_id, session.otp);
-
     Debug_Printf("📡 POST %s\r\n", API_VERIFY_OTP);
 
-    if (!ESP32_HTTP_POST(&esp32, BACKEND_HOST, BACKEND_PORT, API_VERIFY_OTP, json_buffer, &response)) {
+    if (!ESP32_HTTP_POST_JSON(&esp32, BACKEND_HOST, BACKEND_PORT, API_VERIFY_OTP,
+                              Build_VerifyOTPRequest, NULL, &response)) {
         return false;
     }
 
@@ -1335,11 +1677,24 @@ bool Backend_VerifyOTP(void)
         return false;
     }
 
-    // Extract auth token and stored template
-    if (JSON_GetString(response.body, "authToken", session.auth_token, sizeof(session.auth_token))) {
-        return true;
-    }
-    return false;
+    // Extract auth token (a token that does not fit is no token)
+    JSON_BindTarget target = { &AUTH_BINDING, &session, 0, 0 };
+    JSON_Bind(response.body, response.body_length, &target);
+    return target.found != 0;
+}
+
+/**
+  * @brief  Request body: {authToken, electionId, candidateId, fingerprintMatchHash}
+  */
+static void Build_CastVoteRequest(JSON_Writer *w, void *ctx)
+{
+    (void)ctx;
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "authToken", session.auth_token);
+    JSON_AddString(w, "electionId", session.elections[session.selected_election_idx].id);
+    JSON_AddString(w, "candidateId", session.candidates[session.selected_candidate_idx].id);
+    JSON_AddString(w, "fingerprintMatchHash", session.aadhaar_hash);
+    JSON_EndObject(w);
 }
 
 /**
@@ -1357,28 +1712,38 @@ bool Backend_CastVote(void)
 
     // Create fingerprint match hash
     SHA256_Hash_Hex(temp_fp_hex, session.aadhaar_hash);
-    snprintf(json_buffer, sizeof(json_buffer),
-             "{\"authToken\":\"%s\",\"electionId\":\"%s\",\"candidateId\":\"%s\",\"fingerprintMatchHash\":\"%s\"}",
-             session.auth_token,
-             session.elections[session.selected_election_idx].id,
-             session.candidates[session.selected_candidate_idx].id,
-             session.aadhaar_hash);
 
     Debug_Printf("📡 POST %s\r\n", API_CAST_VOTE);
 
-    if (!ESP32_HTTP_POST(&esp32, BACKEND_HOST, BACKEND_PORT, API_CAST_VOTE, json_buffer, &response)) {
+    if (!ESP32_HTTP_POST_JSON(&esp32, BACKEND_HOST, BACKEND_PORT, API_CAST_VOTE,
+                              Build_CastVoteRequest, NULL, &response)) {
         return false;
     }
 
     return response.success;
 }
 
+/* Receipt status, nesting of the two fields is up to the backend */
+typedef struct {
+    bool processing;
+    char tx_id[sizeof(session.transaction_id)];
+} ReceiptStatus;
+
+enum { RECEIPT_PROCESSING = 0, RECEIPT_TX_ID };
+static const JSON_FieldDesc RECEIPT_FIELDS[] = {
+    JSON_FIELD("..processing", JSON_BIND_BOOL,   ReceiptStatus, processing),
+    JSON_FIELD("..txId",       JSON_BIND_STRING, ReceiptStatus, tx_id),
+};
+static const JSON_Binding RECEIPT_BINDING = { RECEIPT_FIELDS, 2, sizeof(ReceiptStatus), 1 };
+
 /**
  * @brief Get receipt (poll endpoint)
  */
 bool Backend_GetReceipt(void)
 {
-    static HTTP_Response response;
+    HTTP_Response response;
+    ReceiptStatus rs;
+    JSON_BindTarget target = { &RECEIPT_BINDING, &rs, 0, 0 };
 
     char path[256];
     snprintf(path, sizeof(path), "%s/%s/%s",
@@ -1388,7 +1753,7 @@ bool Backend_GetReceipt(void)
 
     Debug_Printf("📡 GET %s\r\n", path);
 
-    if (!ESP32_HTTP_GET(&esp32, BACKEND_HOST, BACKEND_PORT, path, &response)) {
+    if (!ESP32_HTTP_GET_Bind(&esp32, BACKEND_HOST, BACKEND_PORT, path, &target, &response)) {
         return false;
     }
 
@@ -1396,72 +1761,254 @@ bool Backend_GetReceipt(void)
         return false;
     }
 
-    Debug_Printf("📥 Receipt response: %s\r\n", response.body);
+    if (!(target.found & (1UL << RECEIPT_PROCESSING))) {
+        Debug_Printf("⚠️ Could not parse processing status\r\n");
+        return false;
+    }
+
+    if (rs.processing) {
+        Debug_Printf("⏳ Still processing on blockchain...\r\n");
+        return false;
+    }
 
-    // ✅ FIX: Check for "processing":false or "processing":true
-    char *processing_marker = strstr(response.body, "\"processing\":");
-    if (processing_marker) {
-        processing_marker += 13; // Skip past '"processing":'
+    Debug_Printf("✅ Receipt ready!\r\n");
+    if (!(target.found & (1UL << RECEIPT_TX_ID)) || rs.tx_id[0] == '\0') {
+        // Processing is false but no txId (shouldn't happen)
+        Debug_Printf("⚠️ Processing complete but no transaction ID found\r\n");
+        return false;
+    }
 
-        // Skip whitespace
-        while (*processing_marker == ' ') processing_marker++;
+    strcpy(session.transaction_id, rs.tx_id);
 
-        // Check if it's "false" (receipt ready)
-        if (strncmp(processing_marker, "false", 5) == 0) {
-            Debug_Printf("✅ Receipt ready!\r\n");
+    Debug_Printf("📜 TX ID: %s\r\n", session.transaction_id);
+    return true;
+}
 
-            // Extract transaction ID
-            char *txid_marker = strstr(response.body, "\"txId\":\"");
-            if (txid_marker) {
-                txid_marker += 8; // Skip past '"txId":"'
-                char *txid_end = strchr(txid_marker, '\"');
 
-                if (txid_end) {
-                    size_t txid_len = txid_end - txid_marker;
-                    if (txid_len < sizeof(session.transaction_id)) {
-                        strncpy(session.transaction_id, txid_marker, txid_len);
-                        session.transaction_id[txid_len] = '\0';
+/**
+  * @brief  Request body: {aadhaar, voterId, transactionId, electionId}
+  */
+static void Build_ReceiptEmailRequest(JSON_Writer *w, void *ctx)
+{
+    (void)ctx;
+    JSON_BeginObject(w, NULL);
+    JSON_AddString(w, "aadhaar", session.aadhaar);
+    JSON_AddString(w, "voterId", session.voter_id);
+    JSON_AddString(w, "transactionId", session.transaction_id);
+    JSON_AddString(w, "electionId", session.elections[session.selected_election_idx].id);
+    JSON_EndObject(w);
+}
 
-                        Debug_Printf("📜 TX ID: %s\r\n", session.transaction_id);
-                        return true;
-                    }
-                }
-            }
+/**
+  * @brief  Send receipt via email
+  */
+bool Backend_SendReceiptEmail(void)
+{
+    HTTP_Response response;
 
-            // If we got here, processing is false but no txId (shouldn't happen)
-            Debug_Printf("⚠️ Processing complete but no transaction ID found\r\n");
-            return false;
+    Debug_Printf("📡 POST %s\r\n", API_SEND_EMAIL);
 
-        } else if (strncmp(processing_marker, "true", 4) == 0) {
-            Debug_Printf("⏳ Still processing on blockchain...\r\n");
-            return false;
-        }
+    if (!ESP32_HTTP_POST_JSON(&esp32, BACKEND_HOST, BACKEND_PORT, API_SEND_EMAIL,
+                              Build_ReceiptEmailRequest, NULL, &response)) {
+        return false;
     }
 
-    Debug_Printf("⚠️ Could not parse processing status\r\n");
-    return false;
+    return response.success;
 }
 
+/* ========================================================================== */
+/* IDLE PREFETCH                                                               */
+/* ========================================================================== */
 
 /**
-  * @brief  Send receipt via email
+  * @brief  Whether a list of @p version fetched at @p tick is younger than @p max_age ms
   */
-bool Backend_SendReceiptEmail(void)
+static bool Prefetch_Fresh(uint16_t version, uint32_t tick, uint32_t max_age)
 {
-    HTTP_Response response;
+    return version != 0 && (HAL_GetTick() - tick) < max_age;
+}
 
-    snprintf(json_buffer, sizeof(json_buffer),
-             "{\"aadhaar\":\"%s\",\"voterId\":\"%s\",\"transactionId\":\"%s\",\"electionId\":\"%s\"}",
-             session.aadhaar, session.voter_id, session.transaction_id,
-             session.elections[session.selected_election_idx].id);
+/**
+  * @brief  Keep a just fetched election list, under a new version if it changed
+  */
+void Prefetch_PutElections(const Election *list, uint8_t count)
+{
+    if (prefetch.elections_version == 0 || count != prefetch.election_count ||
+        memcmp(list, prefetch.elections, count * sizeof(Election)) != 0) {
+        memset(prefetch.elections, 0, sizeof(prefetch.elections));
+        memcpy(prefetch.elections, list, count * sizeof(Election));
+        prefetch.election_count = count;
+        if (++prefetch.elections_version == 0) prefetch.elections_version = 1;
+        Debug_Printf("🗂️ Elections v%u: %u cached\r\n", prefetch.elections_version, count);
+    }
+    prefetch.elections_tick = HAL_GetTick();
+}
 
-    Debug_Printf("📡 POST %s\r\n", API_SEND_EMAIL);
+/**
+  * @brief  Keep a just fetched candidate list, under a new version if it changed
+  */
+void Prefetch_PutCandidates(const char *election_id, const Candidate *list, uint8_t count)
+{
+    if (prefetch.candidates_version == 0 || strcmp(election_id, prefetch.candidates_for) != 0 ||
+        count != prefetch.candidate_count ||
+        memcmp(list, prefetch.candidates, count * sizeof(Candidate)) != 0) {
+        strncpy(prefetch.candidates_for, election_id, sizeof(prefetch.candidates_for) - 1);
+        memset(prefetch.candidates, 0, sizeof(prefetch.candidates));
+        memcpy(prefetch.candidates, list, count * sizeof(Candidate));
+        prefetch.candidate_count = count;
+        if (++prefetch.candidates_version == 0) prefetch.candidates_version = 1;
+        Debug_Printf("🗂️ Candidates v%u for %s: %u cached\r\n",
+                     prefetch.candidates_version, election_id, count);
+    }
+    prefetch.candidates_elections = prefetch.elections_version;
+    prefetch.candidates_tick = HAL_GetTick();
+}
+
+/**
+  * @brief  Copy the cached election list into the session
+  * @retval false if there is none recent enough, fetch it then
+  */
+bool Prefetch_UseElections(void)
+{
+    if (!Prefetch_Fresh(prefetch.elections_version, prefetch.elections_tick, PREFETCH_MAX_AGE_MS)) {
+        return false;
+    }
+    memcpy(session.elections, prefetch.elections, sizeof(session.elections));
+    session.election_count = prefetch.election_count;
+    Debug_Printf("🗂️ Elections v%u from the prefetch cache (%lu s old)\r\n", prefetch.elections_version,
+                 (unsigned long)((HAL_GetTick() - prefetch.elections_tick) / 1000));
+    return true;
+}
 
-    if (!ESP32_HTTP_POST(&esp32, BACKEND_HOST, BACKEND_PORT, API_SEND_EMAIL, json_buffer, &response)) {
+/**
+  * @brief  Copy the cached candidates of the selected election into the session
+  * @retval false if there are none recent enough, or the election list changed since
+  */
+bool Prefetch_UseCandidates(void)
+{
+    if (!Prefetch_Fresh(prefetch.candidates_version, prefetch.candidates_tick, PREFETCH_MAX_AGE_MS) ||
+        prefetch.candidates_elections != prefetch.elections_version ||
+        strcmp(prefetch.candidates_for, session.elections[session.selected_election_idx].id) != 0) {
         return false;
     }
+    memcpy(session.candidates, prefetch.candidates, sizeof(session.candidates));
+    session.candidate_count = prefetch.candidate_count;
+    Debug_Printf("🗂️ Candidates v%u from the prefetch cache (%lu s old)\r\n", prefetch.candidates_version,
+                 (unsigned long)((HAL_GetTick() - prefetch.candidates_tick) / 1000));
+    return true;
+}
 
-    return response.success;
+/**
+  * @brief  Prefetch completion (runs from ESP32_HTTP_Poll)
+  */
+static void Prefetch_Done(void *ctx, ESP32_AsyncState state, const HTTP_Response *response)
+{
+    (void)ctx;
+    PrefetchJob job = prefetch.job;
+    prefetch.job = PREFETCH_NONE;
+
+    if (state != ESP32_ASYNC_DONE || !response->success) {
+        prefetch.backoff = true;
+        prefetch.backoff_tick = HAL_GetTick();
+        if (job == PREFETCH_CANDIDATES && response->status_code >= 400 && response->status_code < 500) {
+            // The backend said publicCandidates but refused without the voter's
+            // token (401/403, or a 400/422 on the empty one): believe the refusal
+            backend_caps.public_candidates = false;
+            Debug_Printf("⚠️ Candidates refused without the voter's token (HTTP %d), no prefetch\r\n",
+                         response->status_code);
+        } else {
+            Debug_Printf("⚠️ Prefetch failed (HTTP %d %s)\r\n", response->status_code, response->error);
+        }
+        return;
+    }
+    prefetch.backoff = false;
+
+    if (job == PREFETCH_ELECTIONS) {
+        uint8_t count = Compact_Elections(prefetch.staging.elections, 10);
+        if (count > 0) Prefetch_PutElections(prefetch.staging.elections, count);
+    } else if (job == PREFETCH_CANDIDATES) {
+        uint8_t count = Compact_Candidates(prefetch.staging.candidates, 5);
+        if (count > 0) Prefetch_PutCandidates(prefetch.job_election, prefetch.staging.candidates, count);
+    }
+}
+
+/**
+  * @brief  Election whose candidates are due for a prefetch, NULL if none
+  * The one being voted in once chosen, before that the one last voted in.
+  */
+static const char *Prefetch_CandidatesDue(void)
+{
+    const char *id = prefetch.candidates_for;
+    if (session.state >= STATE_ENTER_AADHAAR && session.state < STATE_VERIFY_OTP) {
+        id = session.elections[session.selected_election_idx].id;
+    } else if (session.state != STATE_SELECT_ELECTION) {
+        return NULL;   // past OTP the list is fetched with the voter's token
+    }
+    // Before OTP there is no token: only where the backend says it needs none
+    if (!backend_caps_known || !backend_caps.public_candidates) return NULL;
+    if (id[0] == '\0') return NULL;
+
+    if (strcmp(id, prefetch.candidates_for) == 0 &&
+        prefetch.candidates_elections == prefetch.elections_version &&
+        Prefetch_Fresh(prefetch.candidates_version, prefetch.candidates_tick, PREFETCH_REFRESH_MS)) {
+        return NULL;
+    }
+    return id;
+}
+
+/**
+  * @brief  Start the next due prefetch if the link is idle (called from Input_Idle)
+  * Binary link only: the text link completes a request inside the start
+  * call and would freeze the keypad meanwhile.
+  */
+void Prefetch_Tick(void)
+{
+    if (prefetch.job != PREFETCH_NONE) return;
+    if (esp32.link_mode != ESP32_LINK_BINARY || esp32.wifi_state != WIFI_CONNECTED) return;
+    if (ESP32_HTTP_Poll(&esp32) == ESP32_ASYNC_PENDING) return;   // the voter's request
+    if (esp32.link_resync) return;   // the resync blocks, left to the voter's next request
+    if (prefetch.backoff && (HAL_GetTick() - prefetch.backoff_tick) < PREFETCH_RETRY_MS) return;
+
+    const char *election = NULL;
+    bool started;
+    memset(&prefetch.staging, 0, sizeof(prefetch.staging));
+
+    if (!Prefetch_Fresh(prefetch.elections_version, prefetch.elections_tick, PREFETCH_REFRESH_MS)) {
+        Debug_Printf("🗂️ Prefetching elections\r\n");
+        prefetch.target.binding = &ELECTION_BINDING;
+        prefetch.target.base = prefetch.staging.elections;
+        prefetch.job = PREFETCH_ELECTIONS;
+        started = ESP32_HTTP_GET_Bind_Start(&esp32, BACKEND_HOST, BACKEND_PORT, API_ELECTIONS,
+                                            &prefetch.target, &async_response, Prefetch_Done, NULL);
+    } else if ((election = Prefetch_CandidatesDue()) != NULL) {
+        Debug_Printf("🗂️ Prefetching candidates for %s\r\n", election);
+        strncpy(prefetch.job_election, election, sizeof(prefetch.job_election) - 1);
+        prefetch.target.binding = &CANDIDATE_BINDING;
+        prefetch.target.base = prefetch.staging.candidates;
+        prefetch.job = PREFETCH_CANDIDATES;
+        started = ESP32_HTTP_POST_Bind_Start(&esp32, BACKEND_HOST, BACKEND_PORT, API_GET_CANDIDATES,
+                                             Build_CandidatesRequest, prefetch.job_election,
+                                             &prefetch.target, &async_response, Prefetch_Done, NULL);
+    } else {
+        return;
+    }
+
+    if (!started) {
+        prefetch.job = PREFETCH_NONE;
+        prefetch.backoff = true;
+        prefetch.backoff_tick = HAL_GetTick();
+    }
+}
+
+/**
+  * @brief  Let a prefetch in flight finish (one background request at a time)
+  */
+void Prefetch_Wait(void)
+{
+    while (prefetch.job != PREFETCH_NONE && ESP32_HTTP_Poll(&esp32) == ESP32_ASYNC_PENDING) {
+        Loading_Tick();
+        Idle_Pace();
+    }
 }
 /* USER CODE END 0 */
 
@@ -1506,8 +2053,8 @@ int main(void)
     Debug_Printf("\r\n=== MEMORY DEBUG ===\r\n");
     Debug_Printf("Stack Pointer: 0x%08X\r\n", stack_ptr);
     Debug_Printf("session addr:  0x%08X (size: %d)\r\n", (uint32_t)&session, sizeof(session));
-    Debug_Printf("json_buffer:   0x%08X\r\n", (uint32_t)&json_buffer);
-    Debug_Printf("Free RAM estimate: %d bytes\r\n\r\n", stack_ptr - (uint32_t)&json_buffer);
+    Debug_Printf("esp32 addr:    0x%08X (size: %d)\r\n", (uint32_t)&esp32, sizeof(esp32));
+    Debug_Printf("Free RAM estimate: %d bytes\r\n\r\n", stack_ptr - (uint32_t)&response_buffer);
 
     Debug_Printf("\r\n\r\n");
     Debug_Printf("╔══════════════════════════════════════════════════════╗\r\n");
@@ -1522,10 +2069,11 @@ int main(void)
         while(1) HAL_Delay(1000);
     }
     Debug_Printf("✅ ESP32 OK!\r\n\r\n");
+    ESP32_SetWaitHook(&esp32, Loading_Tick);
 
     // Initialize LCD
     Debug_Printf("🖥️ Initializing LCD...\r\n");
-    HAL_UART_Transmit(&huart2, (uint8_t*)"LCD_INIT\n", 9, 100);
+    ESP32_LCD_Init(&esp32);
     HAL_Delay(500);
     Debug_Printf("✅ LCD Ready!\r\n\r\n");
 
@@ -1536,6 +2084,7 @@ int main(void)
 
     // Initialize R307
     Debug_Printf("🔍 Initializing R307 Fingerprint...\r\n");
+    R307_SetLogger(&fingerprint, R307_Log);
     if (!R307_Init(&fingerprint, &huart1)) {
         Debug_Printf("⚠️ R307 not detected\r\n\r\n");
     } else {
@@ -1548,18 +2097,37 @@ int main(void)
     LCD_SetCursor(0, 0);
     LCD_Print("Connecting WiFi");
 
+    // Sent every boot so that clearing WIFI_STATIC_IP goes back to DHCP
+    ESP32_SetStaticIP(&esp32, WIFI_STATIC_IP, WIFI_GATEWAY, WIFI_SUBNET, WIFI_DNS);
+    ESP32_WiFiAddNetwork(&esp32, 1, WIFI_SSID_2, WIFI_PASSWORD_2);
+    ESP32_WiFiAddNetwork(&esp32, 2, WIFI_SSID_3, WIFI_PASSWORD_3);
+
     if (!ESP32_ConnectWiFi(&esp32, WIFI_SSID, WIFI_PASSWORD)) {
-        Debug_Printf("❌ WiFi connection failed!\r\n");
+        Debug_Printf("❌ WiFi connection failed, the ESP32 keeps trying\r\n");
         Show_Error("WiFi Failed!");
-        while(1) HAL_Delay(1000);
+        LCD_Clear();
+        LCD_SetCursor(0, 0);
+        LCD_Print("WiFi retrying...");
+        while (!ESP32_CheckConnection(&esp32)) {
+            HAL_Delay(1000);
+        }
     }
 
     Debug_Printf("✅ WiFi connected!\r\n");
+    // The prefetch caches the election list; drop an ESP32 rule kept in its flash
+    ESP32_HTTP_Cache(&esp32, API_ELECTIONS, 0);
+    // Requests keep naming BACKEND_HOST, the ESP32 routes them over the list
+    ESP32_HTTP_Backend(&esp32, 0, BACKEND_HOST, BACKEND_PORT);
+    ESP32_HTTP_Backend(&esp32, 1, BACKEND_HOST_2, BACKEND_PORT_2);
+    ESP32_HTTP_Backend(&esp32, 2, BACKEND_HOST_3, BACKEND_PORT_3);
     char ip[16];
     if (ESP32_GetIP(&esp32, ip)) {
         Debug_Printf("🌐 IP Address: %s\r\n\r\n", ip);
     }
 
+    // What the backend supports decides the template upload and the candidate prefetch
+    Backend_CheckCapabilities();
+
     Show_Success("System Ready!");
 
     // Initialize voting session
@@ -1807,6 +2375,9 @@ static void MX_DMA_Init(void)
   /* DMA1_Channel6_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 0, 0);
   HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+  /* DMA1_Channel7_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
 
 }
 
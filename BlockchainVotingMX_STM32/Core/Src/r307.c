@@ -4,6 +4,7 @@
   ******************************************************************************/
 
 #include "r307.h"
+#include <stdio.h>
 #include <string.h>
 
 /* Private Variables */
@@ -15,6 +16,8 @@ static bool R307_SendPacket(R307_Handle *dev, uint8_t type, uint8_t *data, uint1
 static bool R307_ReceivePacket(R307_Handle *dev, uint8_t *data, uint16_t *len);
 static uint16_t R307_CalculateChecksum(uint8_t *data, uint16_t len);
 static bool R307_VerifyChecksum(uint8_t *packet, uint16_t len);
+static void R307_Debug(R307_Handle *dev, const char *msg);
+
 /* At the top with other externs */
 extern DMA_HandleTypeDef hdma_usart1_rx;
 extern DMA_HandleTypeDef hdma_usart1_tx;
@@ -41,6 +44,27 @@ void R307_FlushUART(R307_Handle *dev)
     HAL_Delay(10);
 }
 
+/*******************************************************************************
+  * @brief  Set where the driver sends its debug text
+  * @param  dev: Pointer to R307 handle
+  * @param  log: Called with each message, NULL to stay silent
+  * @note   Keeps the driver free of any link to the ESP32 bridge
+  ******************************************************************************/
+void R307_SetLogger(R307_Handle *dev, void (*log)(const char *msg))
+{
+    dev->log = log;
+}
+
+/*******************************************************************************
+  * @brief  Pass a debug message to the handle's logger, if any
+  ******************************************************************************/
+static void R307_Debug(R307_Handle *dev, const char *msg)
+{
+    if (dev->log) {
+        dev->log(msg);
+    }
+}
+
 /*******************************************************************************
   * @brief  Initialize R307 sensor
   * @param  dev: Pointer to R307 handle
@@ -441,6 +465,7 @@ bool R307_EnrollFingerprint(R307_Handle *dev, uint16_t location)
   ******************************************************************************/
 uint8_t R307_GetLastError(R307_Handle *dev)
 {
+    (void)dev;
     return last_error;
 }
 
@@ -630,8 +655,6 @@ bool R307_UploadTemplate(R307_Handle *dev, uint8_t buffer_id, uint8_t *template_
  */
 bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *template_data)
 {
-    extern UART_HandleTypeDef huart2; // For debug
-
     /* 🔧 AGGRESSIVE FLUSH - Clear everything */
     HAL_UART_AbortReceive(handle->huart);  // Stop any ongoing reception
     R307_FlushUART(handle);
@@ -667,7 +690,7 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
 
     // Send command via DMA
     if (HAL_UART_Transmit_DMA(handle->huart, packet, idx) != HAL_OK) {
-        HAL_UART_Transmit(&huart2, (uint8_t*)"[R307] TX DMA fail\r\n", 20, 100);
+        R307_Debug(handle, "[R307] TX DMA fail\r\n");
         return false;
     }
 
@@ -675,7 +698,7 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
     uint32_t start_tick = HAL_GetTick();
     while (handle->huart->gState != HAL_UART_STATE_READY) {
         if ((HAL_GetTick() - start_tick) > 1000) {
-            HAL_UART_Transmit(&huart2, (uint8_t*)"[R307] TX timeout\r\n", 19, 100);
+            R307_Debug(handle, "[R307] TX timeout\r\n");
             return false;
         }
         HAL_Delay(5);
@@ -697,7 +720,7 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
 
     // Start DMA reception of exactly 12 bytes
     if (HAL_UART_Receive_DMA(handle->huart, ack, 12) != HAL_OK) {
-        HAL_UART_Transmit(&huart2, (uint8_t*)"[R307] DMA start fail\r\n", 23, 100);
+        R307_Debug(handle, "[R307] DMA start fail\r\n");
         return false;
     }
 
@@ -716,19 +739,19 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
         if (bytes_received != last_count) {
             char progress[64];
             sprintf(progress, "[R307] RX: %lu/12 bytes\r\n", bytes_received);
-            HAL_UART_Transmit(&huart2, (uint8_t*)progress, strlen(progress), 100);
+            R307_Debug(handle, progress);
             last_count = bytes_received;
         }
 
         if (elapsed > 3000) {  // 3 second timeout
             char debug[80];
             sprintf(debug, "[R307] Timeout! Got %lu/12 bytes\r\n", bytes_received);
-            HAL_UART_Transmit(&huart2, (uint8_t*)debug, strlen(debug), 100);
+            R307_Debug(handle, debug);
 
             // Print what we received
             sprintf(debug, "[R307] Buffer: %02X %02X %02X %02X %02X %02X...\r\n",
                     ack[0], ack[1], ack[2], ack[3], ack[4], ack[5]);
-            HAL_UART_Transmit(&huart2, (uint8_t*)debug, strlen(debug), 100);
+            R307_Debug(handle, debug);
 
             HAL_UART_AbortReceive(handle->huart);
             R307_FlushUART(handle);
@@ -747,12 +770,12 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
     sprintf(ack_debug, "[R307] ACK: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X\r\n",
             ack[0], ack[1], ack[2], ack[3], ack[4], ack[5],
             ack[6], ack[7], ack[8], ack[9], ack[10], ack[11]);
-    HAL_UART_Transmit(&huart2, (uint8_t*)ack_debug, strlen(ack_debug), 100);
+    R307_Debug(handle, ack_debug);
 
     // Check for start code
     if (ack[0] != 0xEF || ack[1] != 0x01) {
         sprintf(ack_debug, "[R307] Bad header: %02X %02X (expected EF 01)\r\n", ack[0], ack[1]);
-        HAL_UART_Transmit(&huart2, (uint8_t*)ack_debug, strlen(ack_debug), 100);
+        R307_Debug(handle, ack_debug);
         R307_FlushUART(handle);
         return false;
     }
@@ -761,7 +784,7 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
     if (ack[6] != R307_ACK_PACKET) {
         sprintf(ack_debug, "[R307] Wrong type: 0x%02X (expected 0x%02X)\r\n",
                 ack[6], R307_ACK_PACKET);
-        HAL_UART_Transmit(&huart2, (uint8_t*)ack_debug, strlen(ack_debug), 100);
+        R307_Debug(handle, ack_debug);
         R307_FlushUART(handle);
         return false;
     }
@@ -769,13 +792,13 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
     // Check confirmation code
     if (ack[9] != R307_OK) {
         sprintf(ack_debug, "[R307] Sensor error: 0x%02X\r\n", ack[9]);
-        HAL_UART_Transmit(&huart2, (uint8_t*)ack_debug, strlen(ack_debug), 100);
+        R307_Debug(handle, ack_debug);
 
         // Decode error
         switch (ack[9]) {
-            case 0x01: HAL_UART_Transmit(&huart2, (uint8_t*)"  -> Packet receive error\r\n", 28, 100); break;
-            case 0x06: HAL_UART_Transmit(&huart2, (uint8_t*)"  -> Failed to generate char file\r\n", 36, 100); break;
-            case 0x0D: HAL_UART_Transmit(&huart2, (uint8_t*)"  -> Failed to transfer/download\r\n", 35, 100); break;
+            case 0x01: R307_Debug(handle, "  -> Packet receive error\r\n"); break;
+            case 0x06: R307_Debug(handle, "  -> Failed to generate char file\r\n"); break;
+            case 0x0D: R307_Debug(handle, "  -> Failed to transfer/download\r\n"); break;
             default: break;
         }
 
@@ -784,7 +807,7 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
         return false;
     }
 
-    HAL_UART_Transmit(&huart2, (uint8_t*)"[R307] ✅ ACK verified!\r\n", 27, 100);
+    R307_Debug(handle, "[R307] ✅ ACK verified!\r\n");
 
     // ═══════════════════════════════════════════════════════
     // STEP 4: Send template data in packets via DMA
@@ -829,10 +852,10 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
         // Send via DMA
         char pkt_debug[64];
         sprintf(pkt_debug, "[R307] Sending pkt %d (%d bytes)...\r\n", packet_num, chunk_len);
-        HAL_UART_Transmit(&huart2, (uint8_t*)pkt_debug, strlen(pkt_debug), 100);
+        R307_Debug(handle, pkt_debug);
 
         if (HAL_UART_Transmit_DMA(handle->huart, packet, idx) != HAL_OK) {
-            HAL_UART_Transmit(&huart2, (uint8_t*)"[R307] Data TX fail\r\n", 21, 100);
+            R307_Debug(handle, "[R307] Data TX fail\r\n");
             R307_FlushUART(handle);
             return false;
         }
@@ -855,7 +878,7 @@ bool R307_DownloadTemplate(R307_Handle *handle, uint8_t buffer_id, uint8_t *temp
     HAL_Delay(250);
     R307_FlushUART(handle);
 
-    HAL_UART_Transmit(&huart2, (uint8_t*)"[R307] ✅ Download complete!\r\n", 33, 100);
+    R307_Debug(handle, "[R307] ✅ Download complete!\r\n");
 
     return true;
 }
@@ -4,7 +4,22 @@
 * ✅ API key and terminal ID header injection
 * ✅ Robust error handling and buffer management
 * ✅ Proper debugging output
-* Firmware Version: 3.0.1
+* ✅ Optional binary framed link (COBS + CRC16 + seq), negotiated at PING
+* ✅ HTTP runs in worker tasks, replies routed by seq
+* ✅ Chunked body delivery paced by STM32 credits (no 4 KB response cap)
+* ✅ LINK_SPEED: UART rate raised after PING, echo-verified, auto fallback
+* ✅ HTTP errors reported at once with status + error body (HTTP_ERROR)
+* ✅ JSON field projection: only the values the STM32 asks for cross the UART
+* ✅ Chunked POST with a streamed JSON body (POST_JSON_CHUNKED)
+* ✅ Response bodies piped from the socket to the UART as they arrive
+* ✅ Kept-alive backend connections: DNS cache, pre-warm (HTTP_WARM), per-request timing
+* ✅ Dual-core tasks: link and LCD/LED on core 1, HTTP workers on core 0
+* ✅ Per-request timing in every response, per-endpoint latency histograms (STATS)
+* ✅ GET response cache in flash: TTL + ETag revalidation behind a stale answer (HTTP_CACHE)
+* ✅ WiFi: stored BSSID/channel fast join, optional static IP (WIFI_STATIC), background rejoin
+* ✅ Roaming between configured networks (WIFI_ADD) by RSSI and backend round trip, between voters (WIFI_ROAM)
+* ✅ Backend list (HTTP_BACKEND): fastest healthy endpoint per request, failover, recovery probes
+* Firmware Version: 4.2.0
 *******************************************************************************/
 
 #include <WiFi.h>
@@ -12,9 +27,13 @@
 #include <WiFiClientSecure.h>
 #include <Wire.h>
 #include <LiquidCrystal_I2C.h>
+#include <LittleFS.h>
+#include <Preferences.h>
 
 #define STM32_RX_PIN 16
 #define STM32_TX_PIN 17
+#define STM32_CTS_PIN 18   // only used when the STM32 asks for RTS/CTS
+#define STM32_RTS_PIN 19
 #define LED_PIN 2
 
 // LCD Setup
@@ -26,18 +45,1022 @@ HardwareSerial STM32Serial(2);
 // HTTP timeout (increased for HTTPS)
 const int HTTP_TIMEOUT = 30000; // 30 seconds for GitHub Codespaces
 
-// Command list
-const char* commands[] = {
-  "PING", "RESET", "LED_ON", "LED_OFF", "LED_BLINK",
-  "WIFI_CONNECT", "WIFI_DISCONNECT", "WIFI_STATUS", "WIFI_IP",
-  "HTTP_GET", "HTTP_POST",
-  "LCD_INIT", "LCD_CLEAR", "LCD_PRINT", "LCD_CURSOR", "LCD_BACKLIGHT"
+// ========== BINARY LINK ==========
+// Frame: 0x00 | COBS( type | seq | fields... | crc16_lo | crc16_hi ) | 0x00
+// CRC-16/CCITT-FALSE over type..fields, strings are u16 LE length + bytes.
+// Enabled when the STM32 sends "PING,BIN1" (answered with "PONG,BIN1"),
+// dropped again as soon as a plain text PING line shows up.
+#define FRAME_PING            0x01
+#define FRAME_RESET           0x02
+#define FRAME_LED_ON          0x03
+#define FRAME_LED_OFF         0x04
+#define FRAME_LED_BLINK       0x05
+#define FRAME_WIFI_CONNECT    0x06
+#define FRAME_WIFI_DISCONNECT 0x07
+#define FRAME_WIFI_STATUS     0x08
+#define FRAME_WIFI_IP         0x09
+#define FRAME_HTTP_GET        0x0A
+#define FRAME_HTTP_POST       0x0B
+#define FRAME_LCD_INIT        0x0C
+#define FRAME_LCD_CLEAR       0x0D
+#define FRAME_LCD_PRINT       0x0E
+#define FRAME_LCD_CURSOR      0x0F
+#define FRAME_LCD_BACKLIGHT   0x10
+#define FRAME_LOG             0x11
+#define FRAME_HTTP_GET_CHUNKED  0x12
+#define FRAME_HTTP_POST_CHUNKED 0x13
+#define FRAME_CREDIT          0x14
+#define FRAME_LINK_SPEED      0x15
+#define FRAME_LINK_TEST       0x16
+#define FRAME_HTTP_POST_JSON  0x17   // as GET, then JSON as the rest of the frame
+#define JSON_BLOB             0x01   // in POST_JSON: u16 len + bytes, sent on as base64
+#define FRAME_HTTP_GET_FIELDS  0x18  // as GET, then str projection
+#define FRAME_HTTP_POST_FIELDS 0x19  // as GET, then str projection, then JSON as the rest
+#define FRAME_HTTP_POST_JSON_CHUNKED 0x1A  // as GET, u16 chunk size, u8 credits, JSON as the rest
+#define FRAME_HTTP_WARM       0x1B   // str host, u16 port; opens a connection ahead, no reply
+#define FRAME_STATS           0x1C   // u8 endpoint index; answered with STATS_REPLY
+#define FRAME_HTTP_CACHE      0x1D   // str path prefix, u32 TTL s (0 = stop); no reply
+#define FRAME_WIFI_STATIC     0x1E   // str ip, str gateway, str subnet, str dns (ip "" = DHCP)
+#define FRAME_WIFI_ADD        0x1F   // u8 slot 1..3, str ssid ("" = remove), str password
+#define FRAME_WIFI_ROAM       0x20   // between sessions: switch networks now if one is better
+#define FRAME_HTTP_BACKEND    0x21   // u8 slot 0..3, str host ("" = remove), u16 port
+#define FRAME_REPLY           0x80
+#define FRAME_HTTP_RESPONSE   0x81
+#define FRAME_HTTP_HEAD       0x82
+#define FRAME_HTTP_DATA       0x83
+#define FRAME_HTTP_END        0x84
+#define FRAME_LINK_ECHO       0x85
+#define FRAME_HTTP_ERROR      0x86   // u16 status (0 = no HTTP exchange), str reason, body
+#define FRAME_HTTP_FIELDS     0x87   // u16 status, records: u8 field, u8 item, u16 len, value
+#define FRAME_STATS_REPLY     0x88   // u8 endpoints, str name, u16 x 12 (see sendStats)
+
+// RESPONSE, FIELDS, ERROR and END frames end in a timing trailer:
+// u16 dns, u16 connect, u16 request, u16 body (ms), u8 TIMING_* flags
+#define TIMING_REUSED  0x01
+#define TIMING_TLS     0x02
+#define TIMING_CACHED  0x04   // answered from the response cache
+
+#define FRAME_BUF_SIZE 4352
+
+bool binaryLink = false;
+uint8_t frameBuf[FRAME_BUF_SIZE + 1];
+size_t frameLen = 0;
+bool frameOverflow = false;
+uint8_t curSeq = 0;       // seq of the frame being served, echoed in replies
+int lastRxSeq = -1;       // for gap detection
+uint8_t txBlock[255];     // COBS block being encoded
+uint8_t txBlockLen = 1;
+uint16_t txCrc = 0xFFFF;
+SemaphoreHandle_t linkTxMutex;   // one frame on the wire at a time (loop + HTTP task)
+
+// ========== LINK SPEED ==========
+// LINK_SPEED is answered with OK at the old rate, then both sides switch and
+// the STM32 echoes a test pattern (LINK_TEST -> LINK_ECHO) at the new one.
+// Until a valid frame arrives at the new rate we are on probation and fall
+// back by ourselves. The boot rate is always safe, so no probation there.
+#define LINK_BAUD_DEFAULT  115200
+#define LINK_BAUD_MAX      5000000
+#define LINK_PROBATION_MS  1000
+#define LINK_RX_BUFFER     4096    // ~20 ms at 2 Mbaud
+
+uint32_t linkBaud = LINK_BAUD_DEFAULT;
+bool linkFlow = false;
+uint32_t linkPrevBaud = LINK_BAUD_DEFAULT;
+bool linkPrevFlow = false;
+bool linkProbation = false;
+unsigned long linkProbationStart = 0;
+
+// ========== TEXT COMMANDS ==========
+// Lines are assembled in frameBuf (text and binary link never run at the
+// same time), split in place at the commas and dispatched through a hash
+// table on the command word; split and lookup do not touch the heap. HTTP
+// commands fill an HttpJob from a fixed pool whose Strings keep their
+// buffers, so once the pool has seen requests of a given size queueing one
+// allocates nothing either (the HTTP workers do allocate, in HTTPClient).
+#define LINK_TX_BUFFER  2048   // replies and streamed bodies leave without blocking the link task
+#define CMD_MAX_ARGS    5      // fields after the command word
+#define CMD_SLOTS       32     // hash slots, power of two, > 2x the command count
+#define CMD_TIMING      0      // 1 = log dispatch cycles and heap change with every command
+
+typedef void (*CmdHandler)(char **argv, int argc);
+
+struct Command {
+  const char *name;
+  uint8_t minArgs;
+  uint8_t maxArgs;             // the last field keeps any further commas
+  CmdHandler handler;
+};
+
+uint8_t cmdSlots[CMD_SLOTS];   // index + 1 into commandTable, 0 = empty
+uint32_t cmdHashes[CMD_SLOTS];
+#if CMD_TIMING
+uint32_t cmdCycles = 0;        // split + lookup of the last command, for the log
+uint32_t cmdHeap = 0;          // free heap before the handler ran
+#endif
+bool lineOverflow = false;
+
+// ========== TASKS ==========
+// loop() is not used: UART ingest/dispatch, LCD/LED and the HTTP workers are
+// FreeRTOS tasks joined by bounded queues, so a 30 s POST, an LED_BLINK or a
+// WiFi join never holds up reading the next command. Core 0 runs the WiFi
+// stack and the HTTP workers, core 1 the link and LCD/LED tasks.
+#define LINK_TASK_CORE   1
+#define LINK_TASK_PRIO   3
+#define LINK_TASK_STACK  8192
+#define LINK_IDLE_WAIT   10       // ms without UART data, paces the LINK_SPEED probation check
+#define IO_TASK_CORE     1
+#define IO_TASK_PRIO     2
+#define IO_TASK_STACK    4096
+#define IO_QUEUE_LEN     16
+#define IO_TEXT_MAX      40       // LCD_PRINT text per job, the LCD shows 16
+#define HTTP_WORKERS     2
+#define HTTP_TASK_CORE   0
+#define HTTP_TASK_PRIO   1
+
+// LCD/LED command as queued for the I/O task (type is the FRAME_* code)
+struct IoJob {
+  uint8_t type;
+  uint8_t seq;
+  int16_t a;
+  int16_t b;
+  uint8_t len;
+  char text[IO_TEXT_MAX];
+};
+
+QueueHandle_t ioQueue;
+TaskHandle_t linkTaskHandle;
+
+// ========== WIFI ==========
+// Joins and rejoins run in their own task, driven by the WiFi events. The
+// credentials and the access point of the last good join (BSSID + channel)
+// are kept in NVS, so a join skips the scan and after a reboot the ESP32 is
+// already joining when the STM32 asks. A dropped network is rejoined in the
+// background with growing pauses; WIFI_STATUS and WIFI_IP answer from the
+// state kept here without touching the radio.
+//
+// Roaming: besides the WIFI_CONNECT network (slot 0) up to three more can be
+// configured with WIFI_ADD. Each is scored by signal (RSSI from scans made
+// while no request runs) minus backend round trip measured while on it. A
+// better network is only switched to on WIFI_ROAM, which the STM32 sends
+// between voters. It is answered with the decision (ROAMING or STAYED) at
+// once; the switch then runs with the HTTP workers held off, so the next
+// voter's first requests wait at the gate and go out on the new network.
+// The gate is closed at most WIFI_ROAM_WAIT + 2 x WIFI_FAST_TIMEOUT (11 s):
+// one fast join there, one fast join back, then the usual rejoin ungated.
+#define WIFI_TASK_CORE     0
+#define WIFI_TASK_PRIO     2
+#define WIFI_TASK_STACK    4096
+#define WIFI_FAST_TIMEOUT  4000     // ms for a join on the stored BSSID/channel, then scan
+#define WIFI_JOIN_TIMEOUT  10000    // ms for a join with a scan
+#define WIFI_RETRY_MIN     500      // ms before the first rejoin after a drop
+#define WIFI_RETRY_MAX     30000
+#define WIFI_TICK          100      // ms, timeout check period of the WiFi task
+#define WIFI_RETRY_NEXT    2000     // ms, from this rejoin delay on the next network is tried
+#define WIFI_NETWORKS      4        // slot 0: WIFI_CONNECT's network, 1..3: WIFI_ADD
+#define WIFI_SCAN_PERIOD   120000   // ms between scans for the roaming scores
+#define WIFI_SCAN_FRESH    300000   // ms a scan result counts for roaming
+#define WIFI_RSSI_PERIOD   10000    // ms between RSSI samples of the current access point
+#define WIFI_RTT_PER_DB    20       // ms of backend round trip that weigh as much as 1 dB
+#define WIFI_ROAM_MARGIN   6        // dB a network must score above the current one
+#define WIFI_ROAM_WAIT     3000     // ms a switch waits for running requests, then stays
+
+// WiFi task notification bits
+#define NET_EVT_JOIN       0x01     // (re)join with net.ssid/password
+#define NET_EVT_LEAVE      0x02
+#define NET_EVT_GOT_IP     0x04
+#define NET_EVT_LOST       0x08
+#define NET_EVT_ROAM       0x10     // WIFI_ROAM
+
+enum { NET_OFF, NET_JOINING, NET_UP, NET_RETRY };
+
+struct WiFiNetwork {
+  String ssid;               // empty = unused slot
+  String password;
+  uint8_t bssid[6];          // strongest access point in the last scan
+  int32_t channel;
+  int16_t rssi;              // of that access point, dBm
+  uint16_t rttMs;            // backend round trip while on this network, smoothed; 0 = unknown
+  uint32_t seenAt;           // 0 = not in the last scan
+};
+
+struct NetState {
+  volatile uint8_t state;
+  String ssid;
+  String password;
+  uint8_t bssid[6];          // access point of the last good join
+  int32_t channel;           // 0 = none stored, scan
+  bool fast;                 // this join skips the scan
+  IPAddress ip;              // static address, 0 = DHCP
+  IPAddress gateway;
+  IPAddress subnet;
+  IPAddress dns;
+  IPAddress localIP;         // while NET_UP
+  uint32_t joinStart;
+  uint32_t retryAt;
+  uint32_t retryDelay;
+  int replySeq;              // WIFI_CONNECT waiting for the outcome, -1 = none
+  uint32_t drops;
+  int8_t slot;               // network in use, -1 = not a configured one
+  int16_t rssi;              // of the access point in use, smoothed
+  uint32_t rssiAt;
+  uint32_t scanAt;
+  bool scanning;
+  int roamSeq;               // WIFI_ROAM waiting for the decision, -1 = none
+  volatile bool roaming;     // switching networks, the HTTP workers hold off
+  int8_t roamFrom;           // slot to go back to if the switch fails, -1 = on the way back
+  uint8_t roamBssid[6];
+  int32_t roamChannel;
+};
+
+NetState net;
+WiFiNetwork nets[WIFI_NETWORKS];
+volatile uint8_t httpBusy = 0;   // jobs past the roaming gate, a switch waits for 0
+SemaphoreHandle_t netMutex;  // ssid/password/address, written by the link task
+TaskHandle_t wifiTaskHandle;
+// NVS namespace "wifi". The passwords sit there in plaintext: anyone who
+// can read the flash (serial download mode, desoldered chip) gets them.
+// Build with flash + NVS encryption (nvs_keys partition) for terminals
+// that leave a supervised site.
+Preferences netPrefs;
+
+// ========== HTTP WORKER ==========
+// HTTP requests run in the worker tasks, the response carries the request
+// seq.
+#define HTTP_QUEUE_LEN   4
+#define HTTP_TASK_STACK  12288
+
+// Chunked delivery: HTTP_HEAD, then one HTTP_DATA per credit, then HTTP_END.
+// Credits arrive as CREDIT frames handled by the link task while a worker
+// waits. Each worker has its own credit count, CREDIT goes to the one
+// streaming that seq, so both workers can stream at once.
+#define STREAM_CREDIT_TIMEOUT 10000
+#define STREAM_LEN_UNKNOWN    0xFFFFFFFF   // HTTP_HEAD length of a chunked-encoding body
+#define HTTP_ERROR_BODY_MAX   1024   // error bodies are short, cap what we forward
+
+enum { JOB_GET, JOB_POST, JOB_WARM };
+
+struct HttpJob {
+  uint8_t kind;          // JOB_WARM only opens the connection
+  uint8_t seq;
+  uint16_t chunkSize;    // 0 = whole body in one HTTP_RESPONSE
+  uint8_t credits;
+  String host;
+  int port;
+  String path;
+  String apiKey;
+  String terminalId;
+  String jsonData;
+  String fields;         // projection, empty = whole body
+};
+
+QueueHandle_t httpQueue;
+
+// Jobs come from a fixed pool: one per queue slot and one per worker, so a
+// full queue is the only way to run out. Their Strings keep their buffers
+// from one request to the next. HTTP_JOB_POOL 0 = new/delete per request,
+// for comparing the two with CMD_TIMING.
+#define HTTP_JOB_POOL   1
+#define HTTP_JOBS       (HTTP_QUEUE_LEN + HTTP_WORKERS)
+#if HTTP_JOB_POOL
+HttpJob httpJobs[HTTP_JOBS];
+QueueHandle_t httpJobFree;
+#endif
+
+struct StreamCredit {
+  SemaphoreHandle_t sem;     // one count per chunk the STM32 can take
+  volatile int seq;          // seq of the transfer being streamed, -1 = none
+  volatile bool cancel;
+};
+
+struct FrameReader {
+  const uint8_t *p;
+  size_t left;
+  bool ok;
+
+  uint8_t u8() {
+    if (left < 1) { ok = false; return 0; }
+    left--;
+    return *p++;
+  }
+
+  uint16_t u16() {
+    if (left < 2) { ok = false; return 0; }
+    uint16_t v = p[0] | (p[1] << 8);
+    p += 2;
+    left -= 2;
+    return v;
+  }
+
+  uint32_t u32() {
+    uint32_t lo = u16();
+    uint32_t hi = u16();
+    return lo | (hi << 16);
+  }
+
+  // String field in place in frameBuf, not NUL-terminated
+  const char *view(uint16_t &n) {
+    n = u16();
+    if (!ok || n > left) { ok = false; n = 0; return ""; }
+    const char *s = (const char *)p;
+    p += n;
+    left -= n;
+    return s;
+  }
+
+  String str() {
+    String s;
+    strTo(s);
+    return s;
+  }
+
+  // Into s, reusing its buffer when it is big enough (pooled HttpJobs)
+  void strTo(String &s) {
+    s = "";
+    uint16_t n = u16();
+    if (!ok || n > left) { ok = false; return; }
+    s.reserve(n);
+    for (uint16_t i = 0; i < n; i++) s += (char)p[i];
+    p += n;
+    left -= n;
+  }
+
+  // Everything left as JSON into s, for the body the sender streamed
+  // unprefixed. Binary blobs are expanded to base64 here (3 UART bytes -> 4 chars).
+  void restJsonTo(String &s) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    s = "";
+    s.reserve(left + left / 2);
+    while (left > 0 && ok) {
+      uint8_t c = u8();
+      if (c != JSON_BLOB) {
+        s += (char)c;
+        continue;
+      }
+      uint16_t n = u16();
+      if (!ok || n > left) { ok = false; break; }
+      for (uint16_t i = 0; i < n; i += 3) {
+        uint16_t k = (n - i < 3) ? n - i : 3;
+        uint32_t v = (uint32_t)p[i] << 16;
+        if (k > 1) v |= (uint32_t)p[i + 1] << 8;
+        if (k > 2) v |= p[i + 2];
+        s += b64[(v >> 18) & 0x3F];
+        s += b64[(v >> 12) & 0x3F];
+        s += (k > 1) ? b64[(v >> 6) & 0x3F] : '=';
+        s += (k > 2) ? b64[v & 0x3F] : '=';
+      }
+      p += n;
+      left -= n;
+    }
+  }
+};
+
+// ========== CONNECTION POOL ==========
+// Backend connections stay open between requests (HTTP keep-alive on one
+// TLS session), so a voter flow pays DNS + TCP + TLS once instead of once per
+// call. HTTP_WARM opens one before it is needed, and while a session is
+// active the HTTP task re-opens a connection the server dropped.
+#define CONN_POOL_SIZE      2        // a TLS session holds ~40 KB of heap
+#define CONN_REWARM_WINDOW  30000    // keep a socket open this long after its last use
+#define CONN_IDLE_CLOSE     120000   // then free the slot and its TLS buffers
+#define CONN_RETRY_DELAY    5000     // after a failed background connect
+#define CONN_MAINT_PERIOD   500      // HTTP task housekeeping while no job is queued
+#define DNS_CACHE_TTL       300000
+
+struct Conn {
+  String host;               // empty = free slot
+  uint16_t port;
+  bool tls;
+  WiFiClient *client;        // WiFiClientSecure when tls, lives as long as the slot
+  HTTPClient *http;          // bound to the current socket
+  IPAddress ip;
+  bool resolved;
+  uint32_t resolvedAt;
+  uint32_t lastUsed;         // last request or HTTP_WARM
+  uint32_t failedAt;         // last failed connect, 0 = none
+  uint32_t opened;           // handshakes done
+  uint32_t reused;           // requests that found the socket open
+  bool busy;                 // claimed by a worker
+  bool warming;              // busy opening the socket ahead of a request
+};
+
+// Where the time of one request went
+struct HttpTiming {
+  uint32_t dnsMs;
+  uint32_t connectMs;        // TCP + TLS handshake, 0 when the socket was open
+  uint32_t responseMs;       // request out to status line in (send + server time)
+  uint32_t bodyMs;           // status line to the last body byte handed on
+  bool reused;
+  bool tls;
+  bool cached;               // body came from flash, not the socket
+  const char *error;         // why no socket could be opened
+};
+
+Conn connPool[CONN_POOL_SIZE];
+SemaphoreHandle_t connMutex;   // guards slot selection, a claimed slot is the worker's alone
+
+// ========== BACKENDS ==========
+// The STM32 may list endpoints that serve the same API (HTTP_BACKEND), in
+// order of preference, slot 0 being the host it addresses its requests to.
+// A request for any of them goes to the fastest one that is up: smoothed
+// request time, plus a small bias for the later slots; one not measured yet
+// counts as fast as slot 0. A request that finds its backend down (no
+// connection, or 502/503/504; not a read timeout) takes it out and moves on
+// to the next one; a POST only if its headers never went out. The idle worker
+// probes a down backend with a bare connect, backing off, and puts it back
+// when that gets through. Until a request has succeeded on it again it is
+// on trial: GETs may use it, POSTs only when nothing else is up.
+#define BACKENDS              4
+#define BACKEND_ORDER_BIAS    50       // ms a later slot must be faster by to be picked
+#define BACKEND_TRIAL_BIAS    60000    // ms added for a POST to a backend on trial
+#define BACKEND_PROBE_MIN     5000     // ms before the first probe of a down backend
+#define BACKEND_PROBE_MAX     120000
+
+struct Backend {
+  String host;               // empty = unused slot
+  uint16_t port;
+  uint32_t latencyMs;        // smoothed request time, 0 = not measured yet
+  bool down;                 // until a probe gets through
+  uint8_t strikes;           // failures since the last good request, > 0 = on trial
+  uint32_t probeAt;
+  uint32_t requests;
+  uint32_t failovers;        // requests that moved on from this one
+};
+
+Backend backends[BACKENDS];
+SemaphoreHandle_t backendMutex;
+Preferences backendPrefs;
+
+// ========== LATENCY STATS ==========
+// Per-endpoint (request path without the query, ID segments as ":id")
+// histograms of the total and of the request phase, so slow backends show
+// apart from WiFi/TLS overhead. STATS reads them out one endpoint at a time.
+#define STATS_ENDPOINTS  12       // the last one also takes every path that no longer fits
+#define STATS_NAME_MAX   20       // tail of the path is kept, it names the call
+#define STATS_BUCKETS    16
+
+// Upper bounds (ms), the last bucket is open ended
+const uint16_t statsBounds[STATS_BUCKETS] = {
+  25, 50, 100, 150, 200, 300, 400, 500, 750, 1000, 1500, 2000, 3000, 5000, 10000, 65535
+};
+
+struct LatencyHist {
+  uint32_t counts[STATS_BUCKETS];
+  uint32_t maxMs;
+};
+
+struct EndpointStats {
+  char name[STATS_NAME_MAX + 1];
+  uint32_t samples;          // requests that got an HTTP status
+  uint32_t errors;           // no status, or the body was cut off
+  uint32_t reused;           // served on a kept-alive socket
+  LatencyHist total;
+  LatencyHist request;       // HttpTiming::responseMs
+  uint32_t dnsSum;
+  uint32_t connectSum;
+  uint32_t bodySum;
+};
+
+EndpointStats endpointStats[STATS_ENDPOINTS];
+uint8_t endpointCount = 0;
+SemaphoreHandle_t statsMutex;
+
+// ========== BODY PIPE ==========
+// Chunked transfers go from the socket to the STM32 as they arrive, staged
+// in the worker's pipeBuf one HTTP_DATA chunk at a time, so the first byte
+// leaves with the first TCP segment. Whole-body replies (text BODY: line,
+// binary HTTP_RESPONSE) are collected in the worker's bodyBuf first and go
+// out in one piece: the UART is only held for the write, not the download.
+#define PIPE_CHUNK_MAX  1024   // largest HTTP_DATA chunk, smaller requests are honoured
+#define STM32_RX_BUFFER 4096   // = ESP32_RX_BUFFER_SIZE, holds one whole-body reply
+// Largest whole body that still fits rx_buffer with what travels around it:
+// binary HTTP_RESPONSE = seq, u16 status, body, 9-byte timing trailer, CRC;
+// text = body, "\r\n", the HTTP_TIMING line (40 at most), "HTTP_END\r\n" and
+// the terminating NUL. Bigger bodies get HTTP_ERROR TOO_LARGE.
+#define PIPE_BODY_MAX   (STM32_RX_BUFFER - 1 - 2 - 9 - 2)
+#define PIPE_TEXT_BODY_MAX (STM32_RX_BUFFER - 1 - 2 - 40 - 10)
+#define BODY_PREVIEW    200    // body bytes echoed to the debug console
+
+// Frame writer, defined with the binary link functions
+void frameBegin(uint8_t type, uint8_t seq);
+void framePut(const uint8_t *data, size_t len);
+void framePutU32(uint32_t v);
+void frameEnd();
+
+class BodyPipe : public Stream {
+public:
+  size_t sent = 0;
+  uint32_t firstByteMs = 0;   // millis() when the first body byte came in
+  bool failed = false;        // out of credits, cancelled by the STM32, or too big
+  bool overflow = false;      // whole body past bodyMax
+  char preview[BODY_PREVIEW];
+  size_t previewLen = 0;
+
+  // chunkSize 0 = the whole body is collected in stage, bodyMax bytes at most
+  BodyPipe(uint8_t seq, uint16_t chunkSize, uint8_t *stage, size_t bodyMax, StreamCredit &credit)
+    : seq(seq), chunk(chunkSize > PIPE_CHUNK_MAX ? PIPE_CHUNK_MAX : chunkSize), stage(stage),
+      bodyMax(bodyMax), credit(credit) {}
+
+  // The collected whole body
+  const uint8_t *body() const { return stage; }
+
+  // HTTPClient::writeToStream() pushes the (de-chunked) body through here,
+  // a short count makes it give up on the transfer
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t *buf, size_t len) override {
+    if (failed || len == 0) return 0;
+    if (firstByteMs == 0) firstByteMs = millis();
+    keepPreview(buf, len);
+
+    if (chunk == 0) {
+      if (sent + len > bodyMax) {
+        overflow = failed = true;
+        return 0;
+      }
+      memcpy(stage + sent, buf, len);
+      sent += len;
+      return len;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+      size_t n = len - done;
+      if (n > chunk - staged) n = chunk - staged;
+      memcpy(stage + staged, buf + done, n);
+      staged += n;
+      done += n;
+      if (staged == chunk && !sendChunk()) return 0;
+    }
+    return len;
+  }
+
+  // One HTTP_DATA frame from the staging buffer, paid for with a credit
+  bool sendChunk() {
+    if (staged == 0) return true;
+    if (xSemaphoreTake(credit.sem, pdMS_TO_TICKS(STREAM_CREDIT_TIMEOUT)) != pdTRUE || credit.cancel) {
+      failed = true;
+      return false;
+    }
+    frameBegin(FRAME_HTTP_DATA, seq);
+    framePutU32(sent);
+    framePut(stage, staged);
+    frameEnd();
+    sent += staged;
+    staged = 0;
+    return true;
+  }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+private:
+  uint8_t seq;
+  uint16_t chunk;
+  uint8_t *stage;
+  size_t bodyMax;
+  StreamCredit &credit;
+  size_t staged = 0;
+
+  void keepPreview(const uint8_t *buf, size_t len) {
+    size_t n = BODY_PREVIEW - previewLen;
+    if (n > len) n = len;
+    memcpy(preview + previewLen, buf, n);
+    previewLen += n;
+  }
+};
+
+// ========== JSON PROJECTION ==========
+// HTTP_*_FIELDS: the body is parsed as it comes off the socket and only the
+// values on the requested paths are kept, as records for one HTTP_FIELDS
+// frame. Paths are keys joined by '.', array selectors [] [n] [a:b], a
+// leading ".." matches at any depth. Same parser and limits as JSON_Project*
+// on the STM32, which runs it itself on text-link bodies: a value longer
+// than PROJ_VALUE_SIZE - 1 is dropped, never sent cut.
+#define PROJ_MAX_DEPTH   8
+#define PROJ_KEY_SIZE    24
+#define PROJ_VALUE_SIZE  128    // = JSON_PROJ_VALUE_SIZE
+#define HTTP_FIELDS_MAX  4000   // record bytes per frame, fits the STM32 rx_buffer
+
+// Per-worker scratch, two requests in flight never share a buffer
+struct HttpWorker {
+  uint8_t fieldRecords[HTTP_FIELDS_MAX];
+  uint8_t pipeBuf[PIPE_CHUNK_MAX];
+  uint8_t bodyBuf[PIPE_BODY_MAX];
+  StreamCredit credit;
+};
+
+HttpWorker httpWorkers[HTTP_WORKERS];
+
+class JsonProjector : public Stream {
+public:
+  size_t recordsLen = 0;
+  int count = 0;
+  int dropped = 0;
+
+  JsonProjector(const char *fields, uint8_t *records) : spec(fields), records(records) {}
+
+  // HTTPClient::writeToStream() pushes the (de-chunked) body through here
+  size_t write(uint8_t c) override {
+    feed((char)c);
+    return 1;
+  }
+
+  size_t write(const uint8_t *buf, size_t len) override {
+    for (size_t i = 0; i < len; i++) feed((char)buf[i]);
+    return len;
+  }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+private:
+  enum { VALUE, STRING, ESCAPE, UNICODE, LITERAL };
+  enum { CAP_STRING, CAP_LITERAL, CAP_CONTAINER };
+
+  struct Level {
+    char key[PROJ_KEY_SIZE];
+    uint16_t index;
+    bool array;
+  };
+
+  const char *spec;
+  uint8_t *records;          // the worker's fieldRecords
+  Level level[PROJ_MAX_DEPTH];
+  uint8_t depth = 0;
+  uint8_t state = VALUE;
+  bool inKey = false;
+  bool expectKey = false;
+  uint8_t keyLen = 0;
+  uint8_t uniLeft = 0;
+  uint16_t uni = 0;
+  int field = -1;         // value being captured
+  uint8_t item = 0;
+  uint8_t capDepth = 0;
+  uint8_t capKind = CAP_STRING;
+  uint16_t valueLen = 0;     // PROJ_VALUE_SIZE = too long
+  char value[PROJ_VALUE_SIZE];
+
+  void put(char c) {
+    if (valueLen < PROJ_VALUE_SIZE - 1) value[valueLen++] = c;
+    else valueLen = PROJ_VALUE_SIZE;
+  }
+
+  // Decoded string text: member name or captured string
+  void text(char c) {
+    if (inKey) {
+      if (depth == 0 || depth > PROJ_MAX_DEPTH) return;
+      Level &lvl = level[depth - 1];
+      if (keyLen >= PROJ_KEY_SIZE - 1) {
+        lvl.key[0] = '\0';   // too long, never matches
+        return;
+      }
+      lvl.key[keyLen++] = c;
+      lvl.key[keyLen] = '\0';
+    } else if (field >= 0 && capKind == CAP_STRING) {
+      put(c);
+    }
+  }
+
+  void textUTF8(uint16_t cp) {
+    if (cp < 0x80) {
+      text((char)cp);
+    } else if (cp < 0x800) {
+      text((char)(0xC0 | (cp >> 6)));
+      text((char)(0x80 | (cp & 0x3F)));
+    } else {
+      text((char)(0xE0 | (cp >> 12)));
+      text((char)(0x80 | ((cp >> 6) & 0x3F)));
+      text((char)(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  // Record: u8 field | u8 item | u16 len | value
+  void emit() {
+    if (valueLen >= PROJ_VALUE_SIZE || recordsLen + 4 + valueLen > HTTP_FIELDS_MAX) {
+      dropped++;
+    } else {
+      uint8_t *r = records + recordsLen;
+      r[0] = (uint8_t)field;
+      r[1] = item;
+      r[2] = valueLen & 0xFF;
+      r[3] = valueLen >> 8;
+      memcpy(r + 4, value, valueLen);
+      recordsLen += 4 + valueLen;
+      count++;
+    }
+    field = -1;
+  }
+
+  // Next step of a path: a key (key set) or a selector (key NULL), NULL at the end
+  static const char *step(const char *s, const char *&key, uint8_t &keyLen,
+                          uint16_t &lo, uint16_t &hi) {
+    if (*s == '.') s++;
+    if (*s == '\0' || *s == ',') return NULL;
+
+    if (*s == '[') {
+      key = NULL;
+      lo = 0;
+      hi = 0xFFFF;
+      s++;
+      if (isdigit(*s)) {
+        for (lo = 0; isdigit(*s); s++) lo = lo * 10 + (*s - '0');
+        hi = lo + 1;
+      }
+      if (*s == ':') {
+        s++;
+        hi = 0xFFFF;
+        if (isdigit(*s)) {
+          for (hi = 0; isdigit(*s); s++) hi = hi * 10 + (*s - '0');
+        }
+      }
+      if (*s == ']') s++;
+      return s;
+    }
+
+    key = s;
+    while (*s != '\0' && *s != '.' && *s != '[' && *s != ',') s++;
+    keyLen = s - key;
+    return s;
+  }
+
+  bool match(const char *path, uint8_t &itemOut) const {
+    const char *key;
+    uint8_t kLen = 0;
+    uint16_t lo, hi;
+    uint8_t steps = 0;
+
+    bool anywhere = (path[0] == '.' && path[1] == '.');
+    if (anywhere) path += 2;
+    for (const char *s = path; (s = step(s, key, kLen, lo, hi)) != NULL; ) steps++;
+    if (steps == 0 || depth > PROJ_MAX_DEPTH) return false;
+    if (anywhere ? (depth < steps) : (depth != steps)) return false;
+
+    // A leading ".." lines the steps up with the innermost levels
+    const Level *lvl = &level[depth - steps];
+    for (const char *s = path; (s = step(s, key, kLen, lo, hi)) != NULL; lvl++) {
+      if (key) {
+        if (lvl->array || kLen == 0 || strncmp(lvl->key, key, kLen) != 0 || lvl->key[kLen] != '\0') {
+          return false;
+        }
+      } else if (!lvl->array || lvl->index < lo || lvl->index >= hi) {
+        return false;
+      }
+    }
+
+    itemOut = 0;
+    for (uint8_t i = 0; i < depth; i++) {
+      if (level[i].array) itemOut = (level[i].index > 0xFF) ? 0xFF : level[i].index;
+    }
+    return true;
+  }
+
+  // A value starts at the current path; values inside a captured one are part of it
+  void valueStart(uint8_t kind) {
+    if (field >= 0) return;
+    const char *path = spec;
+    for (int f = 0; path != NULL; f++) {
+      uint8_t it;
+      if (match(path, it)) {
+        field = f;
+        item = it;
+        capKind = kind;
+        capDepth = depth;
+        valueLen = 0;
+        return;
+      }
+      path = strchr(path, ',');
+      if (path) path++;
+    }
+  }
+
+  void feed(char c) {
+    bool raw = (field >= 0 && capKind == CAP_CONTAINER);
+
+    switch (state) {
+      case STRING:
+        if (raw) put(c);
+        if (c == '\\') {
+          state = ESCAPE;
+        } else if (c == '"') {
+          state = VALUE;
+          if (!inKey && field >= 0 && capKind == CAP_STRING) emit();
+          inKey = false;
+        } else {
+          text(c);
+        }
+        return;
+
+      case ESCAPE:
+        if (raw) put(c);
+        state = STRING;
+        switch (c) {
+          case 'n': c = '\n'; break;
+          case 't': c = '\t'; break;
+          case 'r': c = '\r'; break;
+          case 'b': c = '\b'; break;
+          case 'f': c = '\f'; break;
+          case 'u':
+            state = UNICODE;
+            uni = 0;
+            uniLeft = 4;
+            return;
+          default: break;   // \" \\ \/ stand for themselves
+        }
+        text(c);
+        return;
+
+      case UNICODE:
+        if (raw) put(c);
+        uni <<= 4;
+        if (c >= '0' && c <= '9') uni |= c - '0';
+        else if (c >= 'a' && c <= 'f') uni |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') uni |= c - 'A' + 10;
+        if (--uniLeft == 0) {
+          state = STRING;
+          textUTF8(uni);
+        }
+        return;
+
+      case LITERAL:
+        if (c != ',' && c != '}' && c != ']' && c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+          if (field >= 0) put(c);
+          return;
+        }
+        state = VALUE;
+        if (field >= 0 && capKind == CAP_LITERAL) emit();
+        raw = (field >= 0 && capKind == CAP_CONTAINER);
+        break;   // the delimiter is handled below
+    }
+
+    switch (c) {
+      case ' ': case '\t': case '\r': case '\n':
+        return;
+
+      case ':':
+        if (raw) put(c);
+        expectKey = false;
+        return;
+
+      case ',':
+        if (raw) put(c);
+        if (depth > 0 && depth <= PROJ_MAX_DEPTH) {
+          if (level[depth - 1].array) level[depth - 1].index++;
+          else expectKey = true;
+        }
+        return;
+
+      case '{':
+      case '[':
+        valueStart(CAP_CONTAINER);
+        if (field >= 0 && capKind == CAP_CONTAINER) put(c);
+        if (depth < PROJ_MAX_DEPTH) {
+          level[depth].array = (c == '[');
+          level[depth].index = 0;
+          level[depth].key[0] = '\0';
+        }
+        if (depth < 0xFF) depth++;
+        expectKey = (c == '{');
+        return;
+
+      case '}':
+      case ']':
+        if (raw) put(c);
+        if (depth > 0) depth--;
+        expectKey = false;
+        if (raw && depth == capDepth) emit();
+        return;
+
+      case '"':
+        inKey = expectKey;
+        if (inKey) {
+          keyLen = 0;
+          if (depth > 0 && depth <= PROJ_MAX_DEPTH) level[depth - 1].key[0] = '\0';
+        } else {
+          valueStart(CAP_STRING);
+        }
+        if (field >= 0 && capKind == CAP_CONTAINER) put(c);
+        state = STRING;
+        return;
+
+      default:
+        valueStart(CAP_LITERAL);
+        if (field >= 0) put(c);
+        state = LITERAL;
+        return;
+    }
+  }
+};
+
+// ========== RESPONSE CACHE ==========
+// GETs on paths the STM32 marked with HTTP_CACHE are kept in flash
+// (LittleFS), least recently used out. A fresh copy is answered without
+// touching the network. A stale one is answered at once, then the worker
+// revalidates it with If-None-Match while the STM32 carries on. An expired
+// one is revalidated before it is answered, and only answered as is when
+// the backend cannot be reached. Copies and rules survive a reboot, their
+// age does not: after a boot every copy is expired. Entries are keyed by
+// host, path and a hash of the API key and terminal ID the request carried.
+#define CACHE_RULES      4
+#define CACHE_ENTRIES    8
+#define CACHE_BODY_MAX   8192      // larger bodies pass through uncached
+#define CACHE_MAX_STALE  3600000   // older copies are revalidated before answering
+#define CACHE_DIR        "/cache"
+#define CACHE_INDEX      "/cache/index"
+
+enum { CACHE_OFF, CACHE_MISS, CACHE_FRESH, CACHE_STALE, CACHE_EXPIRED };
+
+struct CacheRule {
+  String path;               // prefix, empty = unused
+  uint32_t ttlMs;
+};
+
+struct CacheEntry {
+  String key;                // host + path, empty = unused
+  String etag;
+  uint32_t storedAt;         // last 200 or 304
+  bool aged;                 // loaded at boot, storedAt means nothing
+  uint32_t lastUsed;
+  uint8_t readers;           // workers answering from it right now
+};
+
+CacheRule cacheRules[CACHE_RULES];
+CacheEntry cacheEntries[CACHE_ENTRIES];
+SemaphoreHandle_t cacheMutex;
+bool cacheReady = false;     // LittleFS mounted
+
+// Hands a body on to dst (if any) and keeps a copy in a cache file, as
+// long as it fits CACHE_BODY_MAX
+class TeeStream : public Stream {
+public:
+  bool kept = true;          // the whole body is in the file
+
+  TeeStream(Stream *dst, File &file) : dst(dst), file(file) {}
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t *buf, size_t len) override {
+    if (kept) {
+      copied += len;
+      if (copied > CACHE_BODY_MAX || file.write(buf, len) != len) kept = false;
+    }
+    if (!dst) return kept ? len : 0;
+    return dst->write(buf, len);
+  }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+private:
+  Stream *dst;
+  File &file;
+  size_t copied = 0;
+};
+
+// A response body: the socket (copied into a cache file on the way if
+// copy is set), or a cached copy in flash
+struct BodySource {
+  HTTPClient *http;
+  File *file;
+  File *copy;
+  bool copied;               // after writeTo(): all of it went into copy
+
+  int size() {
+    return http ? http->getSize() : (int)file->size();
+  }
+
+  // Same contract as HTTPClient::writeToStream(): bytes moved, or HTTPC_ERROR_*
+  int writeTo(Stream *dst) {
+    if (http && copy) {
+      TeeStream tee(dst, *copy);
+      int n = http->writeToStream(&tee);
+      copied = tee.kept;
+      return n;
+    }
+    if (http) return http->writeToStream(dst);
+
+    uint8_t buf[256];
+    int total = 0;
+    size_t n;
+    while ((n = file->read(buf, sizeof(buf))) > 0) {
+      if (dst->write(buf, n) != n) return HTTPC_ERROR_STREAM_WRITE;
+      total += n;
+    }
+    return total;
+  }
 };
-const int numCommands = 16;
 
 void setup() {
   // START UART FIRST!
-  STM32Serial.begin(115200, SERIAL_8N1, STM32_RX_PIN, STM32_TX_PIN);
+  STM32Serial.setRxBufferSize(LINK_RX_BUFFER);
+  STM32Serial.setTxBufferSize(LINK_TX_BUFFER);
+  STM32Serial.begin(LINK_BAUD_DEFAULT, SERIAL_8N1, STM32_RX_PIN, STM32_TX_PIN);
   
   // Clear buffer
   delay(100);
@@ -70,6 +1093,8 @@ void setup() {
   
   // I2C setup (for LCD)
   Wire.begin(21, 22);
+
+  buildCommandTable();
   
   // Signal ready
   for (int i = 0; i < 3; i++) {
@@ -78,471 +1103,2652 @@ void setup() {
     digitalWrite(LED_PIN, LOW);
     delay(150);
   }
+
+  // Tasks: link (UART) and LCD/LED on core 1, HTTP workers next to WiFi on core 0
+  linkTxMutex = xSemaphoreCreateMutex();
+  httpQueue = xQueueCreate(HTTP_QUEUE_LEN, sizeof(HttpJob *));
+#if HTTP_JOB_POOL
+  httpJobFree = xQueueCreate(HTTP_JOBS, sizeof(HttpJob *));
+  for (int i = 0; i < HTTP_JOBS; i++) {
+    HttpJob *job = &httpJobs[i];
+    xQueueSend(httpJobFree, &job, 0);
+  }
+#endif
+  ioQueue = xQueueCreate(IO_QUEUE_LEN, sizeof(IoJob));
+  connMutex = xSemaphoreCreateMutex();
+  statsMutex = xSemaphoreCreateMutex();
+  cacheMutex = xSemaphoreCreateMutex();
+  netMutex = xSemaphoreCreateMutex();
+  backendMutex = xSemaphoreCreateMutex();
+  cacheBegin();
+  backendBegin();
+  wifiBegin();
+  for (int i = 0; i < HTTP_WORKERS; i++) {
+    httpWorkers[i].credit.sem = xSemaphoreCreateCounting(255, 0);
+    httpWorkers[i].credit.seq = -1;
+    xTaskCreatePinnedToCore(httpTask, "http", HTTP_TASK_STACK, &httpWorkers[i],
+                            HTTP_TASK_PRIO, NULL, HTTP_TASK_CORE);
+  }
+  xTaskCreatePinnedToCore(ioTask, "io", IO_TASK_STACK, NULL, IO_TASK_PRIO, NULL, IO_TASK_CORE);
+  xTaskCreatePinnedToCore(wifiTask, "wifi", WIFI_TASK_STACK, NULL, WIFI_TASK_PRIO,
+                          &wifiTaskHandle, WIFI_TASK_CORE);
+  xTaskCreatePinnedToCore(linkTask, "link", LINK_TASK_STACK, NULL, LINK_TASK_PRIO,
+                          &linkTaskHandle, LINK_TASK_CORE);
+  STM32Serial.onReceive(onLinkRx);
 }
 
 void loop() {
-  if (STM32Serial.available()) {
-    String message = STM32Serial.readStringUntil('\n');
-    message.trim();
-    
-    if (message.length() > 0) {
-      if (isCommand(message)) {
-        Serial.print("📥 [CMD] ");
-        Serial.println(message);
-        processCommand(message);
-      } else {
-        Serial.print("💬 [STM32] ");
-        Serial.println(message);
-      }
-    }
-  }
+  // Everything runs in the tasks started by setup()
+  vTaskDelete(NULL);
 }
 
-bool isCommand(String msg) {
-  for (int i = 0; i < numCommands; i++) {
-    if (msg.startsWith(commands[i])) {
-      return true;
-    }
-  }
-  return false;
+// UART driver callback: new bytes for the link task
+void onLinkRx() {
+  xTaskNotifyGive(linkTaskHandle);
 }
 
-void processCommand(String cmd) {
-  // ========== BASIC COMMANDS ==========
-  if (cmd == "PING") {
-    STM32Serial.println("PONG");
-    Serial.println("✅ → PONG\n");
-  }
-  
-  else if (cmd == "RESET") {
-    STM32Serial.println("RESTARTING");
-    Serial.println("🔄 → RESTARTING");
-    delay(100);
-    ESP.restart();
-  }
-  
-  // ========== LED COMMANDS ==========
-  else if (cmd == "LED_ON") {
-    digitalWrite(LED_PIN, HIGH);
-    STM32Serial.println("OK");
-    Serial.println("💡 LED ON → OK\n");
-  }
-  
-  else if (cmd == "LED_OFF") {
-    digitalWrite(LED_PIN, LOW);
-    STM32Serial.println("OK");
-    Serial.println("💡 LED OFF → OK\n");
-  }
-  
-  else if (cmd.startsWith("LED_BLINK,")) {
-    int times = cmd.substring(10).toInt();
-    Serial.printf("💡 LED BLINK x%d\n", times);
-    for (int i = 0; i < times; i++) {
-      digitalWrite(LED_PIN, HIGH);
-      delay(200);
-      digitalWrite(LED_PIN, LOW);
-      delay(200);
-    }
-    STM32Serial.println("OK");
-    Serial.println("✅ → OK\n");
-  }
-  
-  // ========== WIFI COMMANDS ==========
-  else if (cmd.startsWith("WIFI_CONNECT,")) {
-    handleWiFiConnect(cmd);
-  }
-  
-  else if (cmd == "WIFI_DISCONNECT") {
-    WiFi.disconnect();
-    STM32Serial.println("OK");
-    Serial.println("📡 Disconnected → OK\n");
-  }
-  
-  else if (cmd == "WIFI_STATUS") {
-    if (WiFi.status() == WL_CONNECTED) {
-      STM32Serial.println("CONNECTED");
-      Serial.println("✅ → CONNECTED\n");
-    } else {
-      STM32Serial.println("DISCONNECTED");
-      Serial.println("❌ → DISCONNECTED\n");
+// UART ingest and dispatch. Only fast commands run here, the rest is queued
+// to the I/O task or the HTTP workers.
+void linkTask(void *arg) {
+  (void)arg;
+  for (;;) {
+    if (!STM32Serial.available()) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LINK_IDLE_WAIT));
     }
-  }
-  
-  else if (cmd == "WIFI_IP") {
-    if (WiFi.status() == WL_CONNECTED) {
-      STM32Serial.print("IP:");
-      STM32Serial.println(WiFi.localIP().toString());
-      Serial.printf("🌐 → IP:%s\n\n", WiFi.localIP().toString().c_str());
+
+    if (linkProbation && millis() - linkProbationStart > LINK_PROBATION_MS) {
+      Serial.printf("⚠️ [LINK] Nothing valid at %u baud, back to %u\n\n", linkBaud, linkPrevBaud);
+      setLinkSpeed(linkPrevBaud, linkPrevFlow);
+      linkProbation = false;
+    }
+
+    if (binaryLink) {
+      pollBinaryLink();
     } else {
-      STM32Serial.println("ERROR:NOT_CONNECTED");
-      Serial.println("❌ → ERROR:NOT_CONNECTED\n");
+      pollTextLink();
     }
   }
-  
-  // ========== HTTP COMMANDS ==========
-  else if (cmd.startsWith("HTTP_GET,")) {
-    handleHTTPGet(cmd);
-  }
-  
-  else if (cmd.startsWith("HTTP_POST,")) {
-    handleHTTPPost(cmd);
-  }
-  
-  // ========== LCD COMMANDS ==========
-  else if (cmd == "LCD_INIT") {
-    Serial.println("🖥️  Initializing LCD...");
-    lcd.init();
-    lcd.backlight();
-    lcd.clear();
-    lcdInitialized = true;
-    STM32Serial.println("OK");
-    Serial.println("✅ → LCD initialized → OK\n");
-  }
-  
-  else if (cmd == "LCD_CLEAR") {
-    if (!checkLCDInit()) return;
-    lcd.clear();
-    STM32Serial.println("OK");
-    Serial.println("🖥️  LCD cleared → OK\n");
-  }
-  
-  else if (cmd.startsWith("LCD_PRINT,")) {
-    if (!checkLCDInit()) return;
-    String text = cmd.substring(10);
-    lcd.print(text);
-    STM32Serial.println("OK");
-    Serial.printf("🖥️  LCD print: \"%s\" → OK\n\n", text.c_str());
-  }
-  
-  else if (cmd.startsWith("LCD_CURSOR,")) {
-    if (!checkLCDInit()) return;
-    int firstComma = cmd.indexOf(',');
-    int secondComma = cmd.indexOf(',', firstComma + 1);
-    int row = cmd.substring(firstComma + 1, secondComma).toInt();
-    int col = cmd.substring(secondComma + 1).toInt();
-    lcd.setCursor(col, row);
-    STM32Serial.println("OK");
-    Serial.printf("🖥️  LCD cursor: (%d,%d) → OK\n\n", row, col);
-  }
-  
-  else if (cmd.startsWith("LCD_BACKLIGHT,")) {
-    if (!checkLCDInit()) return;
-    int state = cmd.substring(14).toInt();
-    if (state) {
-      lcd.backlight();
-      Serial.println("💡 LCD backlight ON");
-    } else {
-      lcd.noBacklight();
-      Serial.println("💡 LCD backlight OFF");
+}
+
+// LCD (I2C) and LED work, in order, off the link task
+void ioTask(void *arg) {
+  (void)arg;
+  IoJob job;
+  for (;;) {
+    if (xQueueReceive(ioQueue, &job, portMAX_DELAY) != pdTRUE) continue;
+    switch (job.type) {
+      case FRAME_LED_ON:        doLED(job.seq, true); break;
+      case FRAME_LED_OFF:       doLED(job.seq, false); break;
+      case FRAME_LED_BLINK:     doLEDBlink(job.seq, job.a); break;
+      case FRAME_LCD_INIT:      doLCDInit(job.seq); break;
+      case FRAME_LCD_CLEAR:     doLCDClear(job.seq); break;
+      case FRAME_LCD_PRINT:     doLCDPrint(job.seq, job.text, job.len); break;
+      case FRAME_LCD_CURSOR:    doLCDCursor(job.seq, job.a, job.b); break;
+      case FRAME_LCD_BACKLIGHT: doLCDBacklight(job.seq, job.a); break;
     }
-    STM32Serial.println("OK");
-    Serial.println();
   }
-  
-  else {
-    STM32Serial.println("ERROR:UNKNOWN");
-    Serial.println("❌ Unknown command\n");
+}
+
+// Hand an LCD/LED command to the I/O task (link task only, replies with curSeq)
+void queueIo(uint8_t type, int a, int b, const char *text, size_t len) {
+  IoJob job;
+  job.type = type;
+  job.seq = curSeq;
+  job.a = a;
+  job.b = b;
+  job.len = len < IO_TEXT_MAX ? len : IO_TEXT_MAX;
+  if (text) memcpy(job.text, text, job.len);
+  if (xQueueSend(ioQueue, &job, 0) != pdTRUE) {
+    reply("ERROR:BUSY");
+    Serial.println("❌ LCD/LED queue full\n");
   }
 }
 
-// ========== HELPER FUNCTIONS ==========
+// An empty job, NULL when all are in use (the queue is full then)
+HttpJob *jobAlloc() {
+#if HTTP_JOB_POOL
+  HttpJob *job;
+  if (xQueueReceive(httpJobFree, &job, 0) != pdTRUE) return NULL;
+  // Emptied, not freed: the buffers stay for the next request
+  job->chunkSize = 0;
+  job->credits = 0;
+  job->path = "";
+  job->apiKey = "";
+  job->terminalId = "";
+  job->jsonData = "";
+  job->fields = "";
+  return job;
+#else
+  return new HttpJob();
+#endif
+}
 
-bool checkLCDInit() {
-  if (!lcdInitialized) {
-    STM32Serial.println("ERROR:NOT_INIT");
-    Serial.println("❌ LCD not initialized!\n");
-    return false;
-  }
-  return true;
+void jobFree(HttpJob *job) {
+#if HTTP_JOB_POOL
+  xQueueSend(httpJobFree, &job, 0);
+#else
+  delete job;
+#endif
 }
 
-void handleWiFiConnect(String cmd) {
-  // Format: WIFI_CONNECT,ssid,password
-  int firstComma = cmd.indexOf(',');
-  int secondComma = cmd.indexOf(',', firstComma + 1);
-  
-  String ssid = cmd.substring(firstComma + 1, secondComma);
-  String password = cmd.substring(secondComma + 1);
-  
-  Serial.printf("📶 Connecting to: %s\n", ssid.c_str());
-  
-  // Disconnect if already connected
-  if (WiFi.status() != WL_DISCONNECTED) {
-    WiFi.disconnect(true);
-    delay(100);
-  }
-  
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(ssid.c_str(), password.c_str());
-  
-  // Wait max 10 seconds
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
-  }
-  Serial.println();
-  
-  // Send response immediately
-  if (WiFi.status() == WL_CONNECTED) {
-    STM32Serial.println("CONNECTED");
-    Serial.printf("✅ Connected! IP: %s\n\n", WiFi.localIP().toString().c_str());
-  } else {
-    STM32Serial.println("ERROR");
-    Serial.println("❌ Connection failed!\n");
-  }
+void replyHttpBusy() {
+  reply("ERROR:BUSY");
+  Serial.println("❌ HTTP queue full\n");
 }
 
-void handleHTTPGet(String cmd) {
-  // Format: HTTP_GET,host,port,path,api_key,terminal_id
-  if (WiFi.status() != WL_CONNECTED) {
-    STM32Serial.println("ERROR:NO_WIFI");
-    Serial.println("❌ Not connected to WiFi!\n");
-    return;
+// Hand a job to the HTTP workers, the link task goes back to reading commands
+void queueHttp(HttpJob *job) {
+  if (xQueueSend(httpQueue, &job, 0) != pdTRUE) {
+    jobFree(job);
+    replyHttpBusy();
+  }
+}
+
+// Assemble lines from whatever the UART has buffered, never waiting for more
+void pollTextLink() {
+  while (STM32Serial.available()) {
+    uint8_t b = STM32Serial.read();
+
+    if (b != '\n') {
+      if (frameLen < FRAME_BUF_SIZE) {
+        frameBuf[frameLen++] = b;
+      } else {
+        lineOverflow = true;
+      }
+      continue;
+    }
+
+    size_t len = frameLen;
+    frameLen = 0;
+    if (lineOverflow) {
+      lineOverflow = false;
+      reply("ERROR:TOO_LONG");
+      Serial.println("❌ Line too long, dropped\n");
+      continue;
+    }
+    frameBuf[len] = '\0';
+    dispatchLine((char *)frameBuf, len);
+
+    // PING,BIN1 switched the link: the next bytes are frames
+    if (binaryLink) return;
+  }
+}
+
+uint32_t hashCommand(const char *s, size_t len) {
+  uint32_t h = 2166136261u;   // FNV-1a
+  while (len--) {
+    h = (h ^ (uint8_t)*s++) * 16777619u;
+  }
+  return h;
+}
+
+void cmdPing(char **argv, int argc) {
+  if (argc == 1) {
+    doPing();
+  } else if (strcmp(argv[1], "BIN1") == 0) {
+    reply("PONG,BIN1");
+    binaryLink = true;
+    frameLen = 0;
+    frameOverflow = false;
+    lastRxSeq = -1;
+    Serial.println("✅ → PONG,BIN1 (binary link)\n");
+  } else {
+    reply("ERROR:UNKNOWN");
+    Serial.println("❌ Unknown command\n");
+  }
+}
+
+void cmdReset(char **argv, int argc)          { (void)argv; (void)argc; doReset(); }
+void cmdLEDOn(char **argv, int argc)          { (void)argv; (void)argc; queueIo(FRAME_LED_ON, 0, 0, NULL, 0); }
+void cmdLEDOff(char **argv, int argc)         { (void)argv; (void)argc; queueIo(FRAME_LED_OFF, 0, 0, NULL, 0); }
+void cmdLEDBlink(char **argv, int argc)       { (void)argc; queueIo(FRAME_LED_BLINK, atoi(argv[1]), 0, NULL, 0); }
+void cmdWiFiConnect(char **argv, int argc)    { doWiFiConnect(argv[1], argc > 2 ? argv[2] : ""); }
+void cmdWiFiDisconnect(char **argv, int argc) { (void)argv; (void)argc; doWiFiDisconnect(); }
+void cmdWiFiStatus(char **argv, int argc)     { (void)argv; (void)argc; doWiFiStatus(); }
+void cmdWiFiIP(char **argv, int argc)         { (void)argv; (void)argc; doWiFiIP(); }
+void cmdWiFiAdd(char **argv, int argc)        { doWiFiAdd(atoi(argv[1]), argv[2], argc > 3 ? argv[3] : ""); }
+void cmdWiFiRoam(char **argv, int argc)       { (void)argv; (void)argc; doWiFiRoam(); }
+void cmdWiFiStatic(char **argv, int argc) {
+  doWiFiStatic(argc > 1 ? argv[1] : "", argc > 2 ? argv[2] : "", argc > 3 ? argv[3] : "",
+               argc > 4 ? argv[4] : "");
+}
+void cmdLCDInit(char **argv, int argc)        { (void)argv; (void)argc; queueIo(FRAME_LCD_INIT, 0, 0, NULL, 0); }
+void cmdHTTPWarm(char **argv, int argc)       { (void)argc; queueWarm(argv[1], atoi(argv[2])); }
+void cmdStats(char **argv, int argc)          { sendStats(argc > 1 ? atoi(argv[1]) : 0); }
+void cmdHTTPCache(char **argv, int argc)      { (void)argc; doHTTPCache(argv[1], strtoul(argv[2], NULL, 10)); }
+void cmdHTTPBackend(char **argv, int argc) {
+  doHTTPBackend(atoi(argv[1]), argc > 2 ? argv[2] : "", argc > 3 ? atoi(argv[3]) : 443);
+}
+void cmdLCDClear(char **argv, int argc)       { (void)argv; (void)argc; queueIo(FRAME_LCD_CLEAR, 0, 0, NULL, 0); }
+void cmdLCDPrint(char **argv, int argc)       { (void)argc; queueIo(FRAME_LCD_PRINT, 0, 0, argv[1], strlen(argv[1])); }
+void cmdLCDCursor(char **argv, int argc)      { (void)argc; queueIo(FRAME_LCD_CURSOR, atoi(argv[1]), atoi(argv[2]), NULL, 0); }
+void cmdLCDBacklight(char **argv, int argc)   { (void)argc; queueIo(FRAME_LCD_BACKLIGHT, atoi(argv[1]), 0, NULL, 0); }
+
+// HTTP_GET,host,port,path,api_key,terminal_id
+void cmdHTTPGet(char **argv, int argc) {
+  (void)argc;
+  HttpJob *job = jobAlloc();
+  if (!job) {
+    replyHttpBusy();
+    return;
+  }
+  job->kind = JOB_GET;
+  job->seq = curSeq;
+  job->chunkSize = 0;
+  job->credits = 0;
+  job->host = argv[1];
+  job->port = atoi(argv[2]);
+  job->path = argv[3];
+  job->apiKey = argv[4];
+  job->terminalId = argv[5];
+  queueHttp(job);
+}
+
+// HTTP_POST,host,port,path,json_data,api_key,terminal_id
+// The JSON has commas of its own: api_key and terminal_id are cut from the right
+void cmdHTTPPost(char **argv, int argc) {
+  (void)argc;
+  char *json = argv[4];
+  char *terminalId = strrchr(json, ',');
+  if (!terminalId) {
+    reply("ERROR:INVALID_FORMAT");
+    Serial.println("❌ Missing api_key or terminal_id!\n");
+    return;
+  }
+  *terminalId++ = '\0';
+  char *apiKey = strrchr(json, ',');
+  if (!apiKey) {
+    reply("ERROR:INVALID_FORMAT");
+    Serial.println("❌ Missing api_key or terminal_id!\n");
+    return;
+  }
+  *apiKey++ = '\0';
+
+  HttpJob *job = jobAlloc();
+  if (!job) {
+    replyHttpBusy();
+    return;
+  }
+  job->kind = JOB_POST;
+  job->seq = curSeq;
+  job->chunkSize = 0;
+  job->credits = 0;
+  job->host = argv[1];
+  job->port = atoi(argv[2]);
+  job->path = argv[3];
+  job->jsonData = json;
+  job->apiKey = apiKey;
+  job->terminalId = terminalId;
+  queueHttp(job);
+}
+
+const Command commandTable[] = {
+  { "PING",            0, 1, cmdPing },
+  { "RESET",           0, 0, cmdReset },
+  { "LED_ON",          0, 0, cmdLEDOn },
+  { "LED_OFF",         0, 0, cmdLEDOff },
+  { "LED_BLINK",       1, 1, cmdLEDBlink },
+  { "WIFI_CONNECT",    1, 2, cmdWiFiConnect },
+  { "WIFI_DISCONNECT", 0, 0, cmdWiFiDisconnect },
+  { "WIFI_STATUS",     0, 0, cmdWiFiStatus },
+  { "WIFI_IP",         0, 0, cmdWiFiIP },
+  { "WIFI_STATIC",     0, 4, cmdWiFiStatic },
+  { "WIFI_ADD",        1, 3, cmdWiFiAdd },
+  { "WIFI_ROAM",       0, 0, cmdWiFiRoam },
+  { "HTTP_GET",        5, 5, cmdHTTPGet },
+  { "HTTP_POST",       4, 4, cmdHTTPPost },
+  { "HTTP_WARM",       2, 2, cmdHTTPWarm },
+  { "STATS",           0, 1, cmdStats },
+  { "HTTP_CACHE",      2, 2, cmdHTTPCache },
+  { "HTTP_BACKEND",    1, 3, cmdHTTPBackend },
+  { "LCD_INIT",        0, 0, cmdLCDInit },
+  { "LCD_CLEAR",       0, 0, cmdLCDClear },
+  { "LCD_PRINT",       1, 1, cmdLCDPrint },
+  { "LCD_CURSOR",      2, 2, cmdLCDCursor },
+  { "LCD_BACKLIGHT",   1, 1, cmdLCDBacklight },
+};
+const int numCommands = sizeof(commandTable) / sizeof(commandTable[0]);
+
+void buildCommandTable() {
+  memset(cmdSlots, 0, sizeof(cmdSlots));
+  for (int i = 0; i < numCommands; i++) {
+    uint32_t h = hashCommand(commandTable[i].name, strlen(commandTable[i].name));
+    uint8_t slot = h & (CMD_SLOTS - 1);
+    while (cmdSlots[slot]) slot = (slot + 1) & (CMD_SLOTS - 1);
+    cmdSlots[slot] = i + 1;
+    cmdHashes[slot] = h;
+  }
+}
+
+const Command *findCommand(const char *name, size_t len) {
+  uint32_t h = hashCommand(name, len);
+  for (uint8_t slot = h & (CMD_SLOTS - 1); cmdSlots[slot]; slot = (slot + 1) & (CMD_SLOTS - 1)) {
+    const Command *cmd = &commandTable[cmdSlots[slot] - 1];
+    if (cmdHashes[slot] == h && strncmp(cmd->name, name, len) == 0 && cmd->name[len] == '\0') {
+      return cmd;
+    }
+  }
+  return NULL;
+}
+
+// One text line, NUL-terminated in frameBuf; split in place and dispatched
+void dispatchLine(char *line, size_t len) {
+  // Leading NULs are frame delimiters sent ahead of a PING,BIN1 probe
+  while (len > 0 && (*line == '\0' || *line == ' ' || *line == '\t')) {
+    line++;
+    len--;
+  }
+  while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t')) {
+    line[--len] = '\0';
+  }
+  if (len == 0) return;
+
+#if CMD_TIMING
+  uint32_t start = ESP.getCycleCount();
+#endif
+  char *comma = (char *)memchr(line, ',', len);
+  size_t nameLen = comma ? (size_t)(comma - line) : len;
+  const Command *cmd = findCommand(line, nameLen);
+  if (!cmd) {
+    // Anything else is the STM32's debug output
+    Serial.print("💬 [STM32] ");
+    Serial.println(line);
+    return;
+  }
+
+  Serial.print("📥 [CMD] ");
+  Serial.println(line);
+
+  char *argv[CMD_MAX_ARGS + 1];
+  int argc = 1;
+  argv[0] = line;
+  if (comma) {
+    *comma = '\0';
+    argv[argc++] = comma + 1;
+    for (char *p = comma + 1; *p && argc <= cmd->maxArgs; p++) {
+      if (*p == ',') {
+        *p = '\0';
+        argv[argc++] = p + 1;
+      }
+    }
+  }
+#if CMD_TIMING
+  cmdCycles = ESP.getCycleCount() - start;
+#endif
+
+  if (argc - 1 < cmd->minArgs || argc - 1 > cmd->maxArgs) {
+    reply("ERROR:INVALID_FORMAT");
+    Serial.println("❌ Wrong number of fields\n");
+    return;
+  }
+#if CMD_TIMING
+  Serial.printf("⏱️ [CMD] split + lookup: %u cycles\n", cmdCycles);
+  cmdHeap = ESP.getFreeHeap();
+  uint32_t handlerStart = ESP.getCycleCount();
+#endif
+  cmd->handler(argv, argc);
+#if CMD_TIMING
+  Serial.printf("⏱️ [CMD] handler: %u cycles, heap %d bytes\n", ESP.getCycleCount() - handlerStart,
+                (int)ESP.getFreeHeap() - (int)cmdHeap);
+#endif
+}
+
+// ========== BINARY LINK FUNCTIONS ==========
+
+uint16_t crc16Update(uint16_t crc, const uint8_t *data, size_t len) {
+  while (len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+void cobsFlush() {
+  txBlock[0] = txBlockLen;
+  STM32Serial.write(txBlock, txBlockLen);
+  txBlockLen = 1;
+}
+
+void cobsPut(uint8_t b) {
+  if (b == 0) {
+    cobsFlush();
+    return;
+  }
+  txBlock[txBlockLen++] = b;
+  if (txBlockLen == 255) {
+    cobsFlush();
+  }
+}
+
+void framePut(const uint8_t *data, size_t len) {
+  txCrc = crc16Update(txCrc, data, len);
+  while (len--) {
+    cobsPut(*data++);
+  }
+}
+
+void framePutU16(uint16_t v) {
+  uint8_t b[2] = { (uint8_t)(v & 0xFF), (uint8_t)(v >> 8) };
+  framePut(b, 2);
+}
+
+void framePutU32(uint32_t v) {
+  uint8_t b[4] = { (uint8_t)(v & 0xFF), (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+  framePut(b, 4);
+}
+
+void framePutStr(const char *s) {
+  size_t n = strlen(s);
+  framePutU16(n);
+  framePut((const uint8_t *)s, n);
+}
+
+void framePutStr(const String &s) {
+  framePutU16(s.length());
+  framePut((const uint8_t *)s.c_str(), s.length());
+}
+
+// frameBegin() .. frameEnd() holds linkTxMutex
+void frameBegin(uint8_t type, uint8_t seq) {
+  uint8_t hdr[2] = { type, seq };
+  xSemaphoreTake(linkTxMutex, portMAX_DELAY);
+  txBlockLen = 1;
+  txCrc = 0xFFFF;
+  framePut(hdr, 2);
+}
+
+void frameEnd() {
+  uint16_t crc = txCrc;
+  cobsPut(crc & 0xFF);
+  cobsPut(crc >> 8);
+  cobsFlush();
+  STM32Serial.write((uint8_t)0);
+  xSemaphoreGive(linkTxMutex);
+}
+
+uint16_t timingMs(uint32_t ms) {
+  return ms > 0xFFFF ? 0xFFFF : ms;
+}
+
+uint8_t timingFlags(const HttpTiming &t) {
+  return (t.reused ? TIMING_REUSED : 0) | (t.tls ? TIMING_TLS : 0) | (t.cached ? TIMING_CACHED : 0);
+}
+
+// Timing trailer of the final frame of a response
+void framePutTiming(const HttpTiming &t) {
+  framePutU16(timingMs(t.dnsMs));
+  framePutU16(timingMs(t.connectMs));
+  framePutU16(timingMs(t.responseMs));
+  framePutU16(timingMs(t.bodyMs));
+  uint8_t flags = timingFlags(t);
+  framePut(&flags, 1);
+}
+
+// In-place COBS decode, returns decoded length (0 = malformed)
+size_t cobsDecode(uint8_t *buf, size_t len) {
+  size_t in = 0, out = 0;
+  while (in < len) {
+    uint8_t code = buf[in++];
+    if (code == 0 || in + code - 1 > len) return 0;
+    for (uint8_t i = 1; i < code; i++) {
+      buf[out++] = buf[in++];
+    }
+    if (code != 0xFF && in < len) {
+      buf[out++] = 0;
+    }
+  }
+  return out;
+}
+
+void pollBinaryLink() {
+  while (STM32Serial.available()) {
+    uint8_t b = STM32Serial.read();
+
+    if (b == 0) {
+      if (frameLen > 0) {
+        handleFrame();
+      }
+      frameLen = 0;
+      frameOverflow = false;
+      continue;
+    }
+
+    // Plain text PING: the STM32 restarted or is renegotiating the link.
+    // No valid frame starts with "PI" (0x49 is not a request type).
+    if (b == '\n' && frameLen >= 4 && memcmp(frameBuf, "PING", 4) == 0) {
+      size_t len = frameLen;
+      frameBuf[len] = '\0';
+      frameLen = 0;
+      binaryLink = false;
+      dispatchLine((char *)frameBuf, len);
+      return;
+    }
+
+    if (frameLen < FRAME_BUF_SIZE) {
+      frameBuf[frameLen++] = b;
+    } else {
+      frameOverflow = true;
+    }
+  }
+}
+
+void handleFrame() {
+  if (frameOverflow) {
+    Serial.println("❌ [BIN] Frame too long, dropped\n");
+    return;
+  }
+
+  size_t len = cobsDecode(frameBuf, frameLen);
+  if (len < 4) {
+    Serial.println("❌ [BIN] Malformed frame\n");
+    return;
+  }
+
+  uint16_t crc = frameBuf[len - 2] | (frameBuf[len - 1] << 8);
+  if (crc16Update(0xFFFF, frameBuf, len - 2) != crc) {
+    Serial.println("❌ [BIN] CRC error\n");
+    return;
+  }
+
+  if (linkProbation) {
+    linkProbation = false;
+    Serial.printf("✅ [LINK] Running at %u baud%s\n\n", linkBaud, linkFlow ? " RTS/CTS" : "");
+  }
+
+  uint8_t type = frameBuf[0];
+  curSeq = frameBuf[1];
+  if (lastRxSeq >= 0 && curSeq != (uint8_t)(lastRxSeq + 1)) {
+    Serial.printf("⚠️ [BIN] Seq gap: expected %d, got %d\n", (uint8_t)(lastRxSeq + 1), curSeq);
+  }
+  lastRxSeq = curSeq;
+
+  FrameReader rd = { frameBuf + 2, len - 4, true };
+#if CMD_TIMING
+  cmdHeap = ESP.getFreeHeap();
+  uint32_t start = ESP.getCycleCount();
+#endif
+  processFrame(type, rd);
+#if CMD_TIMING
+  Serial.printf("⏱️ [BIN] frame 0x%02X: %u cycles, heap %d bytes\n", type, ESP.getCycleCount() - start,
+                (int)ESP.getFreeHeap() - (int)cmdHeap);
+#endif
+}
+
+void processFrame(uint8_t type, FrameReader &rd) {
+  if (type == FRAME_LOG) {
+    String text = rd.str();
+    text.trim();
+    Serial.print("💬 [STM32] ");
+    Serial.println(text);
+    return;
+  }
+
+  Serial.printf("📥 [BIN] type=0x%02X seq=%d\n", type, curSeq);
+
+  // Every handled frame returns; a break means its fields were truncated
+  switch (type) {
+    case FRAME_PING:            doPing(); return;
+    case FRAME_RESET:           doReset(); return;
+    case FRAME_LED_ON:          queueIo(type, 0, 0, NULL, 0); return;
+    case FRAME_LED_OFF:         queueIo(type, 0, 0, NULL, 0); return;
+    case FRAME_WIFI_DISCONNECT: doWiFiDisconnect(); return;
+    case FRAME_WIFI_STATUS:     doWiFiStatus(); return;
+    case FRAME_WIFI_IP:         doWiFiIP(); return;
+    case FRAME_LCD_INIT:        queueIo(type, 0, 0, NULL, 0); return;
+    case FRAME_LCD_CLEAR:       queueIo(type, 0, 0, NULL, 0); return;
+
+    case FRAME_LED_BLINK: {
+      uint8_t times = rd.u8();
+      if (!rd.ok) break;
+      queueIo(type, times, 0, NULL, 0);
+      return;
+    }
+
+    case FRAME_LCD_PRINT: {
+      uint16_t len;
+      const char *text = rd.view(len);
+      if (!rd.ok) break;
+      queueIo(type, 0, 0, text, len);
+      return;
+    }
+
+    case FRAME_LCD_CURSOR: {
+      uint8_t row = rd.u8();
+      uint8_t col = rd.u8();
+      if (!rd.ok) break;
+      queueIo(type, row, col, NULL, 0);
+      return;
+    }
+
+    case FRAME_LCD_BACKLIGHT: {
+      uint8_t state = rd.u8();
+      if (!rd.ok) break;
+      queueIo(type, state, 0, NULL, 0);
+      return;
+    }
+
+    case FRAME_WIFI_CONNECT: {
+      String ssid = rd.str();
+      String password = rd.str();
+      if (!rd.ok) break;
+      doWiFiConnect(ssid, password);
+      return;
+    }
+
+    case FRAME_WIFI_STATIC: {
+      String ip = rd.str();
+      String gateway = rd.str();
+      String subnet = rd.str();
+      String dns = rd.str();
+      if (!rd.ok) break;
+      doWiFiStatic(ip, gateway, subnet, dns);
+      return;
+    }
+
+    case FRAME_WIFI_ADD: {
+      uint8_t slot = rd.u8();
+      String ssid = rd.str();
+      String password = rd.str();
+      if (!rd.ok) break;
+      doWiFiAdd(slot, ssid, password);
+      return;
+    }
+
+    case FRAME_WIFI_ROAM: doWiFiRoam(); return;
+
+    case FRAME_CREDIT: {
+      uint8_t seq = rd.u8();
+      uint8_t chunks = rd.u8();
+      if (!rd.ok) break;
+      for (int w = 0; w < HTTP_WORKERS; w++) {
+        StreamCredit &credit = httpWorkers[w].credit;
+        if (seq != credit.seq) continue;
+        if (chunks == 0) {
+          credit.cancel = true;
+          chunks = 1;   // wake the HTTP task so it sees the cancel
+        }
+        for (uint8_t i = 0; i < chunks; i++) xSemaphoreGive(credit.sem);
+      }
+      return;
+    }
+
+    case FRAME_LINK_SPEED: {
+      uint32_t baud = rd.u32();
+      uint8_t flow = rd.u8();
+      if (!rd.ok) break;
+      doLinkSpeed(baud, flow != 0);
+      return;
+    }
+
+    case FRAME_LINK_TEST:
+      // Echo the pattern untouched, the STM32 compares and times it
+      frameBegin(FRAME_LINK_ECHO, curSeq);
+      framePut(rd.p, rd.left);
+      frameEnd();
+      return;
+
+    case FRAME_HTTP_WARM: {
+      String host = rd.str();
+      uint16_t port = rd.u16();
+      if (!rd.ok) break;
+      queueWarm(host, port);
+      return;
+    }
+
+    case FRAME_HTTP_CACHE: {
+      String path = rd.str();
+      uint32_t ttl = rd.u32();
+      if (!rd.ok) break;
+      doHTTPCache(path, ttl);
+      return;
+    }
+
+    case FRAME_HTTP_BACKEND: {
+      uint8_t slot = rd.u8();
+      String host = rd.str();
+      uint16_t port = rd.u16();
+      if (!rd.ok) break;
+      doHTTPBackend(slot, host, port);
+      return;
+    }
+
+    case FRAME_STATS: {
+      uint8_t index = rd.u8();
+      if (!rd.ok) break;
+      sendStats(index);
+      return;
+    }
+
+    case FRAME_HTTP_GET:
+    case FRAME_HTTP_POST:
+    case FRAME_HTTP_POST_JSON:
+    case FRAME_HTTP_GET_FIELDS:
+    case FRAME_HTTP_POST_FIELDS:
+    case FRAME_HTTP_GET_CHUNKED:
+    case FRAME_HTTP_POST_CHUNKED:
+    case FRAME_HTTP_POST_JSON_CHUNKED: {
+      HttpJob *job = jobAlloc();
+      if (!job) {
+        replyHttpBusy();
+        return;
+      }
+      bool post = (type == FRAME_HTTP_POST || type == FRAME_HTTP_POST_JSON ||
+                   type == FRAME_HTTP_POST_FIELDS || type == FRAME_HTTP_POST_CHUNKED ||
+                   type == FRAME_HTTP_POST_JSON_CHUNKED);
+      job->kind = post ? JOB_POST : JOB_GET;
+      job->seq = curSeq;
+      rd.strTo(job->host);
+      job->port = rd.u16();
+      rd.strTo(job->path);
+      rd.strTo(job->apiKey);
+      rd.strTo(job->terminalId);
+      if (type == FRAME_HTTP_GET_FIELDS || type == FRAME_HTTP_POST_FIELDS) {
+        rd.strTo(job->fields);
+        if (job->fields.length() == 0) rd.ok = false;
+      }
+      job->chunkSize = 0;
+      job->credits = 0;
+      if (type == FRAME_HTTP_POST_JSON_CHUNKED) {
+        // The JSON runs to the end of the frame, so the chunk parameters come first
+        job->chunkSize = rd.u16();
+        job->credits = rd.u8();
+        if (job->chunkSize == 0) rd.ok = false;
+      }
+      if (type == FRAME_HTTP_POST_JSON || type == FRAME_HTTP_POST_FIELDS ||
+          type == FRAME_HTTP_POST_JSON_CHUNKED) {
+        rd.restJsonTo(job->jsonData);
+      } else if (post) {
+        rd.strTo(job->jsonData);
+      }
+      if (type == FRAME_HTTP_GET_CHUNKED || type == FRAME_HTTP_POST_CHUNKED) {
+        job->chunkSize = rd.u16();
+        job->credits = rd.u8();
+        if (job->chunkSize == 0) rd.ok = false;
+      }
+      if (!rd.ok) {
+        jobFree(job);
+        break;
+      }
+      queueHttp(job);
+      return;
+    }
+
+    default:
+      reply("ERROR:UNKNOWN");
+      Serial.println("❌ Unknown frame type\n");
+      return;
+  }
+
+  reply("ERROR:INVALID_FORMAT");
+  Serial.println("❌ Truncated frame fields\n");
+}
+
+// ========== HELPER FUNCTIONS ==========
+
+// Short reply to request seq on whichever link is active (text line or REPLY frame)
+void replyTo(uint8_t seq, const char *text) {
+  if (binaryLink) {
+    frameBegin(FRAME_REPLY, seq);
+    framePutStr(text);
+    frameEnd();
+  } else {
+    xSemaphoreTake(linkTxMutex, portMAX_DELAY);
+    STM32Serial.println(text);
+    xSemaphoreGive(linkTxMutex);
+  }
+}
+
+void replyTo(uint8_t seq, const String &text) {
+  replyTo(seq, text.c_str());
+}
+
+// Reply to the request being handled by the link task
+void reply(const char *text) {
+  replyTo(curSeq, text);
+}
+
+void reply(const String &text) {
+  replyTo(curSeq, text.c_str());
+}
+
+// 2xx without a projection: pipe the body to the STM32 while it downloads
+// Returns false when the body was cut off (the socket cannot be reused)
+bool pipeHTTPResponse(HttpWorker &w, uint8_t seq, uint16_t chunkSize, uint8_t credits,
+                      int httpCode, BodySource &src, HttpTiming &t) {
+  bool chunked = binaryLink && chunkSize > 0;
+  int size = src.size();   // -1 with Transfer-Encoding: chunked
+  size_t bodyMax = binaryLink ? PIPE_BODY_MAX : PIPE_TEXT_BODY_MAX;
+  BodyPipe pipe(seq, chunked ? chunkSize : 0, chunked ? w.pipeBuf : w.bodyBuf, bodyMax, w.credit);
+  uint32_t start = millis();
+
+  // A known length over the cap fails before the download
+  if (!chunked && size > (int)bodyMax) {
+    Serial.printf("❌ Body of %d bytes, %u fit the STM32\n\n", size, (unsigned)bodyMax);
+    sendHTTPError(seq, 0, "TOO_LARGE", "body too large, ask for chunks", t);
+    return false;
+  }
+
+  if (chunked) {
+    while (xSemaphoreTake(w.credit.sem, 0) == pdTRUE) {}   // left over from this worker's last stream
+    w.credit.cancel = false;
+    w.credit.seq = seq;
+    for (uint8_t i = 0; i < credits; i++) xSemaphoreGive(w.credit.sem);
+
+    frameBegin(FRAME_HTTP_HEAD, seq);
+    framePutU16(httpCode);
+    framePutU32(size < 0 ? STREAM_LEN_UNKNOWN : (uint32_t)size);
+    frameEnd();
+  }
+
+  int bodyLen = src.writeTo(&pipe);
+  bool complete = bodyLen >= 0 && !pipe.failed;
+  if (chunked && complete) complete = pipe.sendChunk();
+  t.bodyMs = millis() - start;
+
+  if (chunked) {
+    w.credit.seq = -1;
+    uint8_t flag = complete ? 1 : 0;
+    frameBegin(FRAME_HTTP_END, seq);
+    framePut(&flag, 1);
+    framePutTiming(t);
+    frameEnd();
+  } else if (complete && binaryLink) {
+    frameBegin(FRAME_HTTP_RESPONSE, seq);
+    framePutU16(httpCode);
+    framePut(pipe.body(), pipe.sent);
+    framePutTiming(t);
+    frameEnd();
+  } else if (complete) {
+    // The lines of one response must not interleave with other replies
+    xSemaphoreTake(linkTxMutex, portMAX_DELAY);
+    STM32Serial.print("HTTP_RESPONSE:");
+    STM32Serial.println(httpCode);
+    STM32Serial.print("BODY:");
+    STM32Serial.write(pipe.body(), pipe.sent);
+    STM32Serial.println();
+    printTiming(t);
+    STM32Serial.println("HTTP_END");
+    xSemaphoreGive(linkTxMutex);
+  }
+
+  if (!complete) {
+    String why = pipe.overflow ? "body too large, ask for chunks"
+               : pipe.failed   ? "no credit from STM32"
+                               : HTTPClient::errorToString(bodyLen);
+    Serial.printf("❌ Body cut off after %d bytes: %s\n\n", (int)pipe.sent, why.c_str());
+    // A chunked transfer already ended with HTTP_END(0)
+    if (!chunked) sendHTTPError(seq, 0, pipe.overflow ? "TOO_LARGE" : "CONNECTION", why, t);
+    return false;
+  }
+
+  Serial.printf("✅ Piped %d bytes to STM32%s%s: first byte after %lu ms, done after %lu ms\n",
+                (int)pipe.sent, chunked ? " in chunks" : "", t.cached ? " from the cache" : "",
+                (unsigned long)(pipe.firstByteMs ? pipe.firstByteMs - start : 0),
+                (unsigned long)(millis() - start));
+  Serial.printf("  Free heap: %d bytes\n", ESP.getFreeHeap());
+  Serial.print("🔍 [ESP32 DEBUG] Body: ");
+  Serial.write((const uint8_t *)pipe.preview, pipe.previewLen);
+  Serial.println(pipe.sent > pipe.previewLen ? "..." : "");
+  return true;
+}
+
+// Reprogram the STM32 UART, any frame half received at the old rate is noise
+void setLinkSpeed(uint32_t baud, bool flow) {
+  xSemaphoreTake(linkTxMutex, portMAX_DELAY);
+  STM32Serial.flush();
+  if (flow) {
+    STM32Serial.setPins(STM32_RX_PIN, STM32_TX_PIN, STM32_CTS_PIN, STM32_RTS_PIN);
+  }
+  STM32Serial.setHwFlowCtrlMode(flow ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE);
+  STM32Serial.updateBaudRate(baud);
+  linkBaud = baud;
+  linkFlow = flow;
+  frameLen = 0;
+  frameOverflow = false;
+  xSemaphoreGive(linkTxMutex);
+}
+
+// Text-link timing line, inside the response just before HTTP_END
+void printTiming(const HttpTiming &t) {
+  STM32Serial.printf("HTTP_TIMING:%u,%u,%u,%u,%u\n", timingMs(t.dnsMs), timingMs(t.connectMs),
+                     timingMs(t.responseMs), timingMs(t.bodyMs), timingFlags(t));
+}
+
+// Failed request: HTTP status (0 if none) + reason + server error body, ends the STM32 wait
+void sendHTTPError(uint8_t seq, int httpCode, const String &reason, const String &body,
+                   const HttpTiming &t) {
+  size_t n = body.length();
+  if (n > HTTP_ERROR_BODY_MAX) n = HTTP_ERROR_BODY_MAX;
+
+  if (binaryLink) {
+    frameBegin(FRAME_HTTP_ERROR, seq);
+    framePutU16(httpCode > 0 ? httpCode : 0);
+    framePutStr(reason);
+    framePut((const uint8_t *)body.c_str(), n);
+    framePutTiming(t);
+    frameEnd();
+  } else if (httpCode > 0) {
+    // The text framer takes any status, a non-2xx one marks the response failed
+    xSemaphoreTake(linkTxMutex, portMAX_DELAY);
+    STM32Serial.println("HTTP_RESPONSE:" + String(httpCode));
+    STM32Serial.println("BODY:" + body.substring(0, n));
+    printTiming(t);
+    STM32Serial.println("HTTP_END");
+    xSemaphoreGive(linkTxMutex);
+  } else {
+    replyTo(seq, "ERROR:" + reason);
+  }
+}
+
+// 2xx with a projection: stream the body through it, send only the matches
+bool sendHTTPFields(HttpWorker &w, uint8_t seq, int httpCode, BodySource &src, const String &fields,
+                    HttpTiming &t) {
+  JsonProjector proj(fields.c_str(), w.fieldRecords);
+  uint32_t start = millis();
+  int bodyLen = src.writeTo(&proj);
+  t.bodyMs = millis() - start;
+  if (bodyLen < 0) {
+    String why = HTTPClient::errorToString(bodyLen);
+    Serial.printf("❌ Body read failed: %s\n\n", why.c_str());
+    sendHTTPError(seq, 0, "CONNECTION", why, t);
+    return false;
+  }
+
+  frameBegin(FRAME_HTTP_FIELDS, seq);
+  framePutU16(httpCode);
+  framePut(w.fieldRecords, proj.recordsLen);
+  framePutTiming(t);
+  frameEnd();
+
+  Serial.printf("✅ Projected %d body bytes to %d fields (%d bytes) for \"%s\"\n",
+                bodyLen, proj.count, (int)proj.recordsLen, fields.c_str());
+  if (proj.dropped > 0) {
+    Serial.printf("⚠️ %d fields too long or past the frame, dropped\n", proj.dropped);
+  }
+  return true;
+}
+
+bool checkLCDInit(uint8_t seq) {
+  if (!lcdInitialized) {
+    replyTo(seq, "ERROR:NOT_INIT");
+    Serial.println("❌ LCD not initialized!\n");
+    return false;
+  }
+  return true;
+}
+
+// ========== COMMAND HANDLERS (shared by text and binary link) ==========
+
+void doPing() {
+  reply("PONG");
+  Serial.println("✅ → PONG\n");
+}
+
+void doReset() {
+  reply("RESTARTING");
+  Serial.println("🔄 → RESTARTING");
+  delay(100);
+  ESP.restart();
+}
+
+void doLED(uint8_t seq, bool on) {
+  digitalWrite(LED_PIN, on ? HIGH : LOW);
+  replyTo(seq, "OK");
+  Serial.println(on ? "💡 LED ON → OK\n" : "💡 LED OFF → OK\n");
+}
+
+void doLEDBlink(uint8_t seq, int times) {
+  Serial.printf("💡 LED BLINK x%d\n", times);
+  for (int i = 0; i < times; i++) {
+    digitalWrite(LED_PIN, HIGH);
+    delay(200);
+    digitalWrite(LED_PIN, LOW);
+    delay(200);
+  }
+  replyTo(seq, "OK");
+  Serial.println("✅ → OK\n");
+}
+
+void doLinkSpeed(uint32_t baud, bool flow) {
+  if (baud < 9600 || baud > LINK_BAUD_MAX) {
+    reply("ERROR:BAUD");
+    Serial.printf("❌ Unsupported link rate %u\n\n", baud);
+    return;
+  }
+
+  // OK goes out at the old rate, setLinkSpeed() waits for it to leave
+  reply("OK");
+  Serial.printf("📶 LINK_SPEED %u%s → OK\n", baud, flow ? " RTS/CTS" : "");
+  linkPrevBaud = linkBaud;
+  linkPrevFlow = linkFlow;
+  setLinkSpeed(baud, flow);
+  linkProbation = (baud != LINK_BAUD_DEFAULT);
+  linkProbationStart = millis();
+}
+
+void doWiFiDisconnect() {
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  net.state = NET_OFF;   // no rejoin from here on
+  wifiReplyLocked("ERROR");
+  xSemaphoreGive(netMutex);
+  xTaskNotify(wifiTaskHandle, NET_EVT_LEAVE, eSetBits);
+  reply("OK");
+  Serial.println("📡 Disconnected → OK\n");
+}
+
+// From the state the WiFi task keeps, the radio is not asked
+void doWiFiStatus() {
+  uint8_t state = net.state;
+  const char *status = state == NET_UP  ? "CONNECTED" :
+                       state == NET_OFF ? "DISCONNECTED" : "CONNECTING";
+  reply(status);
+  Serial.printf("%s → %s\n\n", state == NET_UP ? "✅" : "❌", status);
+}
+
+void doWiFiIP() {
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  bool up = net.state == NET_UP;
+  String ip = net.localIP.toString();
+  xSemaphoreGive(netMutex);
+  if (up) {
+    reply("IP:" + ip);
+    Serial.printf("🌐 → IP:%s\n\n", ip.c_str());
+  } else {
+    reply("ERROR:NOT_CONNECTED");
+    Serial.println("❌ → ERROR:NOT_CONNECTED\n");
+  }
+}
+
+void doLCDInit(uint8_t seq) {
+  Serial.println("🖥️  Initializing LCD...");
+  lcd.init();
+  lcd.backlight();
+  lcd.clear();
+  lcdInitialized = true;
+  replyTo(seq, "OK");
+  Serial.println("✅ → LCD initialized → OK\n");
+}
+
+void doLCDClear(uint8_t seq) {
+  if (!checkLCDInit(seq)) return;
+  lcd.clear();
+  replyTo(seq, "OK");
+  Serial.println("🖥️  LCD cleared → OK\n");
+}
+
+void doLCDPrint(uint8_t seq, const char *text, size_t len) {
+  if (!checkLCDInit(seq)) return;
+  lcd.write((const uint8_t *)text, len);
+  replyTo(seq, "OK");
+  Serial.printf("🖥️  LCD print: \"%.*s\" → OK\n\n", (int)len, text);
+}
+
+void doLCDCursor(uint8_t seq, int row, int col) {
+  if (!checkLCDInit(seq)) return;
+  lcd.setCursor(col, row);
+  replyTo(seq, "OK");
+  Serial.printf("🖥️  LCD cursor: (%d,%d) → OK\n\n", row, col);
+}
+
+void doLCDBacklight(uint8_t seq, int state) {
+  if (!checkLCDInit(seq)) return;
+  if (state) {
+    lcd.backlight();
+    Serial.println("💡 LCD backlight ON");
+  } else {
+    lcd.noBacklight();
+    Serial.println("💡 LCD backlight OFF");
+  }
+  replyTo(seq, "OK");
+  Serial.println();
+}
+
+// One of HTTP_WORKERS; arg is its HttpWorker scratch
+void httpTask(void *arg) {
+  HttpWorker &w = *(HttpWorker *)arg;
+  HttpJob *job;
+  for (;;) {
+    if (xQueueReceive(httpQueue, &job, pdMS_TO_TICKS(CONN_MAINT_PERIOD)) != pdTRUE) {
+      if (&w == &httpWorkers[0] && !net.roaming) {
+        connMaintain();
+        backendProbe();
+      }
+      continue;
+    }
+    // Roaming gate: count in first, then look, so a switch that has started
+    // sees this job or this job sees the switch
+    for (;;) {
+      __atomic_add_fetch(&httpBusy, 1, __ATOMIC_SEQ_CST);
+      if (!net.roaming) break;
+      __atomic_sub_fetch(&httpBusy, 1, __ATOMIC_SEQ_CST);
+      vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    switch (job->kind) {
+      case JOB_WARM:
+        connWarm(job->host, job->port);
+        break;
+      case JOB_POST:
+        doHTTPPost(w, job->seq, job->chunkSize, job->credits, job->host, job->port, job->path,
+                   job->jsonData, job->apiKey, job->terminalId, job->fields);
+        break;
+      default:
+        doHTTPGet(w, job->seq, job->chunkSize, job->credits, job->host, job->port, job->path,
+                  job->apiKey, job->terminalId, job->fields);
+        break;
+    }
+    jobFree(job);
+    __atomic_sub_fetch(&httpBusy, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+String httpURL(const String &host, int port, const String &path) {
+  if (connUsesTLS(host, port)) return "https://" + host + path;
+  if (port == 80) return "http://" + host + path;
+  return "http://" + host + ":" + String(port) + path;
+}
+
+// Send the request on the pooled connection; a kept-alive socket the server
+// closed in the meantime is replaced once. A POST only if its headers could
+// not be written: any later error may come after the server read the body.
+int httpRequest(Conn &c, const String &url, const String &path, const String &host,
+                const String &apiKey, const String &terminalId, const String *jsonData,
+                const String &etag, HttpTiming &t) {
+  static const char *cacheHeaders[] = { "ETag", "Cache-Control" };
+  for (int attempt = 0; attempt < 2; attempt++) {
+    HTTPClient *http = connOpen(c, url, path, t);
+    if (!http) return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    // ADD AUTHENTICATION HEADERS
+    if (jsonData) http->addHeader("Content-Type", "application/json");
+    http->addHeader("x-api-key", apiKey);
+    http->addHeader("x-terminal-id", terminalId);
+    if (etag.length() > 0) http->addHeader("If-None-Match", etag);
+    http->collectHeaders(cacheHeaders, 2);
+
+    // GitHub Codespaces bypass header
+    if (host.endsWith(".app.github.dev")) {
+      http->addHeader("ngrok-skip-browser-warning", "true");
+    }
+
+    uint32_t start = millis();
+    int httpCode = jsonData ? http->POST(*jsonData) : http->GET();
+    t.responseMs = millis() - start;
+
+    bool stale = httpCode < 0 && t.reused &&
+                 (jsonData ? httpCode == HTTPC_ERROR_SEND_HEADER_FAILED : httpCode != HTTPC_ERROR_READ_TIMEOUT);
+    if (!stale || attempt > 0) return httpCode;
+
+    Serial.println("🔁 Kept-alive connection was closed by the server, reconnecting");
+    connClose(c);
+  }
+  return HTTPC_ERROR_CONNECTION_REFUSED;
+}
+
+void logHTTPTiming(const Conn &c, const HttpTiming &t, uint32_t start) {
+  Serial.printf("⏱️ [HTTP] dns %lu ms, connect %lu ms%s, request %lu ms, body %lu ms, total %lu ms "
+                "(%lu handshakes, %lu reuses on %s)\n\n",
+                (unsigned long)t.dnsMs, (unsigned long)t.connectMs, t.reused ? " (kept open)" : "",
+                (unsigned long)t.responseMs, (unsigned long)t.bodyMs, (unsigned long)(millis() - start),
+                (unsigned long)c.opened, (unsigned long)c.reused, c.host.c_str());
+}
+
+void doHTTPGet(HttpWorker &w, uint8_t seq, uint16_t chunkSize, uint8_t credits,
+               const String &host, int port, const String &path,
+               const String &apiKey, const String &terminalId, const String &fields) {
+  uint32_t start = millis();
+  HttpTiming t = {};
+  String key = cacheKey(host, path, apiKey, terminalId);
+
+  // A cached copy needs no WiFi
+  int slot;
+  uint8_t cached = cacheLookup(key, path, slot);
+  if (cached == CACHE_FRESH || cached == CACHE_STALE) {
+    Serial.printf("🗄️ [CACHE] %s copy of %s\n", cached == CACHE_FRESH ? "Fresh" : "Stale", path.c_str());
+    bool served = serveCached(w, seq, chunkSize, credits, slot, fields, t);
+    String etag = cacheEntries[slot].etag;
+    cacheRelease(slot, !served);
+    if (served) {
+      if (cached == CACHE_STALE && WiFi.status() == WL_CONNECTED) {
+        cacheRevalidate(w, host, port, path, apiKey, terminalId, etag);
+      }
+      return;
+    }
+    cached = CACHE_MISS;
+  }
+
+  if (WiFi.status() != WL_CONNECTED) {
+    if (cached == CACHE_EXPIRED) {
+      // Offline: an old copy beats no answer, the timing marks it cached
+      Serial.printf("🗄️ [CACHE] No WiFi, expired copy of %s\n", path.c_str());
+      bool served = serveCached(w, seq, chunkSize, credits, slot, fields, t);
+      cacheRelease(slot, !served);
+      if (served) return;
+    }
+    sendHTTPError(seq, 0, "NO_WIFI", "", t);
+    Serial.println("❌ Not connected to WiFi!\n");
+    return;
+  }
+  
+  String url = httpURL(host, port, path);
+  
+  Serial.println("🌐 HTTP GET Request:");
+  Serial.printf("  URL: %s\n", url.c_str());
+  Serial.printf("  API Key: %s\n", apiKey.c_str());
+  Serial.printf("  Terminal ID: %s\n", terminalId.c_str());
+  
+  Conn *c;
+  String etag = cached == CACHE_EXPIRED ? cacheEntries[slot].etag : String();
+  int httpCode = backendRequest(c, host, port, path, apiKey, terminalId, NULL, etag, t);
+  Serial.printf("  Response Code: %d\n", httpCode);
+  
+  bool clean = false;   // body read to the end, the socket can serve the next request
+  if (httpCode == HTTP_CODE_NOT_MODIFIED && cached == CACHE_EXPIRED) {
+    // The old copy is still current
+    cacheTouch(key);
+    clean = true;
+    if (!serveCached(w, seq, chunkSize, credits, slot, fields, t)) {
+      sendHTTPError(seq, 0, "CACHE", "", t);
+    }
+  } else if (httpCode >= 200 && httpCode < 300) {
+    File copy;
+    BodySource src = { c->http, NULL, NULL, false };
+    String tmp = cacheTempPath(w);
+    if (cached != CACHE_OFF && httpCode == HTTP_CODE_OK && cacheStorable(*c->http)) {
+      copy = LittleFS.open(tmp, FILE_WRITE);
+      if (copy) src.copy = &copy;
+    }
+    if (fields.length() > 0) {
+      clean = sendHTTPFields(w, seq, httpCode, src, fields, t);
+    } else {
+      clean = pipeHTTPResponse(w, seq, chunkSize, credits, httpCode, src, t);
+    }
+    if (src.copy) {
+      copy.close();
+      if (cached == CACHE_EXPIRED) cacheRelease(slot, false);
+      cached = CACHE_OFF;   // slot released
+      if (clean && src.copied) {
+        cacheStore(key, c->http->header("ETag"), tmp);
+      } else {
+        LittleFS.remove(tmp);
+      }
+    }
+  } else if (httpCode > 0) {
+    uint32_t bodyStart = millis();
+    String payload = c->http->getString();
+    t.bodyMs = millis() - bodyStart;
+    Serial.printf("❌ HTTP Error: %d (%d byte body)\n\n", httpCode, payload.length());
+    sendHTTPError(seq, httpCode, "HTTP_" + String(httpCode), payload, t);
+    clean = true;
+  } else if (cached == CACHE_EXPIRED && serveCached(w, seq, chunkSize, credits, slot, fields, t)) {
+    Serial.printf("🗄️ [CACHE] Backend unreachable, answered the expired copy of %s\n", path.c_str());
+  } else {
+    String why = t.error ? String(t.error) : HTTPClient::errorToString(httpCode);
+    Serial.printf("❌ Connection failed: %s\n\n", why.c_str());
+    sendHTTPError(seq, 0, "CONNECTION", why, t);
+  }
+  if (cached == CACHE_EXPIRED) cacheRelease(slot, false);
+  
+  connDone(*c, clean);
+  logHTTPTiming(*c, t, start);
+  connRelease(*c);
+  statsRecord(path, t, millis() - start, httpCode, clean);
+}
+
+void doHTTPPost(HttpWorker &w, uint8_t seq, uint16_t chunkSize, uint8_t credits,
+                const String &host, int port, const String &path, const String &jsonData,
+                const String &apiKey, const String &terminalId, const String &fields) {
+  uint32_t start = millis();
+  HttpTiming t = {};
+  if (WiFi.status() != WL_CONNECTED) {
+    sendHTTPError(seq, 0, "NO_WIFI", "", t);
+    Serial.println("❌ Not connected to WiFi!\n");
+    return;
+  }
+  
+  Serial.println("🔍 [DEBUG] WiFi check passed");
+  
+  Serial.printf("  Host: %s\n", host.c_str());
+  Serial.printf("  Port: %d\n", port);
+  Serial.printf("  Path: %s\n", path.c_str());
+  Serial.printf("  JSON Length: %d bytes\n", jsonData.length());
+  Serial.printf("  API Key: %s\n", apiKey.c_str());
+  Serial.printf("  Terminal ID: %s\n", terminalId.c_str());
+  
+  bool tls = connUsesTLS(host, port);
+  String url = httpURL(host, port, path);
+  if (tls) Serial.println("🔍 [DEBUG] Using HTTPS");
+  
+  Serial.println("🌐 HTTP POST Request:");
+  Serial.printf("  URL: %s\n", url.c_str());
+  
+  if (jsonData.length() > 200) {
+    Serial.print("  Data Preview: ");
+    Serial.print(jsonData.substring(0, 100));
+    Serial.println("...");
+  } else {
+    Serial.printf("  Data: %s\n", jsonData.c_str());
   }
   
-  // Parse parameters
-  int comma1 = cmd.indexOf(',');
-  int comma2 = cmd.indexOf(',', comma1 + 1);
-  int comma3 = cmd.indexOf(',', comma2 + 1);
-  int comma4 = cmd.indexOf(',', comma3 + 1);
-  int comma5 = cmd.indexOf(',', comma4 + 1);
+  Serial.println("🔍 [DEBUG] Calling http.POST()...");
+  Serial.printf("  Free heap before POST: %d bytes\n", ESP.getFreeHeap());
+  
+  Conn *c;
+  int httpCode = backendRequest(c, host, port, path, apiKey, terminalId, &jsonData, String(), t);
+  
+  Serial.printf("🔍 [DEBUG] POST returned! Code: %d\n", httpCode);
   
-  String host = cmd.substring(comma1 + 1, comma2);
-  int port = cmd.substring(comma2 + 1, comma3).toInt();
-  String path = cmd.substring(comma3 + 1, comma4);
-  String apiKey = cmd.substring(comma4 + 1, comma5);
-  String terminalId = cmd.substring(comma5 + 1);
+  bool clean = false;
+  BodySource src = { c->http, NULL, NULL, false };
+  if (httpCode >= 200 && httpCode < 300 && fields.length() > 0) {
+    clean = sendHTTPFields(w, seq, httpCode, src, fields, t);
+  } else if (httpCode > 0) {
+    if (httpCode >= 200 && httpCode < 300) {
+      // This matches doHTTPGet behavior
+      clean = pipeHTTPResponse(w, seq, chunkSize, credits, httpCode, src, t);
+    } else {
+      uint32_t bodyStart = millis();
+      String payload = c->http->getString();
+      t.bodyMs = millis() - bodyStart;
+      Serial.printf("❌ HTTP Error: %d (%d byte body)\n\n", httpCode, payload.length());
+      sendHTTPError(seq, httpCode, "HTTP_" + String(httpCode), payload, t);
+      clean = true;
+    }
+  } else {
+    String why = t.error ? String(t.error) : HTTPClient::errorToString(httpCode);
+    Serial.printf("❌ Connection failed: %s\n\n", why.c_str());
+    sendHTTPError(seq, 0, "CONNECTION", why, t);
+  }
   
-  // Build URL
-  String url;
-  if (host.endsWith(".app.github.dev") || port == 443) {
-    url = "https://" + host + path;
-  } else if (port == 80) {
-    url = "http://" + host + path;
+  connDone(*c, clean);
+  logHTTPTiming(*c, t, start);
+  connRelease(*c);
+  statsRecord(path, t, millis() - start, httpCode, clean);
+  Serial.println("🔍 [DEBUG] doHTTPPost completed");
+}
+
+// ========== CONNECTION POOL FUNCTIONS ==========
+
+bool connUsesTLS(const String &host, int port) {
+  return host.endsWith(".app.github.dev") || port == 443;
+}
+
+uint32_t connAge(const Conn &c) {
+  return c.host.length() > 0 ? millis() - c.lastUsed : UINT32_MAX;
+}
+
+// Claim a slot for host:port: an idle one already on that host (open socket
+// first), else a free or the least recently used idle one. Waits while every
+// slot is busy, or while this host's connection is being warmed up.
+Conn *connAcquire(const String &host, uint16_t port, bool tls, bool warm) {
+  for (;;) {
+    xSemaphoreTake(connMutex, portMAX_DELAY);
+    Conn *pick = NULL;
+    bool warming = false;
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+      Conn &c = connPool[i];
+      if (!(c.host == host && c.port == port && c.tls == tls)) continue;
+      if (c.busy) {
+        warming |= c.warming;
+      } else if (!pick || (c.client->connected() && !pick->client->connected())) {
+        pick = &c;
+      }
+    }
+    if (!pick && !warming) {
+      for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        Conn &c = connPool[i];
+        if (!c.busy && (!pick || connAge(c) > connAge(*pick))) pick = &c;
+      }
+      if (pick) connTakeOver(*pick, host, port, tls);
+    }
+    if (pick) {
+      pick->busy = true;
+      pick->warming = warm;
+    }
+    xSemaphoreGive(connMutex);
+    if (pick) return pick;
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+void connRelease(Conn &c) {
+  xSemaphoreTake(connMutex, portMAX_DELAY);
+  c.busy = false;
+  c.warming = false;
+  xSemaphoreGive(connMutex);
+}
+
+// Point a slot at a new host, its socket (and TLS state) starts over
+void connTakeOver(Conn &c, const String &host, uint16_t port, bool tls) {
+  connClose(c);
+  if (c.client && c.tls != tls) {
+    delete c.client;
+    c.client = NULL;
+  }
+  if (!c.client) {
+    if (tls) {
+      WiFiClientSecure *secure = new WiFiClientSecure;
+      secure->setInsecure();
+      c.client = secure;
+    } else {
+      c.client = new WiFiClient;
+    }
+  }
+  c.host = host;
+  c.port = port;
+  c.tls = tls;
+  c.resolved = false;
+  c.failedAt = 0;
+  c.opened = 0;
+  c.reused = 0;
+  c.lastUsed = millis();
+}
+
+void connClose(Conn &c) {
+  if (c.http) {
+    delete c.http;
+    c.http = NULL;
+  }
+  if (c.client) c.client->stop();
+}
+
+// New socket: DNS from the cache, then TCP (+ TLS with SNI for the host name)
+bool connConnect(Conn &c, HttpTiming &t) {
+  connClose(c);
+
+  uint32_t start = millis();
+  if (!c.resolved || millis() - c.resolvedAt > DNS_CACHE_TTL) {
+    if (!WiFi.hostByName(c.host.c_str(), c.ip)) {
+      c.resolved = false;
+      c.failedAt = millis();
+      t.error = "DNS lookup failed";
+      return false;
+    }
+    c.resolved = true;
+    c.resolvedAt = millis();
+  }
+  t.dnsMs = millis() - start;
+
+  start = millis();
+  bool ok = c.tls ? ((WiFiClientSecure *)c.client)->connect(c.ip, c.port, c.host.c_str(), NULL, NULL, NULL)
+                  : c.client->connect(c.ip, c.port);
+  t.connectMs = millis() - start;
+  if (!ok) {
+    c.resolved = false;   // the address may have moved
+    c.failedAt = millis();
+    t.error = c.tls ? "TLS connect failed" : "TCP connect failed";
+    return false;
+  }
+  c.opened++;
+  c.failedAt = 0;
+  return true;
+}
+
+// HTTPClient for url, on the open socket if the server kept it
+HTTPClient *connOpen(Conn &c, const String &url, const String &path, HttpTiming &t) {
+  t.dnsMs = 0;
+  t.connectMs = 0;
+  t.responseMs = 0;
+  t.bodyMs = 0;
+  t.tls = c.tls;
+  t.error = NULL;
+  // setURL() swaps the path only, anything else needs a fresh begin()
+  t.reused = c.client->connected() && path.startsWith("/");
+  if (!t.reused && !connConnect(c, t)) return NULL;
+  if (t.reused) c.reused++;
+  c.lastUsed = millis();
+
+  if (c.http) {
+    c.http->setURL(path);
+    return c.http;
+  }
+  // begin() on a socket that is already connected: HTTPClient uses it as is
+  c.http = new HTTPClient;
+  c.http->setReuse(true);
+  c.http->setTimeout(HTTP_TIMEOUT);
+  c.http->begin(*c.client, url);
+  return c.http;
+}
+
+// After the response: keep the socket unless part of the body is still unread
+void connDone(Conn &c, bool clean) {
+  if (!c.http) return;
+  if (clean) {
+    c.http->end();
+  } else {
+    connClose(c);
+  }
+  c.lastUsed = millis();
+}
+
+// HTTP_WARM: the pool belongs to the HTTP workers, the link task just queues it
+void queueWarm(const String &host, int port) {
+  HttpJob *job = jobAlloc();
+  if (!job) return;   // the queue is full, those requests open the connection themselves
+  job->kind = JOB_WARM;
+  job->host = host;
+  job->port = port;
+  if (xQueueSend(httpQueue, &job, 0) != pdTRUE) {
+    jobFree(job);   // a request is queued anyway, it opens the connection itself
+  }
+  Serial.printf("🔥 [CONN] Warm-up of %s:%d queued\n\n", host.c_str(), port);
+}
+
+void connWarm(const String &requested, int requestedPort) {
+  if (WiFi.status() != WL_CONNECTED) return;
+  String host = requested;
+  int port = requestedPort;
+  backendPick(requested, requestedPort, 0, true, host, port);   // where the next request goes
+  bool tls = connUsesTLS(host, port);
+  uint16_t connPort = tls ? 443 : port;
+
+  // Nothing to do if a request is on it already or the socket is open
+  xSemaphoreTake(connMutex, portMAX_DELAY);
+  bool covered = false;
+  for (int i = 0; i < CONN_POOL_SIZE; i++) {
+    Conn &c = connPool[i];
+    if (c.host == host && c.port == connPort && c.tls == tls) {
+      c.lastUsed = millis();   // starts the re-warm window
+      covered |= c.busy || c.client->connected();
+    }
+  }
+  xSemaphoreGive(connMutex);
+  if (covered) {
+    Serial.printf("🔥 [CONN] %s already open\n\n", host.c_str());
+    return;
+  }
+
+  Conn *c = connAcquire(host, connPort, tls, true);
+  c->lastUsed = millis();
+  if (!c->client->connected()) {
+    HttpTiming t = {};
+    if (connConnect(*c, t)) {
+      Serial.printf("🔥 [CONN] Opened %s:%u (dns %lu ms, connect %lu ms)\n\n", host.c_str(), c->port,
+                    (unsigned long)t.dnsMs, (unsigned long)t.connectMs);
+    } else {
+      Serial.printf("❌ [CONN] Warm-up of %s failed: %s\n\n", host.c_str(), t.error);
+    }
+  }
+  connRelease(*c);
+}
+
+// Between jobs: re-open what the server dropped during a session, free what
+// nobody used for a while. Slots in use by a request are left alone.
+void connMaintain() {
+  if (WiFi.status() != WL_CONNECTED) return;
+  for (int i = 0; i < CONN_POOL_SIZE; i++) {
+    Conn &c = connPool[i];
+    xSemaphoreTake(connMutex, portMAX_DELAY);
+    if (c.busy || c.host.length() == 0) {
+      xSemaphoreGive(connMutex);
+      continue;
+    }
+    uint32_t idle = millis() - c.lastUsed;
+
+    if (idle > CONN_IDLE_CLOSE) {
+      Serial.printf("🔌 [CONN] Closing idle %s (%lu handshakes, %lu reuses)\n\n", c.host.c_str(),
+                    (unsigned long)c.opened, (unsigned long)c.reused);
+      connClose(c);
+      delete c.client;
+      c.client = NULL;
+      c.host = "";
+      xSemaphoreGive(connMutex);
+      continue;
+    }
+
+    bool rewarm = idle < CONN_REWARM_WINDOW && !c.client->connected() &&
+                  (c.failedAt == 0 || millis() - c.failedAt > CONN_RETRY_DELAY);
+    if (rewarm) {
+      c.busy = true;
+      c.warming = true;
+    }
+    xSemaphoreGive(connMutex);
+    if (!rewarm) continue;
+
+    HttpTiming t = {};
+    if (connConnect(c, t)) {
+      Serial.printf("🔥 [CONN] Re-opened %s (dns %lu ms, connect %lu ms)\n\n", c.host.c_str(),
+                    (unsigned long)t.dnsMs, (unsigned long)t.connectMs);
+    }
+    connRelease(c);
+  }
+}
+
+// ========== BACKEND FUNCTIONS ==========
+
+void backendBegin() {
+  backendPrefs.begin("backends", false);
+  for (int i = 0; i < BACKENDS; i++) {
+    char key[8];
+    snprintf(key, sizeof(key), "host%d", i);
+    backends[i].host = backendPrefs.getString(key, "");
+    snprintf(key, sizeof(key), "port%d", i);
+    backends[i].port = backendPrefs.getUInt(key, 443);
+  }
+}
+
+// HTTP_BACKEND: endpoint of a slot, host "" frees it
+void doHTTPBackend(int slot, const String &host, uint16_t port) {
+  if (slot < 0 || slot >= BACKENDS) {
+    reply("ERROR:SLOT");
+    Serial.println("❌ → ERROR:SLOT\n");
+    return;
+  }
+  xSemaphoreTake(backendMutex, portMAX_DELAY);
+  Backend &b = backends[slot];
+  if (b.host != host || b.port != port) {
+    // Sent every STM32 boot, flash only written on change
+    b = Backend();
+    b.host = host;
+    b.port = port;
+    char key[8];
+    snprintf(key, sizeof(key), "host%d", slot);
+    backendPrefs.putString(key, host);
+    snprintf(key, sizeof(key), "port%d", slot);
+    backendPrefs.putUInt(key, port);
+  }
+  xSemaphoreGive(backendMutex);
+  reply("OK");
+  Serial.printf("🌐 Backend %d: %s:%u → OK\n\n", slot, host.length() > 0 ? host.c_str() : "(none)", port);
+}
+
+// Slot of host:port among the backends, -1 if it is none of them (backendMutex held)
+int backendSlotLocked(const String &host, int port) {
+  for (int i = 0; i < BACKENDS; i++) {
+    if (backends[i].host.length() > 0 && backends[i].host == host && backends[i].port == port) return i;
+  }
+  return -1;
+}
+
+// Backend for the next try of a request to host:port, tried = slots that
+// failed it already. Sets toHost/toPort and returns the slot, or -1 if host
+// is no backend or nothing is left to fail over to. trial: the request may
+// go to a backend on trial (see BACKENDS).
+int backendPick(const String &host, int port, uint8_t tried, bool trial, String &toHost, int &toPort) {
+  xSemaphoreTake(backendMutex, portMAX_DELAY);
+  int best = -1;
+  if (backendSlotLocked(host, port) >= 0) {
+    uint32_t bestScore = UINT32_MAX;
+    for (int i = 0; i < BACKENDS; i++) {
+      const Backend &b = backends[i];
+      if (b.host.length() == 0 || b.down || (tried & (1 << i))) continue;
+      // Not measured yet: as fast as slot 0, so the order decides
+      uint32_t score = (b.latencyMs ? b.latencyMs : backends[0].latencyMs) + i * BACKEND_ORDER_BIAS;
+      if (b.strikes > 0 && !trial) score += BACKEND_TRIAL_BIAS;
+      if (score < bestScore) {
+        best = i;
+        bestScore = score;
+      }
+    }
+    // All down: the one whose probe is due first, the request probes it
+    for (int i = 0; i < BACKENDS && best < 0 && tried == 0; i++) {
+      if (backends[i].host.length() > 0 && (best < 0 || (int32_t)(backends[i].probeAt - backends[best].probeAt) < 0)) {
+        best = i;
+      }
+    }
+  }
+  if (best >= 0) {
+    toHost = backends[best].host;
+    toPort = backends[best].port;
+  }
+  xSemaphoreGive(backendMutex);
+  return best;
+}
+
+// Out of rotation until a probe gets through, later each time (backendMutex held)
+void backendDownLocked(Backend &b) {
+  b.down = true;
+  if (b.strikes < 8) b.strikes++;
+  uint32_t wait = (uint32_t)BACKEND_PROBE_MIN << (b.strikes - 1);
+  b.probeAt = millis() + (wait > BACKEND_PROBE_MAX ? BACKEND_PROBE_MAX : wait);
+}
+
+// Send the request to host:port, or to the best backend if host is one of
+// them, failing over while that is safe. c is the connection of the last
+// try, held for the caller as with connAcquire().
+int backendRequest(Conn *&c, const String &host, int port, const String &path,
+                   const String &apiKey, const String &terminalId, const String *jsonData,
+                   const String &etag, HttpTiming &t) {
+  uint8_t tried = 0;
+  String toHost = host;
+  int toPort = port;
+  int slot = backendPick(host, port, tried, !jsonData, toHost, toPort);
+  if (toHost != host) Serial.printf("🔀 [BACKEND] Using %s\n", toHost.c_str());
+
+  for (;;) {
+    bool tls = connUsesTLS(toHost, toPort);
+    c = connAcquire(toHost, tls ? 443 : toPort, tls, false);
+    int httpCode = httpRequest(*c, httpURL(toHost, toPort, path), path, toHost, apiKey, terminalId,
+                               jsonData, etag, t);
+    if (slot < 0) return httpCode;
+
+    // A read timeout is a slow answer, not a dead backend: it neither takes
+    // the backend out nor goes into its latency
+    bool down = (httpCode < 0 && httpCode != HTTPC_ERROR_READ_TIMEOUT) || httpCode == HTTP_CODE_BAD_GATEWAY ||
+                httpCode == HTTP_CODE_SERVICE_UNAVAILABLE || httpCode == HTTP_CODE_GATEWAY_TIMEOUT;
+    xSemaphoreTake(backendMutex, portMAX_DELAY);
+    Backend &b = backends[slot];
+    b.requests++;
+    if (httpCode == HTTPC_ERROR_READ_TIMEOUT) {
+      // counted, nothing learnt
+    } else if (!down) {
+      b.strikes = 0;
+      b.latencyMs = b.latencyMs == 0 ? t.responseMs : (b.latencyMs * 3 + t.responseMs) / 4;
+    } else {
+      backendDownLocked(b);
+    }
+    xSemaphoreGive(backendMutex);
+    if (!down) return httpCode;
+
+    // Again elsewhere only if it cannot have been acted on: a GET, or a POST
+    // whose connection or headers never got through (any later error may
+    // come after the backend read the body). Not after a read timeout, the
+    // STM32 gave up by then.
+    bool repeatable = jsonData ? (t.error || httpCode == HTTPC_ERROR_SEND_HEADER_FAILED)
+                               : httpCode != HTTPC_ERROR_READ_TIMEOUT;
+    if (!repeatable) return httpCode;
+    tried |= 1 << slot;
+    String nextHost;
+    int nextPort;
+    int next = backendPick(host, port, tried, !jsonData, nextHost, nextPort);
+    if (next < 0) return httpCode;
+
+    Serial.printf("🔀 [BACKEND] %s failed (%d), trying %s\n", toHost.c_str(), httpCode, nextHost.c_str());
+    xSemaphoreTake(backendMutex, portMAX_DELAY);
+    backends[slot].failovers++;
+    xSemaphoreGive(backendMutex);
+    connDone(*c, false);
+    connRelease(*c);
+    slot = next;
+    toHost = nextHost;
+    toPort = nextPort;
+  }
+}
+
+// Idle worker: a bare connect to each down backend whose probe is due
+void backendProbe() {
+  if (WiFi.status() != WL_CONNECTED) return;
+  for (int i = 0; i < BACKENDS; i++) {
+    xSemaphoreTake(backendMutex, portMAX_DELAY);
+    bool due = backends[i].host.length() > 0 && backends[i].down &&
+               (int32_t)(millis() - backends[i].probeAt) >= 0;
+    String host = backends[i].host;
+    uint16_t port = backends[i].port;
+    xSemaphoreGive(backendMutex);
+    if (!due) continue;
+
+    bool tls = connUsesTLS(host, port);
+    Conn *c = connAcquire(host, tls ? 443 : port, tls, true);
+    HttpTiming t = {};
+    bool up = c->client->connected() || connConnect(*c, t);
+    connRelease(*c);
+
+    xSemaphoreTake(backendMutex, portMAX_DELAY);
+    Backend &b = backends[i];
+    if (b.host == host) {
+      if (up) {
+        b.down = false;   // on trial until a request succeeds
+      } else {
+        backendDownLocked(b);
+      }
+    }
+    xSemaphoreGive(backendMutex);
+    if (up) {
+      Serial.printf("✅ [BACKEND] %s reachable again (connect %lu ms)\n\n", host.c_str(),
+                    (unsigned long)t.connectMs);
+    } else {
+      Serial.printf("⚠️ [BACKEND] %s still down: %s\n\n", host.c_str(), t.error);
+    }
+  }
+}
+
+// ========== LATENCY STATS FUNCTIONS ==========
+
+// Slot for a request path, claimed on first use
+// An ID or hash in a path (/receipt/<election>/<voter hash>): digits in a
+// segment longer than a version tag, or a long one
+bool statsIdSegment(const String &seg) {
+  if (seg.length() >= 24) return true;
+  if (seg.length() <= 3) return false;   // v1
+  for (size_t i = 0; i < seg.length(); i++) {
+    if (isdigit((unsigned char)seg[i])) return true;
+  }
+  return false;
+}
+
+// Path without the query and with ID segments as ":id", so one endpoint is
+// one slot and no voter data ends up in a stats name
+String statsPathName(const String &path) {
+  int end = path.indexOf('?');
+  if (end < 0) end = path.length();
+  String name;
+  int start = 0;
+  while (start < end) {
+    int slash = path.indexOf('/', start + 1);
+    if (slash < 0 || slash > end) slash = end;
+    String seg = path.substring(start, slash);   // with its leading '/'
+    name += statsIdSegment(seg.substring(1)) ? String("/:id") : seg;
+    start = slash;
+  }
+  return name;
+}
+
+EndpointStats &statsEndpoint(const String &path) {
+  String name = statsPathName(path);
+  if (name.length() > STATS_NAME_MAX) name = name.substring(name.length() - STATS_NAME_MAX);
+
+  for (int i = 0; i < endpointCount; i++) {
+    if (name == endpointStats[i].name) return endpointStats[i];
+  }
+  if (endpointCount == STATS_ENDPOINTS) {
+    return endpointStats[STATS_ENDPOINTS - 1];
+  }
+  EndpointStats &e = endpointStats[endpointCount++];
+  memset(&e, 0, sizeof(e));
+  strcpy(e.name, endpointCount == STATS_ENDPOINTS ? "*" : name.c_str());
+  return e;
+}
+
+void histAdd(LatencyHist &h, uint32_t ms) {
+  int b = 0;
+  while (b < STATS_BUCKETS - 1 && ms > statsBounds[b]) b++;
+  h.counts[b]++;
+  if (ms > h.maxMs) h.maxMs = ms;
+}
+
+// Bucket bound the pct-th percentile falls in, capped at the slowest sample
+uint16_t histPercentile(const LatencyHist &h, uint32_t samples, uint8_t pct) {
+  if (samples == 0) return 0;
+  uint32_t rank = (samples * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    seen += h.counts[b];
+    if (seen >= rank) return timingMs(statsBounds[b] < h.maxMs ? statsBounds[b] : h.maxMs);
+  }
+  return timingMs(h.maxMs);
+}
+
+// Called by the HTTP workers once a request is answered (or has failed)
+void statsRecord(const String &path, const HttpTiming &t, uint32_t totalMs, int httpCode, bool clean) {
+  xSemaphoreTake(statsMutex, portMAX_DELAY);
+  EndpointStats &e = statsEndpoint(path);
+  if (httpCode <= 0 || !clean) {
+    e.errors++;
+  }
+  if (httpCode > 0) {
+    // Only requests that got an answer say something about the backend
+    e.samples++;
+    if (t.reused) e.reused++;
+    histAdd(e.total, totalMs);
+    histAdd(e.request, t.responseMs);
+    e.dnsSum += t.dnsMs;
+    e.connectSum += t.connectMs;
+    e.bodySum += t.bodyMs;
+  }
+  xSemaphoreGive(statsMutex);
+  if (httpCode > 0 && !t.cached) wifiNoteRtt(t.responseMs);   // roaming score of this network
+}
+
+// STATS: one endpoint per reply. Binary: STATS_REPLY, text:
+// STATS:<endpoints>,<name>,<samples>,<errors>,<reused>,<p50>,<p95>,<p99>,
+//       <request p50>,<p95>,<p99>,<avg dns>,<avg connect>,<avg body>
+// An index past the last endpoint only carries the endpoint count.
+void sendStats(uint8_t index) {
+  uint16_t v[12] = {};
+  char name[STATS_NAME_MAX + 1] = "";
+
+  xSemaphoreTake(statsMutex, portMAX_DELAY);
+  uint8_t count = endpointCount;
+  if (index < count) {
+    const EndpointStats &e = endpointStats[index];
+    uint32_t n = e.samples ? e.samples : 1;
+    strcpy(name, e.name);
+    v[0] = timingMs(e.samples);
+    v[1] = timingMs(e.errors);
+    v[2] = timingMs(e.reused);
+    v[3] = histPercentile(e.total, e.samples, 50);
+    v[4] = histPercentile(e.total, e.samples, 95);
+    v[5] = histPercentile(e.total, e.samples, 99);
+    v[6] = histPercentile(e.request, e.samples, 50);
+    v[7] = histPercentile(e.request, e.samples, 95);
+    v[8] = histPercentile(e.request, e.samples, 99);
+    v[9] = timingMs(e.dnsSum / n);
+    v[10] = timingMs(e.connectSum / n);
+    v[11] = timingMs(e.bodySum / n);
+  }
+  xSemaphoreGive(statsMutex);
+
+  if (binaryLink) {
+    frameBegin(FRAME_STATS_REPLY, curSeq);
+    framePut(&count, 1);
+    framePutStr(name);
+    for (int i = 0; i < 12; i++) framePutU16(v[i]);
+    frameEnd();
   } else {
-    url = "http://" + host + ":" + String(port) + path;
+    char line[128];
+    snprintf(line, sizeof(line), "STATS:%u,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u", count, name,
+             v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8], v[9], v[10], v[11]);
+    reply(line);
   }
-  
-  Serial.println("🌐 HTTP GET Request:");
-  Serial.printf("  URL: %s\n", url.c_str());
-  Serial.printf("  API Key: %s\n", apiKey.c_str());
-  Serial.printf("  Terminal ID: %s\n", terminalId.c_str());
-  
-  HTTPClient http;
-  http.setTimeout(HTTP_TIMEOUT);
-  
-  // HTTPS support
-  if (url.startsWith("https://")) {
-    WiFiClientSecure *client = new WiFiClientSecure;
-    client->setInsecure();
-    http.begin(*client, url);
+  Serial.printf("📊 [STATS] %u/%u %s: %u requests, p50 %u ms, p95 %u ms, p99 %u ms (request p95 %u ms)\n\n",
+                index, count, name, v[0], v[3], v[4], v[5], v[7]);
+}
+
+// ========== RESPONSE CACHE FUNCTIONS ==========
+
+// host + path + hash of the credentials: a copy is only answered to the
+// terminal and key it was fetched for, and the key itself stays out of flash
+String cacheKey(const String &host, const String &path, const String &apiKey, const String &terminalId) {
+  uint32_t h = 2166136261u;   // FNV-1a
+  String creds = apiKey + "\n" + terminalId;
+  for (size_t i = 0; i < creds.length(); i++) h = (h ^ (uint8_t)creds[i]) * 16777619u;
+  char tag[10];
+  snprintf(tag, sizeof(tag), "#%08lx", (unsigned long)h);
+  return host + path + tag;
+}
+
+String cacheFilePath(int slot) {
+  return String(CACHE_DIR "/e") + String(slot);
+}
+
+// Each worker downloads into its own file, adopted by cacheStore()
+String cacheTempPath(HttpWorker &w) {
+  return String(CACHE_DIR "/w") + String((int)(&w - httpWorkers)) + ".tmp";
+}
+
+void cacheBegin() {
+  cacheReady = LittleFS.begin(true);
+  if (!cacheReady) {
+    Serial.println("⚠️ [CACHE] LittleFS mount failed, responses are not cached\n");
+    return;
+  }
+  LittleFS.mkdir(CACHE_DIR);
+
+  // Index lines: R <ttl ms> <path> and E <slot> <etag> <key>, tab separated
+  File f = LittleFS.open(CACHE_INDEX, FILE_READ);
+  if (!f) return;
+  int rules = 0, entries = 0;
+  while (f.available()) {
+    String line = f.readStringUntil('\n');
+    int a = line.indexOf('\t');
+    int b = line.indexOf('\t', a + 1);
+    if (a < 0 || b < 0) continue;
+
+    if (line.startsWith("R\t") && rules < CACHE_RULES) {
+      cacheRules[rules].ttlMs = line.substring(a + 1, b).toInt();
+      cacheRules[rules].path = line.substring(b + 1);
+      rules++;
+    } else if (line.startsWith("E\t")) {
+      int slot = line.substring(a + 1, b).toInt();
+      int c = line.indexOf('\t', b + 1);
+      if (c < 0 || slot < 0 || slot >= CACHE_ENTRIES || !LittleFS.exists(cacheFilePath(slot))) continue;
+      CacheEntry &e = cacheEntries[slot];
+      e.etag = line.substring(b + 1, c);
+      e.key = line.substring(c + 1);
+      e.aged = true;
+      entries++;
+    }
+  }
+  f.close();
+  Serial.printf("🗄️ [CACHE] %d rules, %d cached responses from flash\n", rules, entries);
+}
+
+// Rewrite the index (cacheMutex held)
+void cacheSave() {
+  File f = LittleFS.open(CACHE_INDEX, FILE_WRITE);
+  if (!f) return;
+  for (int i = 0; i < CACHE_RULES; i++) {
+    const CacheRule &r = cacheRules[i];
+    if (r.path.length() > 0) f.printf("R\t%lu\t%s\n", (unsigned long)r.ttlMs, r.path.c_str());
+  }
+  for (int i = 0; i < CACHE_ENTRIES; i++) {
+    const CacheEntry &e = cacheEntries[i];
+    if (e.key.length() > 0) f.printf("E\t%d\t%s\t%s\n", i, e.etag.c_str(), e.key.c_str());
+  }
+  f.close();
+}
+
+// HTTP_CACHE: GETs on paths starting with path are cached for ttlS seconds
+void doHTTPCache(const String &path, uint32_t ttlS) {
+  if (!cacheReady || path.length() == 0) return;
+  uint32_t ttlMs = ttlS * 1000;
+
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  CacheRule *rule = NULL;
+  for (int i = 0; i < CACHE_RULES && !rule; i++) {
+    if (cacheRules[i].path == path) rule = &cacheRules[i];
+  }
+  for (int i = 0; i < CACHE_RULES && !rule && ttlMs > 0; i++) {
+    if (cacheRules[i].path.length() == 0) rule = &cacheRules[i];
+  }
+  bool changed = rule && (rule->path != path || rule->ttlMs != ttlMs);
+  if (changed) {
+    // Sent on every STM32 boot, the flash is only written when a rule changes
+    rule->path = ttlMs > 0 ? path : String();
+    rule->ttlMs = ttlMs;
+    cacheSave();
+  }
+  xSemaphoreGive(cacheMutex);
+
+  if (!rule && ttlMs > 0) {
+    Serial.printf("⚠️ [CACHE] No room for a rule on %s\n\n", path.c_str());
   } else {
-    http.begin(url);
+    Serial.printf("🗄️ [CACHE] %s: %lu s\n\n", path.c_str(), (unsigned long)ttlS);
   }
-  
-  // ADD AUTHENTICATION HEADERS
-  http.addHeader("x-api-key", apiKey);
-  http.addHeader("x-terminal-id", terminalId);
-  
-  // GitHub Codespaces bypass header
-  if (host.endsWith(".app.github.dev")) {
-    http.addHeader("ngrok-skip-browser-warning", "true");
+}
+
+// How key stands in the cache. Unless CACHE_OFF/MISS, slot is held for the
+// caller until cacheRelease().
+uint8_t cacheLookup(const String &key, const String &path, int &slot) {
+  slot = -1;
+  if (!cacheReady) return CACHE_OFF;
+
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  uint32_t ttl = 0;
+  for (int i = 0; i < CACHE_RULES && ttl == 0; i++) {
+    const CacheRule &r = cacheRules[i];
+    if (r.path.length() > 0 && path.startsWith(r.path)) ttl = r.ttlMs;
   }
-  
-  int httpCode = http.GET();
-  Serial.printf("  Response Code: %d\n", httpCode);
-  
-  if (httpCode > 0) {
-    if (httpCode == HTTP_CODE_OK) {
-      String payload = http.getString();
-      Serial.printf("  Payload Length: %d bytes\n", payload.length());
-      
-      // ✅ Send response to STM32 ALL AT ONCE (no chunking!)
-      STM32Serial.println("HTTP_RESPONSE:" + String(httpCode));
-      STM32Serial.println("BODY:" + payload);
-      STM32Serial.println("HTTP_END");
-      
-      Serial.printf("✅ Response sent to STM32 (%d bytes)\n\n", payload.length());
-      
-      // ✅ DEBUG: Show exact response
-      Serial.println("🔍 [ESP32 DEBUG] Exact response sent:");
-      Serial.println("─────────────────────────────────────");
-      Serial.print("HTTP_RESPONSE:");
-      Serial.println(httpCode);
-      Serial.print("BODY:");
-      Serial.println(payload);
-      Serial.println("HTTP_END");
-      Serial.println("─────────────────────────────────────");
-      Serial.printf("Total lines: 3 | Payload: %d bytes\n\n", payload.length());
-      
+  uint8_t state = ttl > 0 ? CACHE_MISS : CACHE_OFF;
+  for (int i = 0; i < CACHE_ENTRIES && state == CACHE_MISS; i++) {
+    CacheEntry &e = cacheEntries[i];
+    if (e.key != key) continue;
+    uint32_t age = millis() - e.storedAt;
+    if (!e.aged && age < ttl) {
+      state = CACHE_FRESH;
+    } else if (!e.aged && age < CACHE_MAX_STALE) {
+      state = CACHE_STALE;
     } else {
-      Serial.printf("❌ HTTP Error: %d\n\n", httpCode);
-      STM32Serial.printf("ERROR:HTTP_%d\n", httpCode);
+      state = CACHE_EXPIRED;
+    }
+    e.readers++;
+    e.lastUsed = millis();
+    slot = i;
+  }
+  xSemaphoreGive(cacheMutex);
+  return state;
+}
+
+// drop: the copy could not be read, forget it
+void cacheRelease(int slot, bool drop) {
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  CacheEntry &e = cacheEntries[slot];
+  e.readers--;
+  if (drop && e.readers == 0) {
+    e.key = "";
+    LittleFS.remove(cacheFilePath(slot));
+    cacheSave();
+  }
+  xSemaphoreGive(cacheMutex);
+}
+
+// 304: the copy is current again
+void cacheTouch(const String &key) {
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  for (int i = 0; i < CACHE_ENTRIES; i++) {
+    CacheEntry &e = cacheEntries[i];
+    if (e.key == key) {
+      e.storedAt = millis();
+      e.aged = false;
+    }
+  }
+  xSemaphoreGive(cacheMutex);
+}
+
+bool cacheStorable(HTTPClient &http) {
+  String control = http.header("Cache-Control");
+  return control.indexOf("no-store") < 0 && control.indexOf("private") < 0;
+}
+
+// Adopt a complete download (tmp) as the copy of key, evicting the least
+// recently used entry if key has none. A copy being read is left alone.
+void cacheStore(const String &key, const String &etag, const String &tmp) {
+  xSemaphoreTake(cacheMutex, portMAX_DELAY);
+  int slot = -1;
+  bool busy = false;
+  for (int i = 0; i < CACHE_ENTRIES; i++) {
+    if (cacheEntries[i].key == key) {
+      slot = i;
+      busy = cacheEntries[i].readers > 0;
     }
+  }
+  for (int i = 0; i < CACHE_ENTRIES && slot < 0; i++) {
+    if (cacheEntries[i].key.length() == 0) slot = i;
+  }
+  for (int i = 0; i < CACHE_ENTRIES && slot < 0; i++) {
+    const CacheEntry &e = cacheEntries[i];
+    if (e.readers == 0 && (slot < 0 || e.lastUsed < cacheEntries[slot].lastUsed)) slot = i;
+  }
+
+  if (slot < 0 || busy) {
+    LittleFS.remove(tmp);
   } else {
-    Serial.printf("❌ Connection failed: %s\n\n", http.errorToString(httpCode).c_str());
-    STM32Serial.println("ERROR:CONNECTION");
+    CacheEntry &e = cacheEntries[slot];
+    LittleFS.remove(cacheFilePath(slot));
+    if (LittleFS.rename(tmp, cacheFilePath(slot))) {
+      e.key = key;
+      e.etag = etag;
+      e.storedAt = millis();
+      e.aged = false;
+      e.lastUsed = millis();
+      Serial.printf("🗄️ [CACHE] Stored %s in slot %d\n", key.c_str(), slot);
+    } else {
+      e.key = "";
+    }
+    cacheSave();
   }
-  
-  http.end();
+  xSemaphoreGive(cacheMutex);
 }
 
-void handleHTTPPost(String cmd) {
-  // Format: HTTP_POST,host,port,path,json_data,api_key,terminal_id
-  Serial.println("🔍 [DEBUG] handleHTTPPost started");
-  Serial.printf("  Command length: %d\n", cmd.length());
-  Serial.printf("  Free heap: %d bytes\n", ESP.getFreeHeap());
-  
-  if (WiFi.status() != WL_CONNECTED) {
-    STM32Serial.println("ERROR:NO_WIFI");
-    Serial.println("❌ Not connected to WiFi!\n");
-    return;
+// Answer from the copy in slot as if it had just come in.
+// Returns false (nothing sent) if the copy cannot be read.
+bool serveCached(HttpWorker &w, uint8_t seq, uint16_t chunkSize, uint8_t credits, int slot,
+                 const String &fields, HttpTiming &t) {
+  File f = LittleFS.open(cacheFilePath(slot), FILE_READ);
+  if (!f) return false;
+
+  t.cached = true;
+  BodySource src = { NULL, &f, NULL, false };
+  if (fields.length() > 0) {
+    sendHTTPFields(w, seq, HTTP_CODE_OK, src, fields, t);
+  } else {
+    pipeHTTPResponse(w, seq, chunkSize, credits, HTTP_CODE_OK, src, t);
   }
-  
-  Serial.println("🔍 [DEBUG] WiFi check passed");
-  
-  // Parse from RIGHT to get api_key and terminal_id (last 2 params)
-  int lastComma = cmd.lastIndexOf(',');
-  int secondLastComma = cmd.lastIndexOf(',', lastComma - 1);
-  
-  if (lastComma == -1 || secondLastComma == -1) {
-    Serial.println("❌ Missing api_key or terminal_id!");
-    STM32Serial.println("ERROR:INVALID_FORMAT");
-    return;
+  f.close();
+  return true;
+}
+
+// Conditional GET behind a stale answer, the STM32 already has its reply
+void cacheRevalidate(HttpWorker &w, const String &host, int port, const String &path,
+                     const String &apiKey, const String &terminalId, const String &etag) {
+  uint32_t start = millis();
+  HttpTiming t = {};
+  Conn *c;
+  int httpCode = backendRequest(c, host, port, path, apiKey, terminalId, NULL, etag, t);
+
+  bool clean = false;
+  if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+    cacheTouch(cacheKey(host, path, apiKey, terminalId));
+    clean = true;
+    Serial.printf("🗄️ [CACHE] %s still current\n", path.c_str());
+  } else if (httpCode == HTTP_CODE_OK && cacheStorable(*c->http)) {
+    String tmp = cacheTempPath(w);
+    File copy = LittleFS.open(tmp, FILE_WRITE);
+    if (copy) {
+      TeeStream tee(NULL, copy);
+      uint32_t bodyStart = millis();
+      clean = c->http->writeToStream(&tee) >= 0 && tee.kept;
+      t.bodyMs = millis() - bodyStart;
+      copy.close();
+      if (clean) {
+        cacheStore(cacheKey(host, path, apiKey, terminalId), c->http->header("ETag"), tmp);
+      } else {
+        LittleFS.remove(tmp);
+      }
+    }
+  } else {
+    Serial.printf("⚠️ [CACHE] Revalidating %s: %d\n", path.c_str(), httpCode);
   }
-  
-  String terminalId = cmd.substring(lastComma + 1);
-  String apiKey = cmd.substring(secondLastComma + 1, lastComma);
-  
-  // Parse first 3 commas (host, port, path)
-  int comma1 = cmd.indexOf(',');
-  int comma2 = cmd.indexOf(',', comma1 + 1);
-  int comma3 = cmd.indexOf(',', comma2 + 1);
-  
-  if (comma1 == -1 || comma2 == -1 || comma3 == -1) {
-    Serial.println("❌ Invalid command format!");
-    STM32Serial.println("ERROR:INVALID_FORMAT");
+
+  connDone(*c, clean);
+  logHTTPTiming(*c, t, start);
+  connRelease(*c);
+  statsRecord(path, t, millis() - start, httpCode, clean);
+}
+
+// ========== WIFI FUNCTIONS ==========
+
+// Runs in the WiFi event task: hand the event to the WiFi task
+void onWiFiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    xTaskNotify(wifiTaskHandle, NET_EVT_GOT_IP, eSetBits);
+  } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED || event == ARDUINO_EVENT_WIFI_STA_LOST_IP) {
+    // Our own disconnect before a (re)join is not a drop
+    if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED &&
+        info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE) return;
+    xTaskNotify(wifiTaskHandle, NET_EVT_LOST, eSetBits);
+  }
+}
+
+// Load what the last good join left in NVS; with credentials there the
+// WiFi task starts joining right away
+void wifiBegin() {
+  net.state = NET_OFF;
+  net.replySeq = -1;
+  net.roamSeq = -1;
+  net.retryDelay = WIFI_RETRY_MIN;
+
+  netPrefs.begin("wifi", false);
+  net.ssid = netPrefs.getString("ssid", "");
+  net.password = netPrefs.getString("pass", "");
+  net.channel = netPrefs.getBytes("bssid", net.bssid, 6) == 6 ? netPrefs.getInt("channel", 0) : 0;
+  net.ip = IPAddress(netPrefs.getUInt("ip", 0));
+  net.gateway = IPAddress(netPrefs.getUInt("gateway", 0));
+  net.subnet = IPAddress(netPrefs.getUInt("subnet", 0));
+  net.dns = IPAddress(netPrefs.getUInt("dns", 0));
+  net.slot = -1;
+  for (int i = 0; i < WIFI_NETWORKS; i++) {
+    char key[8];
+    snprintf(key, sizeof(key), "ssid%d", i);
+    nets[i].ssid = netPrefs.getString(key, "");
+    snprintf(key, sizeof(key), "pass%d", i);
+    nets[i].password = netPrefs.getString(key, "");
+  }
+
+  WiFi.persistent(false);         // NVS is ours, the stack need not write it on every join
+  WiFi.setAutoReconnect(false);   // rejoins are paced by the WiFi task
+  WiFi.mode(WIFI_STA);
+  WiFi.onEvent(onWiFiEvent);
+
+  if (net.ssid.length() > 0) {
+    net.state = NET_JOINING;
+    Serial.printf("📶 [WIFI] Stored network %s%s, joining\n", net.ssid.c_str(),
+                  net.channel ? " (known access point)" : "");
+  }
+}
+
+// Reply to a WIFI_CONNECT still waiting, if any (netMutex held)
+void wifiReplyLocked(const char *text) {
+  if (net.replySeq < 0) return;
+  replyTo((uint8_t)net.replySeq, text);
+  net.replySeq = -1;
+}
+
+// WIFI_CONNECT: answered at once when already on that network, else when
+// the WiFi task has joined it (or given up)
+void doWiFiConnect(const String &ssid, const String &password) {
+  Serial.printf("📶 Connecting to: %s\n", ssid.c_str());
+
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  bool same = ssid == nets[0].ssid && password == nets[0].password;
+  if (!same) wifiStoreSlot(0, ssid, password);
+  // Roamed to another configured network: that one is just as good
+  if (net.state == NET_UP && (ssid == net.ssid || (same && net.slot >= 0))) {
+    xSemaphoreGive(netMutex);
+    reply("CONNECTED");
+    Serial.printf("✅ Already connected to %s! IP: %s\n\n", net.ssid.c_str(),
+                  net.localIP.toString().c_str());
     return;
   }
-  
-  String host = cmd.substring(comma1 + 1, comma2);
-  int port = cmd.substring(comma2 + 1, comma3).toInt();
-  
-  // Find the 4th comma (after path, before JSON)
-  int comma4 = cmd.indexOf(',', comma3 + 1);
-  
-  if (comma4 == -1 || comma4 >= secondLastComma) {
-    Serial.println("❌ Cannot find path/JSON separator!");
-    STM32Serial.println("ERROR:INVALID_FORMAT");
+  wifiReplyLocked("ERROR");   // superseded
+  if (ssid != net.ssid) net.channel = 0;   // stored access point belongs to the old network
+  net.ssid = ssid;
+  net.password = password;
+  net.replySeq = curSeq;
+  net.state = NET_JOINING;
+  xSemaphoreGive(netMutex);
+  xTaskNotify(wifiTaskHandle, NET_EVT_JOIN, eSetBits);
+}
+
+// WIFI_STATIC: fixed address for the following joins, ip "" = DHCP
+void doWiFiStatic(const String &ip, const String &gateway, const String &subnet, const String &dns) {
+  IPAddress a, g, m, d;
+  bool ok = ip.length() == 0 ||
+            (a.fromString(ip) && g.fromString(gateway) && m.fromString(subnet) &&
+             (dns.length() == 0 || d.fromString(dns)));
+  if (!ok) {
+    reply("ERROR:ADDRESS");
+    Serial.println("❌ → ERROR:ADDRESS\n");
     return;
   }
-  
-  String path = cmd.substring(comma3 + 1, comma4);
-  String jsonData = cmd.substring(comma4 + 1, secondLastComma);
-  
-  Serial.printf("  Host: %s\n", host.c_str());
-  Serial.printf("  Port: %d\n", port);
-  Serial.printf("  Path: %s\n", path.c_str());
-  Serial.printf("  JSON Length: %d bytes\n", jsonData.length());
-  Serial.printf("  API Key: %s\n", apiKey.c_str());
-  Serial.printf("  Terminal ID: %s\n", terminalId.c_str());
-  
-  // BUILD URL
-  String url;
-  if (host.endsWith(".app.github.dev") || port == 443) {
-    url = "https://" + host + path;
-    Serial.println("🔍 [DEBUG] Using HTTPS");
-  } else if (port == 80) {
-    url = "http://" + host + path;
-  } else {
-    url = "http://" + host + ":" + String(port) + path;
+  if (ip.length() > 0 && dns.length() == 0) d = g;
+
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  bool changed = (uint32_t)a != (uint32_t)net.ip || (uint32_t)g != (uint32_t)net.gateway ||
+                 (uint32_t)m != (uint32_t)net.subnet || (uint32_t)d != (uint32_t)net.dns;
+  if (changed) {
+    net.ip = a;
+    net.gateway = g;
+    net.subnet = m;
+    net.dns = d;
+    netPrefs.putUInt("ip", a);
+    netPrefs.putUInt("gateway", g);
+    netPrefs.putUInt("subnet", m);
+    netPrefs.putUInt("dns", d);
   }
-  
-  Serial.println("🌐 HTTP POST Request:");
-  Serial.printf("  URL: %s\n", url.c_str());
-  
-  if (jsonData.length() > 200) {
-    Serial.print("  Data Preview: ");
-    Serial.print(jsonData.substring(0, 100));
-    Serial.println("...");
+  bool rejoin = changed && net.state == NET_UP;
+  if (rejoin) net.state = NET_JOINING;
+  xSemaphoreGive(netMutex);
+
+  if (rejoin) xTaskNotify(wifiTaskHandle, NET_EVT_JOIN, eSetBits);
+  reply("OK");
+  Serial.printf("📶 Address: %s → OK\n\n", ip.length() > 0 ? ip.c_str() : "DHCP");
+}
+
+// Start a join: on the stored access point if there is one (no scan), with
+// the static address if one is set (no DHCP)
+void wifiJoin(bool fast) {
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  String ssid = net.ssid;
+  String password = net.password;
+  int32_t channel = net.channel;
+  uint8_t bssid[6];
+  memcpy(bssid, net.bssid, 6);
+  WiFi.config(net.ip, net.gateway, net.subnet, net.dns);   // 0.0.0.0 = DHCP
+  net.fast = fast && channel != 0;
+  net.joinStart = millis();
+  net.state = NET_JOINING;
+  xSemaphoreGive(netMutex);
+
+  WiFi.disconnect();
+  if (net.fast) {
+    Serial.printf("📶 [WIFI] Joining %s on channel %ld\n", ssid.c_str(), (long)channel);
+    WiFi.begin(ssid.c_str(), password.c_str(), channel, bssid);
   } else {
-    Serial.printf("  Data: %s\n", jsonData.c_str());
+    Serial.printf("📶 [WIFI] Joining %s (scan)\n", ssid.c_str());
+    WiFi.begin(ssid.c_str(), password.c_str());
   }
-  
-  HTTPClient http;
-  http.setTimeout(HTTP_TIMEOUT);
-  
-  // HTTPS support
-  if (url.startsWith("https://")) {
-    WiFiClientSecure *client = new WiFiClientSecure;
-    client->setInsecure();
-    http.begin(*client, url);
-    Serial.println("🔍 [DEBUG] Using HTTPS (insecure mode)");
-  } else {
-    http.begin(url);
-    Serial.println("🔍 [DEBUG] Using HTTP");
+}
+
+// Joined: keep the access point for the next fast join, answer WIFI_CONNECT
+void wifiUp() {
+  uint8_t *bssid = WiFi.BSSID();
+  int32_t channel = WiFi.channel();
+  uint32_t took = millis() - net.joinStart;
+
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  net.state = NET_UP;
+  net.localIP = WiFi.localIP();
+  net.retryDelay = WIFI_RETRY_MIN;
+  net.slot = wifiSlotOf(net.ssid);
+  net.rssi = WiFi.RSSI();
+  net.rssiAt = millis();
+  if (net.roaming) {
+    net.roaming = false;
+    Serial.printf("🔀 [WIFI] Now on %s\n", net.ssid.c_str());
   }
-  
-  // ADD HEADERS
-  http.addHeader("Content-Type", "application/json");
-  http.addHeader("x-api-key", apiKey);
-  http.addHeader("x-terminal-id", terminalId);
-  Serial.println("🔍 [DEBUG] Headers set");
-  
-  // GitHub Codespaces bypass header
-  if (host.endsWith(".app.github.dev")) {
-    http.addHeader("ngrok-skip-browser-warning", "true");
+  if (netPrefs.getString("ssid", "") != net.ssid || netPrefs.getString("pass", "") != net.password) {
+    netPrefs.putString("ssid", net.ssid);
+    netPrefs.putString("pass", net.password);
   }
-  
-  Serial.println("🔍 [DEBUG] Calling http.POST()...");
-  Serial.printf("  Free heap before POST: %d bytes\n", ESP.getFreeHeap());
-  
-  int httpCode = http.POST(jsonData);
-  
-  Serial.printf("🔍 [DEBUG] POST returned! Code: %d\n", httpCode);
-  
-  if (httpCode > 0) {
-    if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_CREATED ||
-        httpCode == HTTP_CODE_ACCEPTED) {
-      String payload = http.getString();
-      Serial.printf("  ✅ Success! Payload: %d bytes\n", payload.length());
-      
-      // ✅ Send response to STM32 ALL AT ONCE (no chunking!)
-      // This matches handleHTTPGet behavior
-      STM32Serial.println("HTTP_RESPONSE:" + String(httpCode));
-      STM32Serial.println("BODY:" + payload);
-      STM32Serial.println("HTTP_END");
-      
-      Serial.printf("✅ Response sent to STM32 (%d bytes)\n\n", payload.length());
-      
-      // ✅ DEBUG: Show exact response
-      Serial.println("🔍 [ESP32 DEBUG] Exact response sent:");
-      Serial.println("─────────────────────────────────────");
-      Serial.print("HTTP_RESPONSE:");
-      Serial.println(httpCode);
-      Serial.print("BODY:");
-      // Only show first 200 chars for long responses
-      if (payload.length() > 200) {
-        Serial.print(payload.substring(0, 200));
-        Serial.println("...");
+  if (bssid && (channel != net.channel || memcmp(bssid, net.bssid, 6) != 0)) {
+    memcpy(net.bssid, bssid, 6);
+    net.channel = channel;
+    netPrefs.putBytes("bssid", net.bssid, 6);
+    netPrefs.putInt("channel", channel);
+  }
+  wifiReplyLocked("CONNECTED");
+  xSemaphoreGive(netMutex);
+
+  Serial.printf("✅ [WIFI] Connected in %lu ms%s! IP: %s\n\n", (unsigned long)took,
+                net.fast ? " (no scan)" : "", net.localIP.toString().c_str());
+}
+
+// A join failed or the network went away: try again later, pauses doubling
+void wifiRetry(const char *why) {
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  if (net.state == NET_UP) net.drops++;
+  net.roaming = false;   // a failed way back opens the gate too
+  int slot = wifiSlotOf(net.ssid);
+  if (slot >= 0 && net.retryDelay >= WIFI_RETRY_NEXT) {
+    // This network keeps failing: try the next configured one
+    for (int i = 1; i < WIFI_NETWORKS; i++) {
+      const WiFiNetwork &n = nets[(slot + i) % WIFI_NETWORKS];
+      if (n.ssid.length() == 0) continue;
+      net.ssid = n.ssid;
+      net.password = n.password;
+      net.channel = 0;   // scan for it
+      break;
+    }
+  }
+  net.state = NET_RETRY;
+  net.retryAt = millis() + net.retryDelay;
+  Serial.printf("⚠️ [WIFI] %s, rejoining in %lu ms (%lu drops)\n\n", why,
+                (unsigned long)net.retryDelay, (unsigned long)net.drops);
+  net.retryDelay = net.retryDelay * 2 > WIFI_RETRY_MAX ? WIFI_RETRY_MAX : net.retryDelay * 2;
+  wifiReplyLocked("ERROR");   // the STM32 stops waiting, the joins go on
+  xSemaphoreGive(netMutex);
+}
+
+// Join/rejoin state machine
+void wifiTask(void *arg) {
+  (void)arg;
+  if (net.state == NET_JOINING) wifiJoin(true);   // stored network, from wifiBegin()
+
+  for (;;) {
+    uint32_t events = 0;
+    xTaskNotifyWait(0, 0xFFFFFFFF, &events, pdMS_TO_TICKS(WIFI_TICK));
+
+    if (events & NET_EVT_LEAVE) {
+      WiFi.disconnect();
+    }
+    if (net.state == NET_OFF) continue;   // WIFI_DISCONNECT, events of the old link don't matter
+
+    if (events & NET_EVT_JOIN) {
+      net.retryDelay = WIFI_RETRY_MIN;
+      net.roamFrom = -1;   // WIFI_CONNECT wins over a switch in progress
+      net.roaming = false;
+      wifiJoin(true);
+      continue;   // events up to here belong to the previous link
+    }
+
+    if ((events & NET_EVT_GOT_IP) && net.state == NET_JOINING) {
+      wifiUp();
+    } else if (events & NET_EVT_LOST) {
+      if (net.state == NET_UP) {
+        wifiRetry("Network lost");
+      } else if (net.state == NET_JOINING && net.roaming && net.roamFrom >= 0) {
+        wifiRoamBack();
+      } else if (net.state == NET_JOINING && net.roaming) {
+        wifiRetry("Switch back failed");
+      } else if (net.state == NET_JOINING && net.fast) {
+        wifiJoin(false);          // the access point moved, scan
+      } else if (net.state == NET_JOINING) {
+        wifiRetry("Join failed");
+      }
+    }
+    if (events & NET_EVT_ROAM) wifiRoam(millis());
+
+    uint32_t now = millis();
+    if (net.state == NET_JOINING &&
+        now - net.joinStart > (net.fast ? WIFI_FAST_TIMEOUT : WIFI_JOIN_TIMEOUT)) {
+      if (net.roaming && net.roamFrom >= 0) {
+        wifiRoamBack();
+      } else if (net.roaming) {
+        wifiRetry("Switch back timed out");   // no scan while the gate is closed
+      } else if (net.fast) {
+        wifiJoin(false);
       } else {
-        Serial.println(payload);
+        wifiRetry("Join timed out");
       }
-      Serial.println("HTTP_END");
-      Serial.println("─────────────────────────────────────");
-      Serial.printf("Total lines: 3 | Payload: %d bytes\n\n", payload.length());
-      
-    } else {
-      Serial.printf("❌ HTTP Error: %d\n\n", httpCode);
-      STM32Serial.printf("ERROR:HTTP_%d\n", httpCode);
+    } else if (net.state == NET_RETRY && (int32_t)(now - net.retryAt) >= 0) {
+      wifiJoin(true);
+    } else if (net.state == NET_UP) {
+      wifiScore(now);
     }
-  } else {
-    Serial.printf("❌ Connection failed: %s\n\n", http.errorToString(httpCode).c_str());
-    STM32Serial.println("ERROR:CONNECTION");
   }
-  
-  http.end();
-  Serial.println("🔍 [DEBUG] handleHTTPPost completed");
+}
+
+// Slot of a configured network, -1 if ssid is none of them
+int wifiSlotOf(const String &ssid) {
+  for (int i = 0; i < WIFI_NETWORKS; i++) {
+    if (nets[i].ssid.length() > 0 && nets[i].ssid == ssid) return i;
+  }
+  return -1;
+}
+
+// Set a network slot and keep it in NVS (netMutex held)
+void wifiStoreSlot(int slot, const String &ssid, const String &password) {
+  char key[8];
+  nets[slot].ssid = ssid;
+  nets[slot].password = password;
+  nets[slot].rttMs = 0;
+  nets[slot].seenAt = 0;
+  snprintf(key, sizeof(key), "ssid%d", slot);
+  netPrefs.putString(key, ssid);
+  snprintf(key, sizeof(key), "pass%d", slot);
+  netPrefs.putString(key, password);
+}
+
+// WIFI_ADD: another network to roam to, ssid "" frees the slot
+void doWiFiAdd(int slot, const String &ssid, const String &password) {
+  if (slot < 1 || slot >= WIFI_NETWORKS) {
+    reply("ERROR:SLOT");
+    Serial.println("❌ → ERROR:SLOT\n");
+    return;
+  }
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  if (ssid != nets[slot].ssid || password != nets[slot].password) {
+    wifiStoreSlot(slot, ssid, password);   // sent every STM32 boot, flash only written on change
+  }
+  xSemaphoreGive(netMutex);
+  reply("OK");
+  Serial.printf("📶 Network %d: %s → OK\n\n", slot, ssid.length() > 0 ? ssid.c_str() : "(none)");
+}
+
+// WIFI_ROAM: the STM32 is between voters, a switch interrupts nobody. The
+// reply is the decision, the STM32 does not wait for the join
+void doWiFiRoam() {
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  bool pending = net.roamSeq >= 0 || net.roaming;
+  if (!pending) net.roamSeq = curSeq;
+  xSemaphoreGive(netMutex);
+  if (pending) {
+    reply("BUSY");
+    return;
+  }
+  xTaskNotify(wifiTaskHandle, NET_EVT_ROAM, eSetBits);
+}
+
+// Answer a WIFI_ROAM still waiting, if any (netMutex held)
+void wifiRoamReplyLocked(const char *text) {
+  if (net.roamSeq < 0) return;
+  replyTo((uint8_t)net.roamSeq, text);
+  net.roamSeq = -1;
+}
+
+// Backend round trip of a request, for the score of the network in use
+void wifiNoteRtt(uint32_t ms) {
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  if (net.state == NET_UP && net.slot >= 0 && !net.roaming) {
+    WiFiNetwork &n = nets[net.slot];
+    uint16_t sample = ms > 0xFFFF ? 0xFFFF : ms;
+    n.rttMs = n.rttMs == 0 ? sample : (n.rttMs * 7 + sample) / 8;
+  }
+  xSemaphoreGive(netMutex);
+}
+
+// Higher is better: signal, less what a slow backend path costs
+int wifiScoreOf(int16_t rssi, uint16_t rttMs) {
+  return rssi - rttMs / WIFI_RTT_PER_DB;
+}
+
+// WiFi task, while up: sample the signal, scan now and then, and on
+// WIFI_ROAM switch to a network that scores clearly better
+void wifiScore(uint32_t now) {
+  if (now - net.rssiAt > WIFI_RSSI_PERIOD) {
+    net.rssi = (net.rssi * 3 + WiFi.RSSI()) / 4;
+    net.rssiAt = now;
+  }
+
+  // Scans take the radio off channel for a moment, only while no request runs
+  bool idle = httpBusy == 0 && uxQueueMessagesWaiting(httpQueue) == 0;
+  if (!net.scanning && idle && net.slot >= 0 && now - net.scanAt > WIFI_SCAN_PERIOD) {
+    net.scanning = WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
+    net.scanAt = now;
+  }
+  if (net.scanning) {
+    int16_t found = WiFi.scanComplete();
+    if (found == WIFI_SCAN_RUNNING) return;
+    net.scanning = false;
+    xSemaphoreTake(netMutex, portMAX_DELAY);
+    for (int i = 0; i < WIFI_NETWORKS; i++) nets[i].seenAt = 0;
+    for (int16_t r = 0; r < found; r++) {
+      int slot = wifiSlotOf(WiFi.SSID(r));
+      if (slot < 0) continue;
+      WiFiNetwork &n = nets[slot];
+      if (n.seenAt == 0 || WiFi.RSSI(r) > n.rssi) {
+        n.rssi = WiFi.RSSI(r);
+        n.channel = WiFi.channel(r);
+        memcpy(n.bssid, WiFi.BSSID(r), 6);
+        n.seenAt = now;
+      }
+    }
+    xSemaphoreGive(netMutex);
+    WiFi.scanDelete();
+  }
+}
+
+// WIFI_ROAM, in the WiFi task: switch to the network that scored best in the
+// last scan if it beats the current access point clearly. Answered STAYED or
+// ROAMING right away; HTTP jobs are then held off, the running ones finished
+// first, and the gate opens on the join, after one try back, or if a
+// request is still running after WIFI_ROAM_WAIT (no switch then).
+void wifiRoam(uint32_t now) {
+  if (net.state != NET_UP || net.slot < 0 || net.scanning) {
+    xSemaphoreTake(netMutex, portMAX_DELAY);
+    wifiRoamReplyLocked("STAYED");
+    xSemaphoreGive(netMutex);
+    return;
+  }
+
+  // The current network's round trip stands in for networks not used yet
+  uint16_t rtt = nets[net.slot].rttMs;
+  int best = -1;
+  int bestScore = wifiScoreOf(net.rssi, rtt) + WIFI_ROAM_MARGIN;
+  for (int i = 0; i < WIFI_NETWORKS; i++) {
+    const WiFiNetwork &n = nets[i];
+    if (n.seenAt == 0 || now - n.seenAt > WIFI_SCAN_FRESH) continue;
+    if (i == net.slot && memcmp(n.bssid, WiFi.BSSID(), 6) == 0) continue;   // the AP we are on
+    int score = wifiScoreOf(n.rssi, n.rttMs ? n.rttMs : rtt);
+    if (score > bestScore) {
+      best = i;
+      bestScore = score;
+    }
+  }
+  if (best < 0) {
+    xSemaphoreTake(netMutex, portMAX_DELAY);
+    wifiRoamReplyLocked("STAYED");
+    xSemaphoreGive(netMutex);
+    return;
+  }
+
+  // Close the gate and answer: requests sent from now on wait for the switch
+  net.roaming = true;
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  wifiRoamReplyLocked("ROAMING");
+  xSemaphoreGive(netMutex);
+
+  // Then wait for the jobs already past it
+  uint32_t start = millis();
+  while (httpBusy > 0 && millis() - start < WIFI_ROAM_WAIT) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  if (httpBusy > 0) {
+    net.roaming = false;
+    Serial.println("⚠️ [WIFI] Not switching, a request is still running\n");
+    return;
+  }
+
+  const WiFiNetwork &n = nets[best];
+  Serial.printf("🔀 [WIFI] %s (%d dBm, %u ms) → %s (%d dBm, %u ms)\n", net.ssid.c_str(), net.rssi, rtt,
+                n.ssid.c_str(), n.rssi, n.rttMs);
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  net.roamFrom = net.slot;
+  memcpy(net.roamBssid, net.bssid, 6);
+  net.roamChannel = net.channel;
+  net.ssid = n.ssid;
+  net.password = n.password;
+  memcpy(net.bssid, n.bssid, 6);
+  net.channel = n.channel;
+  xSemaphoreGive(netMutex);
+  wifiJoin(true);
+}
+
+// The network switched to did not take us: back to where we were
+void wifiRoamBack() {
+  xSemaphoreTake(netMutex, portMAX_DELAY);
+  int failed = wifiSlotOf(net.ssid);
+  if (failed >= 0) nets[failed].seenAt = 0;   // not again until a scan finds it
+  const WiFiNetwork &n = nets[net.roamFrom];
+  Serial.printf("⚠️ [WIFI] Switch to %s failed, back to %s\n", net.ssid.c_str(), n.ssid.c_str());
+  net.ssid = n.ssid;
+  net.password = n.password;
+  memcpy(net.bssid, net.roamBssid, 6);
+  net.channel = net.roamChannel;
+  net.roamFrom = -1;   // one fast try back, still gated; if that fails the gate opens
+  xSemaphoreGive(netMutex);
+  wifiJoin(true);
 }